@@ -7,10 +7,36 @@
 #include <stdlib.h>
 #include <stdarg.h>
 #include <string.h>
+#include <math.h>
+#include <float.h>
 #include <vector>
 #include <sstream>
 #include <iostream>
 #include <map>
+#include <set>
+#include <thread>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <atomic>
+#include <algorithm>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
 
 #include <steam/steam_api.h>
 
@@ -102,6 +128,12 @@ inline value id_to_hx(CSteamID id) {
 	return alloc_string(r.str().c_str());
 }
 
+inline value u64_to_hx(uint64 v) {
+	std::ostringstream r;
+	r << v;
+	return alloc_string(r.str().c_str());
+}
+
 inline CSteamID hx_to_id(value hx) {
 	return strtoull(val_string(hx), NULL, 0);
 }
@@ -109,8 +141,498 @@ inline CSteamID hx_to_id(const char* hx) {
 	return strtoull(hx, NULL, 0);
 }
 
+//XXH64 (https://github.com/Cyan4973/xxHash), a fast non-cryptographic hash used to fingerprint file contents
+static const uint64 kXXH64Prime1 = 11400714785074694791ULL;
+static const uint64 kXXH64Prime2 = 14029467366897019727ULL;
+static const uint64 kXXH64Prime3 = 1609587929392839161ULL;
+static const uint64 kXXH64Prime4 = 9650029242287828579ULL;
+static const uint64 kXXH64Prime5 = 2870177450012600261ULL;
+
+static inline uint64 xxh64_rotl(uint64 x, int r) { return (x << r) | (x >> (64 - r)); }
+static inline uint64 xxh64_read64(const unsigned char* p) { uint64 v; memcpy(&v, p, 8); return v; }
+static inline uint32 xxh64_read32(const unsigned char* p) { uint32 v; memcpy(&v, p, 4); return v; }
+
+static inline uint64 xxh64_round(uint64 acc, uint64 input)
+{
+	acc += input * kXXH64Prime2;
+	acc = xxh64_rotl(acc, 31);
+	return acc * kXXH64Prime1;
+}
+
+static inline uint64 xxh64_merge(uint64 acc, uint64 val)
+{
+	acc ^= xxh64_round(0, val);
+	return acc * kXXH64Prime1 + kXXH64Prime4;
+}
+
+uint64 xxh64(const void* data, size_t length, uint64 seed)
+{
+	const unsigned char* p = (const unsigned char*)data;
+	const unsigned char* end = p + length;
+	uint64 h64;
+
+	if (length >= 32)
+	{
+		const unsigned char* limit = end - 32;
+		uint64 v1 = seed + kXXH64Prime1 + kXXH64Prime2;
+		uint64 v2 = seed + kXXH64Prime2;
+		uint64 v3 = seed;
+		uint64 v4 = seed - kXXH64Prime1;
+		do {
+			v1 = xxh64_round(v1, xxh64_read64(p)); p += 8;
+			v2 = xxh64_round(v2, xxh64_read64(p)); p += 8;
+			v3 = xxh64_round(v3, xxh64_read64(p)); p += 8;
+			v4 = xxh64_round(v4, xxh64_read64(p)); p += 8;
+		} while (p <= limit);
+
+		h64 = xxh64_rotl(v1, 1) + xxh64_rotl(v2, 7) + xxh64_rotl(v3, 12) + xxh64_rotl(v4, 18);
+		h64 = xxh64_merge(h64, v1);
+		h64 = xxh64_merge(h64, v2);
+		h64 = xxh64_merge(h64, v3);
+		h64 = xxh64_merge(h64, v4);
+	}
+	else
+	{
+		h64 = seed + kXXH64Prime5;
+	}
+
+	h64 += (uint64)length;
+
+	while (p + 8 <= end)
+	{
+		h64 ^= xxh64_round(0, xxh64_read64(p));
+		h64 = xxh64_rotl(h64, 27) * kXXH64Prime1 + kXXH64Prime4;
+		p += 8;
+	}
+	if (p + 4 <= end)
+	{
+		h64 ^= (uint64)xxh64_read32(p) * kXXH64Prime1;
+		h64 = xxh64_rotl(h64, 23) * kXXH64Prime2 + kXXH64Prime3;
+		p += 4;
+	}
+	while (p < end)
+	{
+		h64 ^= (*p) * kXXH64Prime5;
+		h64 = xxh64_rotl(h64, 11) * kXXH64Prime1;
+		p++;
+	}
+
+	h64 ^= h64 >> 33;
+	h64 *= kXXH64Prime2;
+	h64 ^= h64 >> 29;
+	h64 *= kXXH64Prime3;
+	h64 ^= h64 >> 32;
+	return h64;
+}
+
+//Builds the little-endian binary tables bulk prims hand back to Haxe as Bytes (read with steamwrap.helpers.PackedReader).
+//Strings are a u32 byte length followed by UTF-8 without terminator.
+class PackedWriter
+{
+public:
+	std::vector<unsigned char> data;
+	
+	void u8(uint8 v) { data.push_back(v); }
+	void u32(uint32 v) { raw(&v, 4); }
+	void i32(int32 v) { raw(&v, 4); }
+	void u64(uint64 v) { raw(&v, 8); }
+	void f32(float v) { raw(&v, 4); }
+	void f64(double v) { raw(&v, 8); }
+	void str(const char* s) { str(s, s ? strlen(s) : 0); }
+	void str(const std::string& s) { str(s.data(), s.size()); }
+	void str(const char* s, size_t length)
+	{
+		u32((uint32)length);
+		raw(s, length);
+	}
+	void raw(const void* p, size_t length)
+	{
+		const unsigned char* b = (const unsigned char*)p;
+		data.insert(data.end(), b, b + length);
+	}
+	//patches a u32 written earlier, e.g. a count that's only known at the end
+	void setU32(size_t offset, uint32 v) { memcpy(&data[offset], &v, 4); }
+	
+	value toValue() const
+	{
+		return bytes_to_hx(data.data(), (int)data.size());
+	}
+};
+
+//Reads back what a PackedWriter wrote (for files we persist); every read is bounds-checked and sets ok to false
+//once the data runs out, so a truncated file can be detected after the fact
+class PackedParser
+{
+public:
+	bool ok;
+	
+	PackedParser(const unsigned char* data, size_t length) : ok(true), m_data(data), m_length(length), m_pos(0) {}
+	
+	uint8 u8() { uint8 v = 0; raw(&v, 1); return v; }
+	uint32 u32() { uint32 v = 0; raw(&v, 4); return v; }
+	int32 i32() { int32 v = 0; raw(&v, 4); return v; }
+	uint64 u64() { uint64 v = 0; raw(&v, 8); return v; }
+	float f32() { float v = 0; raw(&v, 4); return v; }
+	std::string str()
+	{
+		uint32 length = u32();
+		if (!ok || length > m_length - m_pos) { ok = false; return std::string(); }
+		std::string v((const char*)m_data + m_pos, length);
+		m_pos += length;
+		return v;
+	}
+	void raw(void* dest, size_t length)
+	{
+		if (!ok || length > m_length - m_pos) { ok = false; return; }
+		memcpy(dest, m_data + m_pos, length);
+		m_pos += length;
+	}
+	bool atEnd() const { return m_pos >= m_length; }
+	
+private:
+	const unsigned char* m_data;
+	size_t m_length;
+	size_t m_pos;
+};
+
+//Strings for a PackedWriter table that are stored once, after the header, and referenced from the rows as
+//(u32 offset, u32 length). Repeated strings (tags, mostly) are only stored once.
+class PackedStringPool
+{
+public:
+	std::vector<unsigned char> data;
+	
+	void ref(PackedWriter& w, const char* s) { ref(w, s, s ? strlen(s) : 0); }
+	void ref(PackedWriter& w, const std::string& s) { ref(w, s.data(), s.size()); }
+	void ref(PackedWriter& w, const char* s, size_t length)
+	{
+		std::string key(s, length);
+		std::map<std::string, uint32>::iterator it = m_offsets.find(key);
+		uint32 offset;
+		if (it != m_offsets.end())
+		{
+			offset = it->second;
+		}
+		else
+		{
+			offset = (uint32)data.size();
+			data.insert(data.end(), key.begin(), key.end());
+			m_offsets[key] = offset;
+		}
+		w.u32(offset);
+		w.u32((uint32)length);
+	}
+	
+private:
+	std::map<std::string, uint32> m_offsets;
+};
+
 AutoGCRoot *g_eventHandler = 0;
 
+//Monotonic time in seconds, for scheduling work from the callback pump
+inline double NowSeconds()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+#pragma endregion
+
+#pragma region Compression
+//A small LZ4-compatible block codec (https://github.com/lz4/lz4/blob/dev/doc/lz4_Block_format.md) and the framing
+//we wrap around it. Compression needs a fixed 16KB hash table and never writes past the caller's buffer;
+//decompression is fully bounds-checked so a corrupt file can't take us down.
+static const int kLZ4MinMatch = 4;
+static const int kLZ4LastLiterals = 5;
+static const int kLZ4MatchFindLimit = 12;
+static const int kLZ4MaxOffset = 65535;
+static const int kLZ4HashLog = 12;
+
+inline uint32 lz4_hash(uint32 sequence)
+{
+	return (sequence * 2654435761U) >> (32 - kLZ4HashLog);
+}
+
+inline int lz4_compress_bound(int length)
+{
+	return length + (length / 255) + 16;
+}
+
+static unsigned char* lz4_write_length(unsigned char* op, size_t length)
+{
+	while (length >= 255)
+	{
+		*op++ = 255;
+		length -= 255;
+	}
+	*op++ = (unsigned char)length;
+	return op;
+}
+
+//Returns the compressed size, or 0 if it didn't fit into dstCapacity
+static int lz4_compress_block(const unsigned char* src, int srcLength, unsigned char* dst, int dstCapacity)
+{
+	uint32 table[1 << kLZ4HashLog];
+	memset(table, 0, sizeof(table));
+	
+	const unsigned char* ip = src;
+	const unsigned char* anchor = src;
+	const unsigned char* end = src + srcLength;
+	unsigned char* op = dst;
+	unsigned char* opEnd = dst + dstCapacity;
+	
+	if (srcLength > kLZ4MatchFindLimit)
+	{
+		const unsigned char* matchLimit = end - kLZ4LastLiterals;
+		const unsigned char* findLimit = end - kLZ4MatchFindLimit;
+		
+		ip++;
+		while (ip <= findLimit)
+		{
+			uint32 sequence = xxh64_read32(ip);
+			uint32 h = lz4_hash(sequence);
+			const unsigned char* ref = src + table[h];
+			table[h] = (uint32)(ip - src);
+			
+			if (ref >= ip || ip - ref > kLZ4MaxOffset || xxh64_read32(ref) != sequence)
+			{
+				ip++;
+				continue;
+			}
+			
+			while (ip > anchor && ref > src && ip[-1] == ref[-1]) { ip--; ref--; }
+			
+			const unsigned char* matchEnd = ip + kLZ4MinMatch;
+			const unsigned char* refEnd = ref + kLZ4MinMatch;
+			while (matchEnd < matchLimit && *matchEnd == *refEnd) { matchEnd++; refEnd++; }
+			
+			size_t literalLength = ip - anchor;
+			size_t matchLength = (matchEnd - ip) - kLZ4MinMatch;
+			if (op + 1 + literalLength + (literalLength / 255) + 1 + 2 + (matchLength / 255) + 1 > opEnd) return 0;
+			
+			unsigned char* token = op++;
+			*token = (unsigned char)((literalLength >= 15 ? 15 : literalLength) << 4);
+			if (literalLength >= 15) op = lz4_write_length(op, literalLength - 15);
+			memcpy(op, anchor, literalLength);
+			op += literalLength;
+			
+			uint32 offset = (uint32)(ip - ref);
+			*op++ = (unsigned char)(offset & 0xff);
+			*op++ = (unsigned char)(offset >> 8);
+			
+			*token |= (unsigned char)(matchLength >= 15 ? 15 : matchLength);
+			if (matchLength >= 15) op = lz4_write_length(op, matchLength - 15);
+			
+			ip = matchEnd;
+			anchor = ip;
+			if (ip - 2 > src) table[lz4_hash(xxh64_read32(ip - 2))] = (uint32)(ip - 2 - src);
+		}
+	}
+	
+	size_t literalLength = end - anchor;
+	if (op + 1 + literalLength + (literalLength / 255) + 1 > opEnd) return 0;
+	unsigned char* token = op++;
+	*token = (unsigned char)((literalLength >= 15 ? 15 : literalLength) << 4);
+	if (literalLength >= 15) op = lz4_write_length(op, literalLength - 15);
+	memcpy(op, anchor, literalLength);
+	op += literalLength;
+	
+	return (int)(op - dst);
+}
+
+//Returns the decompressed size, or -1 if the input is malformed or doesn't fit into dstLength
+static int lz4_decompress_block(const unsigned char* src, int srcLength, unsigned char* dst, int dstLength)
+{
+	const unsigned char* ip = src;
+	const unsigned char* ipEnd = src + srcLength;
+	unsigned char* op = dst;
+	unsigned char* opEnd = dst + dstLength;
+	
+	while (ip < ipEnd)
+	{
+		unsigned char token = *ip++;
+		
+		size_t literalLength = token >> 4;
+		if (literalLength == 15)
+		{
+			unsigned char b;
+			do {
+				if (ip >= ipEnd) return -1;
+				b = *ip++;
+				literalLength += b;
+			} while (b == 255);
+		}
+		if (literalLength > (size_t)(ipEnd - ip) || literalLength > (size_t)(opEnd - op)) return -1;
+		memcpy(op, ip, literalLength);
+		op += literalLength;
+		ip += literalLength;
+		
+		//the last sequence only has literals
+		if (ip >= ipEnd) break;
+		
+		if (ipEnd - ip < 2) return -1;
+		size_t offset = ip[0] | (ip[1] << 8);
+		ip += 2;
+		if (offset == 0 || offset > (size_t)(op - dst)) return -1;
+		
+		size_t matchLength = token & 15;
+		if (matchLength == 15)
+		{
+			unsigned char b;
+			do {
+				if (ip >= ipEnd) return -1;
+				b = *ip++;
+				matchLength += b;
+			} while (b == 255);
+		}
+		matchLength += kLZ4MinMatch;
+		if (matchLength > (size_t)(opEnd - op)) return -1;
+		
+		//matches may overlap what they're writing, so copy byte by byte
+		const unsigned char* match = op - offset;
+		for (size_t i = 0; i < matchLength; i++) op[i] = match[i];
+		op += matchLength;
+	}
+	
+	return (int)(op - dst);
+}
+
+//Compressed frame layout (little-endian):
+//   "SWZ1" | codec:u8 | reserved:u8[3] | rawSize:u32 | blockSize:u32 | checksum:u32 | blockSizes:u32[blockCount] | blocks
+//The checksum is the low 32 bits of the XXH64 of the raw data. Blocks are independent so they can be compressed
+//in parallel; a block whose size has kFrameStoredBlock set didn't compress and is stored as-is.
+static const unsigned char kFrameMagic[4] = { 'S', 'W', 'Z', '1' };
+static const int kFrameCodecLZ4 = 1;
+static const uint32 kFrameHeaderSize = 20;
+static const uint32 kFrameBlockSize = 256 * 1024;
+static const uint32 kFrameStoredBlock = 0x80000000;
+
+inline void frame_write32(unsigned char* p, uint32 v) { memcpy(p, &v, 4); }
+
+static void CompressFrameBlocks(const unsigned char* src, uint32 length, uint32 blockCount, unsigned char* scratch, uint32* blockSizes, uint32 first, uint32 stride)
+{
+	int scratchStride = lz4_compress_bound(kFrameBlockSize);
+	for (uint32 i = first; i < blockCount; i += stride)
+	{
+		uint32 offset = i * kFrameBlockSize;
+		uint32 rawLength = (length - offset < kFrameBlockSize) ? (length - offset) : kFrameBlockSize;
+		unsigned char* dst = scratch + (size_t)i * scratchStride;
+		int packed = lz4_compress_block(src + offset, rawLength, dst, rawLength);
+		if (packed <= 0)
+		{
+			memcpy(dst, src + offset, rawLength);
+			blockSizes[i] = rawLength | kFrameStoredBlock;
+		}
+		else
+		{
+			blockSizes[i] = packed;
+		}
+	}
+}
+
+//Wraps data in a compressed frame. With threads > 1, multi-block inputs are compressed on that many threads.
+static void CompressFrame(const unsigned char* src, uint32 length, int threads, std::vector<unsigned char>& out)
+{
+	uint32 blockCount = (length + kFrameBlockSize - 1) / kFrameBlockSize;
+	std::vector<uint32> blockSizes(blockCount);
+	std::vector<unsigned char> scratch((size_t)blockCount * lz4_compress_bound(kFrameBlockSize));
+	
+	if (threads > (int)blockCount) threads = blockCount;
+	if (threads > 1)
+	{
+		std::vector<std::thread> workers;
+		for (int t = 1; t < threads; t++)
+		{
+			workers.push_back(std::thread(CompressFrameBlocks, src, length, blockCount, scratch.data(), blockSizes.data(), t, threads));
+		}
+		CompressFrameBlocks(src, length, blockCount, scratch.data(), blockSizes.data(), 0, threads);
+		for (size_t t = 0; t < workers.size(); t++) workers[t].join();
+	}
+	else
+	{
+		CompressFrameBlocks(src, length, blockCount, scratch.data(), blockSizes.data(), 0, 1);
+	}
+	
+	size_t total = kFrameHeaderSize + blockCount * 4;
+	for (uint32 i = 0; i < blockCount; i++) total += blockSizes[i] & ~kFrameStoredBlock;
+	
+	out.resize(total);
+	unsigned char* op = out.data();
+	memcpy(op, kFrameMagic, 4);
+	op[4] = kFrameCodecLZ4;
+	op[5] = op[6] = op[7] = 0;
+	frame_write32(op + 8, length);
+	frame_write32(op + 12, kFrameBlockSize);
+	frame_write32(op + 16, (uint32)xxh64(src, length, 0));
+	op += kFrameHeaderSize;
+	
+	for (uint32 i = 0; i < blockCount; i++, op += 4) frame_write32(op, blockSizes[i]);
+	
+	int scratchStride = lz4_compress_bound(kFrameBlockSize);
+	for (uint32 i = 0; i < blockCount; i++)
+	{
+		uint32 packed = blockSizes[i] & ~kFrameStoredBlock;
+		memcpy(op, scratch.data() + (size_t)i * scratchStride, packed);
+		op += packed;
+	}
+}
+
+inline bool IsCompressedFrame(const unsigned char* src, uint32 length)
+{
+	return length >= kFrameHeaderSize && memcmp(src, kFrameMagic, 4) == 0;
+}
+
+//Whether src starts with a header we wrote: known codec, zeroed reserved bytes and a sane block size. Data that
+//merely happens to start with the magic doesn't pass this.
+inline bool IsFrameHeader(const unsigned char* src, uint32 length)
+{
+	if (!IsCompressedFrame(src, length) || src[4] != kFrameCodecLZ4) return false;
+	if (src[5] != 0 || src[6] != 0 || src[7] != 0) return false;
+	uint32 blockSize = xxh64_read32(src + 12);
+	return blockSize != 0 && blockSize <= 0x10000000;
+}
+
+//Unwraps a compressed frame. Returns false if src isn't a well-formed frame or fails its checksum.
+static bool DecompressFrame(const unsigned char* src, uint32 length, std::vector<unsigned char>& out)
+{
+	if (!IsCompressedFrame(src, length) || src[4] != kFrameCodecLZ4) return false;
+	
+	uint32 rawSize = xxh64_read32(src + 8);
+	uint32 blockSize = xxh64_read32(src + 12);
+	uint32 checksum = xxh64_read32(src + 16);
+	if (blockSize == 0 || blockSize > 0x10000000) return false;
+	if ((uint64)rawSize > (uint64)length * 255) return false;
+	
+	uint32 blockCount = (uint32)(((uint64)rawSize + blockSize - 1) / blockSize);
+	if ((uint64)kFrameHeaderSize + (uint64)blockCount * 4 > length) return false;
+	
+	const unsigned char* table = src + kFrameHeaderSize;
+	const unsigned char* ip = table + blockCount * 4;
+	const unsigned char* ipEnd = src + length;
+	
+	out.resize(rawSize);
+	for (uint32 i = 0; i < blockCount; i++)
+	{
+		uint32 entry = xxh64_read32(table + i * 4);
+		uint32 packed = entry & ~kFrameStoredBlock;
+		uint32 offset = i * blockSize;
+		uint32 rawLength = (rawSize - offset < blockSize) ? (rawSize - offset) : blockSize;
+		
+		if (packed > (uint32)(ipEnd - ip)) return false;
+		if (entry & kFrameStoredBlock)
+		{
+			if (packed != rawLength) return false;
+			memcpy(out.data() + offset, ip, rawLength);
+		}
+		else if (lz4_decompress_block(ip, packed, out.data() + offset, rawLength) != (int)rawLength)
+		{
+			return false;
+		}
+		ip += packed;
+	}
+	
+	return (uint32)xxh64(out.data(), rawSize, 0) == checksum;
+}
+
 #pragma endregion
 
 #pragma region Macros
@@ -139,73 +661,620 @@ AutoGCRoot *g_eventHandler = 0;
 
 #pragma endregion
 
-#pragma region Events & callbacks
-//-----------------------------------------------------------------------------------------------------------
-// Event
-//-----------------------------------------------------------------------------------------------------------
-static const char* kEventTypeNone = "None";
-static const char* kEventTypeOnGamepadTextInputDismissed = "GamepadTextInputDismissed";
-static const char* kEventTypeOnUserStatsReceived = "UserStatsReceived";
-static const char* kEventTypeOnUserStatsStored = "UserStatsStored";
-static const char* kEventTypeOnUserAchievementStored = "UserAchievementStored";
-static const char* kEventTypeOnLeaderboardFound = "LeaderboardFound";
-static const char* kEventTypeOnScoreUploaded = "ScoreUploaded";
-static const char* kEventTypeOnScoreDownloaded = "ScoreDownloaded";
-static const char* kEventTypeOnGlobalStatsReceived = "GlobalStatsReceived";
-static const char* kEventTypeUGCLegalAgreement = "UGCLegalAgreementStatus";
-static const char* kEventTypeUGCItemCreated = "UGCItemCreated";
-static const char* kEventTypeOnItemUpdateSubmitted = "UGCItemUpdateSubmitted";
-static const char* kEventTypeOnFileShared = "RemoteStorageFileShared";
-static const char* kEventTypeOnEnumerateUserSharedWorkshopFiles = "UserSharedWorkshopFilesEnumerated";
-static const char* kEventTypeOnEnumerateUserPublishedFiles = "UserPublishedFilesEnumerated";
-static const char* kEventTypeOnEnumerateUserSubscribedFiles = "UserSubscribedFilesEnumerated";
-static const char* kEventTypeOnUGCDownload = "UGCDownloaded";
-static const char* kEventTypeOnGetPublishedFileDetails = "PublishedFileDetailsGotten";
-static const char* kEventTypeOnDownloadItem = "ItemDownloaded";
-static const char* kEventTypeOnItemInstalled = "ItemInstalled";
-static const char* kEventTypeOnUGCQueryCompleted = "UGCQueryCompleted";
-static const char* kEventTypeOnLobbyJoined = "LobbyJoined";
-static const char* kEventTypeOnLobbyJoinRequested = "LobbyJoinRequested";
-static const char* kEventTypeOnLobbyCreated = "LobbyCreated";
-static const char* kEventTypeOnLobbyListReceived = "LobbyListReceived";
+#pragma region Stats cache
+//Stats the game registers up front get interned to small integer ids and mirrored here, so hot code can
+//read and write them in bulk without passing strings or going through ISteamUserStats for every value.
+//Writes only mark entries dirty; CommitStats pushes the dirty ones to Steam in one go.
+struct CachedStat
+{
+	std::string name;
+	bool isFloat;
+	bool loaded;	//whether the value has been read from Steam yet
+	bool dirty;		//whether the value was changed since the last commit
+	int32 iValue;
+	float fValue;
+};
 
-//A simple data structure that holds on to the native 64-bit handles and maps them to regular ints.
-//This is because it is cumbersome to pass back 64-bit values over CFFI, and strictly speaking, the haxe 
-//side never needs to know the actual values. So we just store the full 64-bit values locally and pass back 
-//0-based index values which easily fit into a regular int.
-class steamHandleMap
+static std::vector<CachedStat> s_statCache;
+static std::map<std::string, int> s_statCacheIds;
+static bool s_statCacheReady = false;
+
+static void StatCacheLoadEntry(CachedStat& stat)
 {
-	//TODO: figure out templating or whatever so I can make typed versions of this like in Haxe (steamHandleMap<ControllerHandle_t>)
-	//      all the steam handle typedefs are just renamed uint64's, but this could always change so to be 100% super safe I should
-	//      figure out the templating stuff.
+	//never overwrite a value the game set before Steam answered
+	if (stat.dirty) return;
 	
-	private:
-		std::map<int, uint64> values;
-		std::map<int, uint64>::iterator it;
-		int maxKey;
-		
-	public:
-		
-		void init()
-		{
-			values.clear();
-			maxKey = -1;
-		}
+	bool ok = stat.isFloat ?
+		SteamUserStats()->GetStat(stat.name.c_str(), &stat.fValue) :
+		SteamUserStats()->GetStat(stat.name.c_str(), &stat.iValue);
+	stat.loaded = ok;
+}
+
+//Called once the current user's stats have arrived
+static void StatCacheLoad()
+{
+	s_statCacheReady = true;
+	for (size_t i = 0; i < s_statCache.size(); i++)
+	{
+		StatCacheLoadEntry(s_statCache[i]);
+	}
+}
+
+inline CachedStat* StatCacheGet(int id)
+{
+	if (id < 0 || id >= (int)s_statCache.size()) return NULL;
+	return &s_statCache[id];
+}
+
+inline CachedStat* StatCacheFind(const char* name)
+{
+	std::map<std::string, int>::iterator it = s_statCacheIds.find(name);
+	return it == s_statCacheIds.end() ? NULL : &s_statCache[it->second];
+}
+
+//The by-name stat calls (SetStat & co.) go to Steam directly; these keep a registered stat's entry in step
+//with them, replacing any uncommitted value so a later CommitStats doesn't undo the write
+static void StatCacheWrote(const char* name, int32 value)
+{
+	CachedStat* stat = StatCacheFind(name);
+	if (stat == NULL || stat->isFloat) return;
+	stat->iValue = value;
+	stat->loaded = true;
+	stat->dirty = false;
+}
+
+static void StatCacheWrote(const char* name, float value)
+{
+	CachedStat* stat = StatCacheFind(name);
+	if (stat == NULL || !stat->isFloat) return;
+	stat->fValue = value;
+	stat->loaded = true;
+	stat->dirty = false;
+}
+
+//Writes every dirty stat to ISteamUserStats and returns how many were written
+static int StatCacheCommit()
+{
+	int written = 0;
+	for (size_t i = 0; i < s_statCache.size(); i++)
+	{
+		CachedStat& stat = s_statCache[i];
+		if (!stat.dirty) continue;
 		
-		bool exists(uint64 val)
+		bool ok = stat.isFloat ?
+			SteamUserStats()->SetStat(stat.name.c_str(), stat.fValue) :
+			SteamUserStats()->SetStat(stat.name.c_str(), stat.iValue);
+		if (ok)
 		{
-			return find(val) >= 0;
+			stat.dirty = false;
+			written++;
 		}
-		
-		int find(uint64 val)
-		{
-			for(int i = 0; i <= maxKey; i++)
-			{
-				if(values[i] == val)
-				{
-					return i;
-				}
-			}
+	}
+	return written;
+}
+
+static void JournalStoreIssued();
+
+//Coalesces StoreStats requests: gameplay code can ask for a store as often as it likes, and the pump turns
+//all requests made within `window` seconds into a single StoreStats, never closer than `minInterval` to the
+//previous one. A store that failed for a transient reason is retried with exponential backoff.
+struct StoreScheduler
+{
+	double window;
+	double minInterval;
+	double maxBackoff;
+	
+	bool pending;		//a store was requested and hasn't been issued yet
+	bool inFlight;		//StoreStats was called and UserStatsStored hasn't arrived yet
+	double requestedAt;	//time of the first request since the last store was issued
+	double lastStoreAt;
+	double retryAt;
+	double backoff;
+	int requests;		//requests folded into the pending/in-flight store
+};
+
+static const double kStoreInitialBackoff = 1.0;
+static StoreScheduler s_storeScheduler = { 1.0, 5.0, 60.0, false, false, 0, -1e9, 0, kStoreInitialBackoff, 0 };
+
+static void StoreSchedulerRequest()
+{
+	StoreScheduler& s = s_storeScheduler;
+	if (!s.pending)
+	{
+		s.pending = true;
+		s.requestedAt = NowSeconds();
+	}
+	s.requests++;
+}
+
+//Called from the callback pump; issues the coalesced store once it is due
+static void StoreSchedulerUpdate()
+{
+	StoreScheduler& s = s_storeScheduler;
+	if (!s.pending || s.inFlight) return;
+	
+	double now = NowSeconds();
+	if (now < s.requestedAt + s.window || now < s.lastStoreAt + s.minInterval || now < s.retryAt) return;
+	
+	StatCacheCommit();
+	s.lastStoreAt = now;
+	if (SteamUserStats()->StoreStats())
+	{
+		s.pending = false;
+		s.inFlight = true;
+		JournalStoreIssued();
+	}
+	else
+	{
+		s.retryAt = now + s.backoff;
+		s.backoff = s.backoff * 2 < s.maxBackoff ? s.backoff * 2 : s.maxBackoff;
+	}
+}
+
+//Results worth storing again; anything else (e.g. k_EResultInvalidParam, the server rejected and reverted
+//the values) won't go better on a retry
+static bool StoreResultTransient(EResult result)
+{
+	switch (result)
+	{
+		case k_EResultFail:
+		case k_EResultNoConnection:
+		case k_EResultBusy:
+		case k_EResultTimeout:
+		case k_EResultRateLimitExceeded:
+			return true;
+		default:
+			return false;
+	}
+}
+
+//Called on UserStatsStored; returns whether the result belonged to a scheduled store
+static bool StoreSchedulerStored(EResult result, int* requests)
+{
+	StoreScheduler& s = s_storeScheduler;
+	if (!s.inFlight) return false;
+	s.inFlight = false;
+	
+	if (result == k_EResultOK || !StoreResultTransient(result))
+	{
+		*requests = s.requests;
+		s.requests = 0;
+		s.backoff = kStoreInitialBackoff;
+		s.retryAt = 0;
+	}
+	else
+	{
+		//requests made while this store was in flight are already pending; either way try again after backing off
+		if (!s.pending)
+		{
+			s.pending = true;
+			s.requestedAt = NowSeconds();
+		}
+		s.retryAt = NowSeconds() + s.backoff;
+		s.backoff = s.backoff * 2 < s.maxBackoff ? s.backoff * 2 : s.maxBackoff;
+	}
+	return true;
+}
+
+//Packed snapshot of every achievement, rebuilt lazily whenever anything it shows may have changed
+static PackedWriter s_achievementSnapshot;
+static bool s_achievementSnapshotValid = false;
+static bool s_achievementPercentsRequested = false;
+static bool s_achievementPercentsReady = false;
+
+inline void AchievementSnapshotInvalidate()
+{
+	s_achievementSnapshotValid = false;
+}
+
+//Achievement progress indicators queued by the game. Only the latest progress per achievement is kept, and the
+//pump shows at most one indicator per achievement per interval, so fast-ticking counters don't spam the overlay.
+struct QueuedProgress
+{
+	uint32 current;
+	uint32 max;
+	bool pending;
+	double lastShownAt;
+};
+
+static std::map<std::string, QueuedProgress> s_progressQueue;
+static int s_progressPending = 0;
+static double s_progressInterval = 2.0;
+
+static void ProgressQueueDrop(const char* name)
+{
+	std::map<std::string, QueuedProgress>::iterator it = s_progressQueue.find(name);
+	if (it == s_progressQueue.end()) return;
+	if (it->second.pending) s_progressPending--;
+	s_progressQueue.erase(it);
+}
+
+static void ProgressQueueUpdate()
+{
+	double now = NowSeconds();
+	for (std::map<std::string, QueuedProgress>::iterator it = s_progressQueue.begin(); it != s_progressQueue.end(); ++it)
+	{
+		QueuedProgress& p = it->second;
+		if (!p.pending || now < p.lastShownAt + s_progressInterval) continue;
+		
+		SteamUserStats()->IndicateAchievementProgress(it->first.c_str(), p.current, p.max);
+		p.pending = false;
+		p.lastShownAt = now;
+		s_progressPending--;
+	}
+}
+
+//Stat and achievement writes made while Steam isn't reachable (CheckInit fails) are kept in an append-only
+//journal, in memory and, once a path is set, in a local file so they survive a restart. The journal is replayed
+//in one batch as soon as the user's stats arrive while logged on:
+//  - stat values are high-water marks: they only ever raise the stat, so replaying twice is harmless and an
+//    offline session can't lower a value the server got from another machine in the meantime
+//  - deltas are summed and added to the current value
+//  - unlocks are only applied to achievements that aren't unlocked yet
+//The file is only emptied once the scheduled store carrying the replay comes back OK; if the game quits before
+//that, the next session replays it again (harmless for all but deltas).
+//File layout: "SWJ1" then records of op:u8 | nameLength:u16 | name | value:8 bytes (int64 or double)
+enum JournalOp
+{
+	kJournalStatMaxInt = 1,
+	kJournalStatMaxFloat = 2,
+	kJournalStatAddInt = 3,
+	kJournalUnlock = 4
+};
+
+struct JournalEntry
+{
+	uint8 op;
+	std::string name;
+	int64 iValue;
+	double fValue;
+};
+
+static const char kJournalMagic[4] = { 'S', 'W', 'J', '1' };
+static std::vector<JournalEntry> s_journal;
+static std::vector<JournalEntry> s_journalUnconfirmed;	//replayed, but not stored on the server yet
+static bool s_journalStoreIssued = false;				//a scheduled store carrying s_journalUnconfirmed went out
+static std::string s_journalPath;
+static double s_journalNextStatsRequest = 0;
+static const double kJournalStatsRequestInterval = 10.0;
+
+static void JournalAppendToFile(const JournalEntry& e)
+{
+	if (s_journalPath.empty()) return;
+	FILE* f = fopen(s_journalPath.c_str(), "ab");
+	if (f == NULL) return;
+	
+	//the position right after opening for append isn't reliably the end (MSVC reports 0)
+	fseek(f, 0, SEEK_END);
+	if (ftell(f) == 0) fwrite(kJournalMagic, 1, 4, f);
+	uint16 nameLength = (uint16)(e.name.size() < 0xFFFF ? e.name.size() : 0xFFFF);
+	unsigned char value[8];
+	if (e.op == kJournalStatMaxFloat) memcpy(value, &e.fValue, 8);
+	else memcpy(value, &e.iValue, 8);
+	
+	fwrite(&e.op, 1, 1, f);
+	fwrite(&nameLength, 2, 1, f);
+	fwrite(e.name.data(), 1, nameLength, f);
+	fwrite(value, 1, 8, f);
+	fclose(f);
+}
+
+static void JournalRecord(uint8 op, const char* name, int64 iValue, double fValue)
+{
+	JournalEntry e;
+	e.op = op;
+	e.name = name;
+	e.iValue = iValue;
+	e.fValue = fValue;
+	s_journal.push_back(e);
+	JournalAppendToFile(e);
+}
+
+//Picks up whatever an earlier session left in the journal file; a torn record at the end is ignored
+static void JournalLoad(const char* path)
+{
+	s_journalPath = path;
+	FILE* f = fopen(path, "rb");
+	if (f == NULL) return;
+	
+	std::vector<unsigned char> data;
+	unsigned char chunk[4096];
+	size_t n;
+	while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0) data.insert(data.end(), chunk, chunk + n);
+	fclose(f);
+	
+	if (data.size() < 4 || memcmp(data.data(), kJournalMagic, 4) != 0) return;
+	
+	size_t pos = 4;
+	while (pos + 3 <= data.size())
+	{
+		JournalEntry e;
+		e.op = data[pos];
+		uint16 nameLength;
+		memcpy(&nameLength, &data[pos + 1], 2);
+		if (pos + 3 + nameLength + 8 > data.size()) break;
+		
+		e.name.assign((const char*)&data[pos + 3], nameLength);
+		const unsigned char* value = &data[pos + 3 + nameLength];
+		e.iValue = 0;
+		e.fValue = 0;
+		if (e.op == kJournalStatMaxFloat) memcpy(&e.fValue, value, 8);
+		else memcpy(&e.iValue, value, 8);
+		
+		if (e.op >= kJournalStatMaxInt && e.op <= kJournalUnlock) s_journal.push_back(e);
+		pos += 3 + nameLength + 8;
+	}
+}
+
+//Rewrites the file with whatever still needs to survive a restart
+static void JournalRewriteFile()
+{
+	if (s_journalPath.empty()) return;
+	remove(s_journalPath.c_str());
+	for (size_t i = 0; i < s_journalUnconfirmed.size(); i++) JournalAppendToFile(s_journalUnconfirmed[i]);
+	for (size_t i = 0; i < s_journal.size(); i++) JournalAppendToFile(s_journal[i]);
+}
+
+//The highest value journaled for a stat, if any
+static bool JournalMaxValue(const char* name, bool isFloat, double* out)
+{
+	bool found = false;
+	const std::vector<JournalEntry>* lists[2] = { &s_journalUnconfirmed, &s_journal };
+	for (int l = 0; l < 2; l++)
+	{
+		for (size_t i = 0; i < lists[l]->size(); i++)
+		{
+			const JournalEntry& e = (*lists[l])[i];
+			if (e.op != (isFloat ? kJournalStatMaxFloat : kJournalStatMaxInt) || e.name != name) continue;
+			double v = isFloat ? e.fValue : (double)e.iValue;
+			if (!found || v > *out) *out = v;
+			found = true;
+		}
+	}
+	return found;
+}
+
+static void JournalStoreIssued()
+{
+	if (!s_journalUnconfirmed.empty()) s_journalStoreIssued = true;
+}
+
+//Called when a scheduled store came back OK
+static void JournalStoreConfirmed()
+{
+	if (!s_journalStoreIssued) return;
+	s_journalStoreIssued = false;
+	s_journalUnconfirmed.clear();
+	JournalRewriteFile();
+}
+
+//Journals an offline stat set. Since replay only ever raises a stat, a set below a value we already know of
+//(journaled, or in the stats cache) would silently do nothing, so it's refused instead.
+static bool JournalStatSet(const char* name, bool isFloat, double v)
+{
+	double known = 0;
+	if (JournalMaxValue(name, isFloat, &known) && v < known) return false;
+	CachedStat* stat = StatCacheFind(name);
+	if (stat != NULL && stat->loaded && stat->isFloat == isFloat && v < (isFloat ? (double)stat->fValue : (double)stat->iValue)) return false;
+	
+	JournalRecord(isFloat ? kJournalStatMaxFloat : kJournalStatMaxInt, name, isFloat ? 0 : (int64)v, isFloat ? v : 0);
+	return true;
+}
+
+//Applies the journal to the freshly received stats; returns how many entries were replayed
+static int JournalReplay()
+{
+	if (s_journal.empty()) return 0;
+	ISteamUserStats* stats = SteamUserStats();
+	
+	//fold the journal down to one write per stat/achievement first
+	std::map<std::string, int64> maxInts;
+	std::map<std::string, double> maxFloats;
+	std::map<std::string, int64> adds;
+	std::set<std::string> unlocks;
+	for (size_t i = 0; i < s_journal.size(); i++)
+	{
+		const JournalEntry& e = s_journal[i];
+		switch (e.op)
+		{
+			case kJournalStatMaxInt:
+				if (maxInts.count(e.name) == 0 || e.iValue > maxInts[e.name]) maxInts[e.name] = e.iValue;
+				break;
+			case kJournalStatMaxFloat:
+				if (maxFloats.count(e.name) == 0 || e.fValue > maxFloats[e.name]) maxFloats[e.name] = e.fValue;
+				break;
+			case kJournalStatAddInt:
+				adds[e.name] += e.iValue;
+				break;
+			case kJournalUnlock:
+				unlocks.insert(e.name);
+				break;
+		}
+	}
+	
+	for (std::map<std::string, int64>::iterator it = maxInts.begin(); it != maxInts.end(); ++it)
+	{
+		int32 current = 0;
+		if (stats->GetStat(it->first.c_str(), &current) && it->second > current)
+			stats->SetStat(it->first.c_str(), (int32)it->second);
+	}
+	for (std::map<std::string, double>::iterator it = maxFloats.begin(); it != maxFloats.end(); ++it)
+	{
+		float current = 0;
+		if (stats->GetStat(it->first.c_str(), &current) && it->second > current)
+			stats->SetStat(it->first.c_str(), (float)it->second);
+	}
+	for (std::map<std::string, int64>::iterator it = adds.begin(); it != adds.end(); ++it)
+	{
+		int32 current = 0;
+		if (stats->GetStat(it->first.c_str(), &current))
+			stats->SetStat(it->first.c_str(), (int32)(current + it->second));
+	}
+	for (std::set<std::string>::iterator it = unlocks.begin(); it != unlocks.end(); ++it)
+	{
+		bool achieved = false;
+		if (stats->GetAchievement(it->c_str(), &achieved) && !achieved)
+			stats->SetAchievement(it->c_str());
+	}
+	
+	//the file keeps these until the store carrying them is confirmed
+	int replayed = (int)s_journal.size();
+	s_journalUnconfirmed.insert(s_journalUnconfirmed.end(), s_journal.begin(), s_journal.end());
+	s_journalStoreIssued = false;
+	s_journal.clear();
+	StoreSchedulerRequest();
+	return replayed;
+}
+
+#pragma endregion
+
+#pragma region Persona cache
+//Persona names of other users, as far as we've seen them. Unknown users get one RequestUserInformation each,
+//and names that arrive through PersonaStateChange_t are collected and handed to Haxe in a single batched
+//event from the callback pump, so a leaderboard page or lobby fills in with one event instead of one per row.
+static std::map<uint64, std::string> s_personaNames;
+static std::set<uint64> s_personaRequested;
+static std::vector<uint64> s_personaResolved;	//names that arrived since the last batch went out
+
+static void PersonaCacheStore(uint64 id)
+{
+	const char* name = SteamFriends()->GetFriendPersonaName(CSteamID(id));
+	s_personaNames[id] = name ? name : "";
+}
+
+//Returns the cached name, or NULL if it isn't known yet (in which case it has been requested)
+static const char* PersonaCacheLookup(uint64 id)
+{
+	std::map<uint64, std::string>::iterator it = s_personaNames.find(id);
+	if (it != s_personaNames.end()) return it->second.c_str();
+	
+	if (s_personaRequested.count(id) == 0)
+	{
+		//false means Steam already has the name and no callback will follow
+		if (!SteamFriends()->RequestUserInformation(CSteamID(id), true))
+		{
+			PersonaCacheStore(id);
+			return s_personaNames[id].c_str();
+		}
+		s_personaRequested.insert(id);
+	}
+	return NULL;
+}
+
+static void PersonaCacheChanged(uint64 id, bool nameChanged)
+{
+	bool requested = s_personaRequested.erase(id) > 0;
+	bool cached = s_personaNames.count(id) > 0;
+	if (!requested && !(cached && nameChanged)) return;
+	
+	PersonaCacheStore(id);
+	s_personaResolved.push_back(id);
+}
+
+//Packs the batch of newly resolved names as count:u32, then (steamID:u64, name:str) per user
+static bool PersonaCacheTakeResolved(PackedWriter& w)
+{
+	if (s_personaResolved.empty()) return false;
+	
+	w.u32((uint32)s_personaResolved.size());
+	for (size_t i = 0; i < s_personaResolved.size(); i++)
+	{
+		w.u64(s_personaResolved[i]);
+		w.str(s_personaNames[s_personaResolved[i]]);
+	}
+	s_personaResolved.clear();
+	return true;
+}
+
+#pragma endregion
+
+#pragma region Events & callbacks
+//-----------------------------------------------------------------------------------------------------------
+// Event
+//-----------------------------------------------------------------------------------------------------------
+static const char* kEventTypeNone = "None";
+static const char* kEventTypeOnGamepadTextInputDismissed = "GamepadTextInputDismissed";
+static const char* kEventTypeOnUserStatsReceived = "UserStatsReceived";
+static const char* kEventTypeOnUserStatsStored = "UserStatsStored";
+static const char* kEventTypeOnScheduledStatsStored = "ScheduledStatsStored";
+static const char* kEventTypeOnStatsJournalReplayed = "StatsJournalReplayed";
+static const char* kEventTypeOnUserAchievementStored = "UserAchievementStored";
+static const char* kEventTypeOnLeaderboardFound = "LeaderboardFound";
+static const char* kEventTypeOnScoreUploaded = "ScoreUploaded";
+static const char* kEventTypeOnScoreDownloaded = "ScoreDownloaded";
+static const char* kEventTypeOnGlobalStatsReceived = "GlobalStatsReceived";
+static const char* kEventTypeOnGlobalAchievementPercentagesReady = "GlobalAchievementPercentagesReady";
+static const char* kEventTypeUGCLegalAgreement = "UGCLegalAgreementStatus";
+static const char* kEventTypeUGCItemCreated = "UGCItemCreated";
+static const char* kEventTypeOnItemUpdateSubmitted = "UGCItemUpdateSubmitted";
+static const char* kEventTypeOnFileShared = "RemoteStorageFileShared";
+static const char* kEventTypeOnEnumerateUserSharedWorkshopFiles = "UserSharedWorkshopFilesEnumerated";
+static const char* kEventTypeOnEnumerateUserPublishedFiles = "UserPublishedFilesEnumerated";
+static const char* kEventTypeOnEnumerateUserSubscribedFiles = "UserSubscribedFilesEnumerated";
+static const char* kEventTypeOnUGCDownload = "UGCDownloaded";
+static const char* kEventTypeOnGetPublishedFileDetails = "PublishedFileDetailsGotten";
+static const char* kEventTypeOnDownloadItem = "ItemDownloaded";
+static const char* kEventTypeOnItemInstalled = "ItemInstalled";
+static const char* kEventTypeOnUGCQueryCompleted = "UGCQueryCompleted";
+static const char* kEventTypeOnLobbyJoined = "LobbyJoined";
+static const char* kEventTypeOnLobbyJoinRequested = "LobbyJoinRequested";
+static const char* kEventTypeOnLobbyCreated = "LobbyCreated";
+static const char* kEventTypeOnLobbyListReceived = "LobbyListReceived";
+static const char* kEventTypeOnPersonaNamesResolved = "PersonaNamesResolved";
+static const char* kEventTypeOnManagedLeaderboardFound = "ManagedLeaderboardFound";
+static const char* kEventTypeOnManagedScoreUploaded = "ManagedScoreUploaded";
+static const char* kEventTypeOnManagedScoresDownloaded = "ManagedScoresDownloaded";
+static const char* kEventTypeOnReplayAttached = "ReplayAttached";
+static const char* kEventTypeOnReplayDownloaded = "ReplayDownloaded";
+static const char* kEventTypeOnUGCCursorPage = "UGCCursorPage";
+static const char* kEventTypeOnUGCDetailsRefreshed = "UGCDetailsRefreshed";
+static const char* kEventTypeOnUGCDetailsQueried = "UGCDetailsQueried";
+static const char* kEventTypeOnWorkshopDownloadProgress = "WorkshopDownloadProgress";
+static const char* kEventTypeOnWorkshopDownloadFinished = "WorkshopDownloadFinished";
+static const char* kEventTypeOnUGCStreamProgress = "UGCStreamProgress";
+static const char* kEventTypeOnUGCStreamFinished = "UGCStreamFinished";
+static const char* kEventTypeOnWorkshopIndexed = "WorkshopIndexed";
+static const char* kEventTypeOnWorkshopFilesUnmapped = "WorkshopFilesUnmapped";
+static const char* kEventTypeOnUGCItemPublished = "UGCItemPublished";
+static const char* kEventTypeOnUGCBatchPublished = "UGCBatchPublished";
+
+//A simple data structure that holds on to the native 64-bit handles and maps them to regular ints.
+//This is because it is cumbersome to pass back 64-bit values over CFFI, and strictly speaking, the haxe 
+//side never needs to know the actual values. So we just store the full 64-bit values locally and pass back 
+//0-based index values which easily fit into a regular int.
+class steamHandleMap
+{
+	//TODO: figure out templating or whatever so I can make typed versions of this like in Haxe (steamHandleMap<ControllerHandle_t>)
+	//      all the steam handle typedefs are just renamed uint64's, but this could always change so to be 100% super safe I should
+	//      figure out the templating stuff.
+	
+	private:
+		std::map<int, uint64> values;
+		std::map<int, uint64>::iterator it;
+		int maxKey;
+		
+	public:
+		
+		void init()
+		{
+			values.clear();
+			maxKey = -1;
+		}
+		
+		bool exists(uint64 val)
+		{
+			return find(val) >= 0;
+		}
+		
+		int find(uint64 val)
+		{
+			for(int i = 0; i <= maxKey; i++)
+			{
+				if(values[i] == val)
+				{
+					return i;
+				}
+			}
 			return -1;
 		}
 		
@@ -259,6 +1328,23 @@ static void SendEvent(const Event& e)
     val_call1(g_eventHandler->get(), obj);
 }
 
+//Results that are known as soon as they're asked for (cache hits and the like) still go out from RunCallbacks,
+//after the call that asked for them has returned its request id
+static std::vector<std::function<void()> > s_deferredEvents;
+
+static void DeferEvent(const std::function<void()>& send)
+{
+	s_deferredEvents.push_back(send);
+}
+
+static void FlushDeferredEvents()
+{
+	if (s_deferredEvents.empty()) return;
+	std::vector<std::function<void()> > ready;
+	ready.swap(s_deferredEvents);
+	for (size_t i = 0; i < ready.size(); i++) ready[i]();
+}
+
 // This is not used and produces compilation error on Linux.
 
 // static value handleToValStr(uint64 handle)
@@ -275,6 +1361,66 @@ static void SendEvent(const Event& e)
 	// return c_handle;
 // }
 
+//-----------------------------------------------------------------------------------------------------------
+// SteamCall
+//-----------------------------------------------------------------------------------------------------------
+//CallbackHandler has one CCallResult per kind of request, so only one request of each kind can be in flight.
+//Subsystems that want many requests at once start a SteamCall per request instead: it owns its own CCallResult
+//and hands the result to a handler. Finished calls are deleted by SweepSteamCalls() after the callback pump.
+class SteamCallBase
+{
+public:
+	SteamCallBase() : m_done(false) {}
+	virtual ~SteamCallBase() {}
+	bool done() const { return m_done; }
+protected:
+	bool m_done;
+};
+
+template<typename T>
+class SteamCall : public SteamCallBase
+{
+public:
+	typedef std::function<void(T*, bool)> Handler;
+	
+	SteamCall(SteamAPICall_t call, const Handler& handler) : m_handler(handler)
+	{
+		m_callResult.Set(call, this, &SteamCall<T>::OnResult);
+	}
+	
+private:
+	void OnResult(T* result, bool ioFailure)
+	{
+		m_done = true;
+		m_handler(result, ioFailure);
+	}
+	
+	CCallResult<SteamCall<T>, T> m_callResult;
+	Handler m_handler;
+};
+
+static std::vector<SteamCallBase*> s_steamCalls;
+
+//Returns false (without calling the handler) if Steam didn't accept the request
+template<typename T>
+static bool StartSteamCall(SteamAPICall_t call, const typename SteamCall<T>::Handler& handler)
+{
+	if (call == k_uAPICallInvalid) return false;
+	s_steamCalls.push_back(new SteamCall<T>(call, handler));
+	return true;
+}
+
+static void SweepSteamCalls(bool all)
+{
+	size_t kept = 0;
+	for (size_t i = 0; i < s_steamCalls.size(); i++)
+	{
+		if (all || s_steamCalls[i]->done()) delete s_steamCalls[i];
+		else s_steamCalls[kept++] = s_steamCalls[i];
+	}
+	s_steamCalls.resize(kept);
+}
+
 //-----------------------------------------------------------------------------------------------------------
 // CallbackHandler
 //-----------------------------------------------------------------------------------------------------------
@@ -301,6 +1447,8 @@ public:
 	STEAM_CALLBACK( CallbackHandler, OnDownloadItem, DownloadItemResult_t, m_CallbackDownloadItemResult );
 	STEAM_CALLBACK( CallbackHandler, OnItemInstalled, ItemInstalled_t, m_CallbackItemInstalled );
 	STEAM_CALLBACK( CallbackHandler, OnLobbyJoinRequested, GameLobbyJoinRequested_t );
+	STEAM_CALLBACK( CallbackHandler, OnPersonaStateChange, PersonaStateChange_t );
+	STEAM_CALLBACK( CallbackHandler, OnItemUnsubscribed, RemoteStoragePublishedFileUnsubscribed_t );
 	
 	void FindLeaderboard(const char* name);
 	void OnLeaderboardFound( LeaderboardFindResult_t *pResult, bool bIOFailure);
@@ -314,10 +1462,14 @@ public:
 	void OnScoreDownloaded( LeaderboardScoresDownloaded_t *pResult, bool bIOFailure);
 	CCallResult<CallbackHandler, LeaderboardScoresDownloaded_t> m_callResultDownloadScore;
 
-	void RequestGlobalStats();
+	void RequestGlobalStats(int historyDays);
 	void OnGlobalStatsReceived(GlobalStatsReceived_t* pResult, bool bIOFailure);
 	CCallResult<CallbackHandler, GlobalStatsReceived_t> m_callResultRequestGlobalStats;
 
+	void RequestGlobalAchievementPercentages();
+	void OnGlobalAchievementPercentagesReady(GlobalAchievementPercentagesReady_t* pResult, bool bIOFailure);
+	CCallResult<CallbackHandler, GlobalAchievementPercentagesReady_t> m_callResultGlobalAchievementPercentages;
+
 	void CreateUGCItem(AppId_t nConsumerAppId, EWorkshopFileType eFileType);
 	void OnUGCItemCreated( CreateItemResult_t *pResult, bool bIOFailure);
 	CCallResult<CallbackHandler, CreateItemResult_t> m_callResultCreateUGCItem;
@@ -377,18 +1529,53 @@ void CallbackHandler::OnGamepadTextInputDismissed( GamepadTextInputDismissed_t *
 void CallbackHandler::OnUserStatsReceived( UserStatsReceived_t *pCallback )
 {
  	if (pCallback->m_nGameID != SteamUtils()->GetAppID()) return;
-	SendEvent(Event(kEventTypeOnUserStatsReceived, pCallback->m_eResult == k_EResultOK));
+	int replayed = 0;
+	if (pCallback->m_eResult == k_EResultOK && pCallback->m_steamIDUser == SteamUser()->GetSteamID())
+	{
+		//replay before filling the cache so it sees the replayed values
+		replayed = JournalReplay();
+		StatCacheLoad();
+		AchievementSnapshotInvalidate();
+	}
+	SendEvent(Event(kEventTypeOnUserStatsReceived, pCallback->m_eResult == k_EResultOK));
+	
+	if (replayed > 0)
+	{
+		std::ostringstream data;
+		data << replayed;
+		SendEvent(Event(kEventTypeOnStatsJournalReplayed, true, data.str()));
+	}
 }
 
 void CallbackHandler::OnUserStatsStored( UserStatsStored_t *pCallback )
 {
  	if (pCallback->m_nGameID != SteamUtils()->GetAppID()) return;
-	SendEvent(Event(kEventTypeOnUserStatsStored, pCallback->m_eResult == k_EResultOK));
+	
+	//every result is forwarded; stores issued by the scheduler are marked so the Haxe side leaves retrying
+	//them to the scheduler, and additionally report how many requests went through
+	bool success = pCallback->m_eResult == k_EResultOK;
+	int requests = 0;
+	bool scheduled = StoreSchedulerStored(pCallback->m_eResult, &requests);
+	SendEvent(Event(kEventTypeOnUserStatsStored, success, scheduled ? "scheduled" : ""));
+	
+	if (scheduled && success)
+	{
+		JournalStoreConfirmed();
+		std::ostringstream data;
+		data << requests;
+		SendEvent(Event(kEventTypeOnScheduledStatsStored, true, data.str()));
+	}
 }
 
 void CallbackHandler::OnAchievementStored( UserAchievementStored_t *pCallback )
 {
  	if (pCallback->m_nGameID != SteamUtils()->GetAppID()) return;
+	AchievementSnapshotInvalidate();
+	//a max progress of 0 means this is the unlock itself rather than a progress notification
+	if (pCallback->m_nMaxProgress == 0)
+	{
+		ProgressQueueDrop(pCallback->m_rgchAchievementName);
+	}
 	SendEvent(Event(kEventTypeOnUserAchievementStored, true, pCallback->m_rgchAchievementName));
 }
 
@@ -584,6 +1771,39 @@ bool CallbackHandler::DownloadScores(const std::string& leaderboardId, int downl
  	return true;
 }
 
+//Downloaded entries go to Haxe as one packed table:
+//  leaderboardName:str | count:u32, then per entry:
+//  steamID:u64 | globalRank:i32 | score:i32 | detailCount:u32 | details:i32[detailCount] | ugcHandle:u64 | name:str
+//name is empty if the persona cache doesn't know it yet; it then arrives with the next PersonaNamesResolved event.
+static void PackLeaderboardEntries(PackedWriter& w, const char* leaderboardName, SteamLeaderboardEntries_t entries, int count)
+{
+	int32 details[k_cLeaderboardDetailsMax];
+	
+	w.str(leaderboardName);
+	w.u32((uint32)count);
+	for (int i = 0; i < count; i++)
+	{
+		LeaderboardEntry_t entry;
+		if (!SteamUserStats()->GetDownloadedLeaderboardEntry(entries, i, &entry, details, k_cLeaderboardDetailsMax))
+		{
+			entry = LeaderboardEntry_t();
+		}
+		int detailCount = entry.m_cDetails;
+		if (detailCount < 0) detailCount = 0;
+		if (detailCount > k_cLeaderboardDetailsMax) detailCount = k_cLeaderboardDetailsMax;
+		
+		w.u64(entry.m_steamIDUser.ConvertToUint64());
+		w.i32(entry.m_nGlobalRank);
+		w.i32(entry.m_nScore);
+		w.u32((uint32)detailCount);
+		w.raw(details, detailCount * sizeof(int32));
+		w.u64(entry.m_hUGC);
+		
+		const char* name = PersonaCacheLookup(entry.m_steamIDUser.ConvertToUint64());
+		w.str(name ? name : "");
+	}
+}
+
 void CallbackHandler::OnScoreDownloaded(LeaderboardScoresDownloaded_t *pCallback, bool bIOFailure)
 {
 	if (bIOFailure)
@@ -592,55 +1812,50 @@ void CallbackHandler::OnScoreDownloaded(LeaderboardScoresDownloaded_t *pCallback
 		return;
 	}
 
-	std::string leaderboardId = SteamUserStats()->GetLeaderboardName(pCallback->m_hSteamLeaderboard);
-
-	int numEntries = pCallback->m_cEntryCount;
-	if (numEntries > 10) numEntries = 10;
-
-	std::ostringstream data;
-	bool haveData = false;
-
-	for (int i=0; i<numEntries; i++)
-	{
-		int score = 0;
-		int details[1];
-		LeaderboardEntry_t entry;
-		SteamUserStats()->GetDownloadedLeaderboardEntry(pCallback->m_hSteamLeaderboardEntries, i, &entry, details, 1);
-		if (entry.m_cDetails != 1) continue;
+	PackedWriter w;
+	PackLeaderboardEntries(w, SteamUserStats()->GetLeaderboardName(pCallback->m_hSteamLeaderboard), pCallback->m_hSteamLeaderboardEntries, pCallback->m_cEntryCount);
+	SendEvent(Event(kEventTypeOnScoreDownloaded, true, w.toValue()));
+}
 
-		if (haveData) data << ";";
-		data << toLeaderboardScore(leaderboardId.c_str(), SteamFriends()->GetFriendPersonaName(entry.m_steamIDUser), entry.m_nScore, details[0], entry.m_nGlobalRank).c_str();
-		haveData = true;
-	}
+void CallbackHandler::RequestGlobalStats(int historyDays)
+{
+ 	SteamAPICall_t hSteamAPICall = SteamUserStats()->RequestGlobalStats(historyDays);
+ 	m_callResultRequestGlobalStats.Set(hSteamAPICall, this, &CallbackHandler::OnGlobalStatsReceived);
+}
 
-	if (haveData)
+void CallbackHandler::OnGlobalStatsReceived(GlobalStatsReceived_t* pResult, bool bIOFailure)
+{
+	if (!bIOFailure)
 	{
-		SendEvent(Event(kEventTypeOnScoreDownloaded, true, data.str()));
+		if (pResult->m_nGameID != SteamUtils()->GetAppID()) return;
+		SendEvent(Event(kEventTypeOnGlobalStatsReceived, pResult->m_eResult == k_EResultOK));
 	}
 	else
 	{
-		// ok but no scores
-		SendEvent(Event(kEventTypeOnScoreDownloaded, true, toLeaderboardScore(leaderboardId.c_str(), "No Scores", -1, -1, -1)));
+		SendEvent(Event(kEventTypeOnGlobalStatsReceived, false));
 	}
 }
 
-void CallbackHandler::RequestGlobalStats()
+void CallbackHandler::RequestGlobalAchievementPercentages()
 {
- 	SteamAPICall_t hSteamAPICall = SteamUserStats()->RequestGlobalStats(0);
- 	m_callResultRequestGlobalStats.Set(hSteamAPICall, this, &CallbackHandler::OnGlobalStatsReceived);
+	SteamAPICall_t hSteamAPICall = SteamUserStats()->RequestGlobalAchievementPercentages();
+	m_callResultGlobalAchievementPercentages.Set(hSteamAPICall, this, &CallbackHandler::OnGlobalAchievementPercentagesReady);
 }
 
-void CallbackHandler::OnGlobalStatsReceived(GlobalStatsReceived_t* pResult, bool bIOFailure)
+void CallbackHandler::OnGlobalAchievementPercentagesReady(GlobalAchievementPercentagesReady_t* pResult, bool bIOFailure)
 {
-	if (!bIOFailure)
+	bool success = !bIOFailure && pResult->m_eResult == k_EResultOK;
+	if (success)
 	{
-		if (pResult->m_nGameID != SteamUtils()->GetAppID()) return;
-		SendEvent(Event(kEventTypeOnGlobalStatsReceived, pResult->m_eResult == k_EResultOK));
+		s_achievementPercentsReady = true;
+		AchievementSnapshotInvalidate();
 	}
 	else
 	{
-		SendEvent(Event(kEventTypeOnGlobalStatsReceived, false));
+		//let the next snapshot ask again
+		s_achievementPercentsRequested = false;
 	}
+	SendEvent(Event(kEventTypeOnGlobalAchievementPercentagesReady, success));
 }
 
 void CallbackHandler::EnumerateUserPublishedFiles( uint32 unStartIndex )
@@ -823,859 +2038,4391 @@ void CallbackHandler::OnGetPublishedFileDetails(RemoteStorageGetPublishedFileDet
 	SendEvent(Event(kEventTypeOnGetPublishedFileDetails, false));
 }
 
-void CallbackHandler::UGCDownload( UGCHandle_t hContent, uint32 unPriority )
+void CallbackHandler::UGCDownload( UGCHandle_t hContent, uint32 unPriority )
+{
+	SteamAPICall_t hSteamAPICall = SteamRemoteStorage()->UGCDownload( hContent, unPriority );
+	m_callResultUGCDownload.Set(hSteamAPICall, this, &CallbackHandler::OnUGCDownload);
+}
+
+void CallbackHandler::OnUGCDownload(RemoteStorageDownloadUGCResult_t* pResult, bool bIOFailure)
+{
+	if(pResult->m_eResult == k_EResultOK)
+	{
+		std::ostringstream data;
+		
+		data << "result:";
+		data << pResult->m_eResult;
+		data << ",fileHandle:";
+		data << pResult->m_hFile;
+		data << ",appID:";
+		data << pResult->m_nAppID;
+		data << ",sizeInBytes:";
+		data << pResult->m_nSizeInBytes;
+		data << ",fileName:";
+		data << pResult->m_pchFileName;
+		data << ",steamIDOwner:";
+		data << pResult->m_ulSteamIDOwner;
+		
+		SendEvent(Event(kEventTypeOnUGCDownload, pResult->m_eResult == k_EResultOK, data.str()));
+		return;
+	}
+	SendEvent(Event(kEventTypeOnUGCDownload, false));
+}
+
+//the download manager and mapped files live with the other Workshop calls, inside the extern "C" block below
+extern "C"
+{
+	static void WorkshopDownloadResult(PublishedFileId_t id, EResult result);
+	static void WorkshopMappedFilesRelease(PublishedFileId_t item);
+}
+
+void CallbackHandler::OnDownloadItem( DownloadItemResult_t *pCallback )
+{
+	if (pCallback->m_unAppID != SteamUtils()->GetAppID()) return;
+	WorkshopDownloadResult(pCallback->m_nPublishedFileId, pCallback->m_eResult);
+	WorkshopMappedFilesRelease(pCallback->m_nPublishedFileId);
+	
+	std::ostringstream fileIDStream;
+	PublishedFileId_t m_ugcFileID = pCallback->m_nPublishedFileId;
+	fileIDStream << m_ugcFileID;
+	SendEvent(Event(kEventTypeOnDownloadItem, pCallback->m_eResult == k_EResultOK, fileIDStream.str().c_str()));
+}
+
+void CallbackHandler::OnPersonaStateChange( PersonaStateChange_t *pCallback )
+{
+	PersonaCacheChanged(pCallback->m_ulSteamID, (pCallback->m_nChangeFlags & k_EPersonaChangeName) != 0);
+}
+
+void CallbackHandler::OnItemUnsubscribed( RemoteStoragePublishedFileUnsubscribed_t *pCallback )
+{
+	if (pCallback->m_nAppID != SteamUtils()->GetAppID()) return;
+	//Steam removes the item's files once it's unsubscribed
+	WorkshopMappedFilesRelease(pCallback->m_nPublishedFileId);
+}
+
+void CallbackHandler::OnItemInstalled( ItemInstalled_t *pCallback )
+{
+	if (pCallback->m_unAppID != SteamUtils()->GetAppID()) return;
+	
+	std::ostringstream fileIDStream;
+	PublishedFileId_t m_ugcFileID = pCallback->m_nPublishedFileId;
+	fileIDStream << m_ugcFileID;
+	WorkshopDownloadResult(m_ugcFileID, k_EResultOK);
+	WorkshopMappedFilesRelease(m_ugcFileID);
+	SendEvent(Event(kEventTypeOnItemInstalled, true, fileIDStream.str().c_str()));
+}
+
+#pragma endregion
+//-----------------------------------------------------------------------------------------------------------
+static CallbackHandler* s_callbackHandler = NULL;
+
+#pragma endregion
+
+extern "C"
+{
+
+//-----------------------------------------------------------------------------------------------------------
+static bool CheckInit()
+{
+	return SteamUser() && SteamUser()->BLoggedOn() && SteamUserStats() && (s_callbackHandler != 0) && (g_eventHandler != 0);
+}
+
+//-----------------------------------------------------------------------------------------------------------
+value SteamWrap_Init(value onEvent, value notificationPosition)
+{
+	bool result = SteamAPI_Init();
+	if (result)
+	{
+		g_eventHandler = new AutoGCRoot(onEvent);
+		s_callbackHandler = new CallbackHandler();
+
+		switch (val_int(notificationPosition))
+		{
+			case 0:
+				SteamUtils()->SetOverlayNotificationPosition(k_EPositionTopLeft);
+				break;
+			case 1:
+				SteamUtils()->SetOverlayNotificationPosition(k_EPositionTopRight);
+				break;
+			case 2:
+				SteamUtils()->SetOverlayNotificationPosition(k_EPositionBottomRight);
+				break;
+			case 3:
+				SteamUtils()->SetOverlayNotificationPosition(k_EPositionBottomLeft);
+				break;
+			default:
+				SteamUtils()->SetOverlayNotificationPosition(k_EPositionBottomRight);
+				break;
+		}
+	}
+	return alloc_bool(result);
+}
+DEFINE_PRIM(SteamWrap_Init, 2);
+
+static void ManagedLeaderboardsReset();
+static void UGCCursorsReset();
+static void ReplayCacheClose();
+static void WorkshopDownloadsReset();
+static void WorkshopDownloadsUpdate();
+static void UGCStreamsReset();
+static void UGCStreamsUpdate();
+static void WorkshopIndexReset();
+static void WorkshopIndexUpdate();
+static void WorkshopMappedFilesReset();
+static void WorkshopMappedFilesUpdate();
+static void UGCPublishReset();
+
+//-----------------------------------------------------------------------------------------------------------
+void SteamWrap_Shutdown()
+{
+	//flush anything the store scheduler was still holding back; there's no waiting for the result here
+	if (CheckInit() && (s_storeScheduler.pending || s_storeScheduler.inFlight))
+	{
+		StatCacheCommit();
+		SteamUserStats()->StoreStats();
+	}
+	s_storeScheduler.pending = false;
+	s_storeScheduler.inFlight = false;
+	s_storeScheduler.requests = 0;
+	s_achievementSnapshotValid = false;
+	s_achievementPercentsRequested = false;
+	s_achievementPercentsReady = false;
+	s_progressQueue.clear();
+	s_progressPending = 0;
+	s_personaNames.clear();
+	s_personaRequested.clear();
+	s_personaResolved.clear();
+	SweepSteamCalls(true);
+	ManagedLeaderboardsReset();
+	ReplayCacheClose();
+	UGCCursorsReset();
+	WorkshopDownloadsReset();
+	UGCStreamsReset();
+	WorkshopIndexReset();
+	WorkshopMappedFilesReset();
+	UGCPublishReset();
+	s_deferredEvents.clear();
+	
+	SteamAPI_Shutdown();
+	delete g_eventHandler;
+	g_eventHandler = NULL;
+	delete s_callbackHandler;
+	s_callbackHandler = NULL;
+	s_statCacheReady = false;
+}
+DEFINE_PRIM(SteamWrap_Shutdown, 0);
+
+//-----------------------------------------------------------------------------------------------------------
+void SteamWrap_RunCallbacks()
+{
+	SteamAPI_RunCallbacks();
+	SweepSteamCalls(false);
+	FlushDeferredEvents();
+	
+	PackedWriter resolved;
+	if (PersonaCacheTakeResolved(resolved))
+	{
+		SendEvent(Event(kEventTypeOnPersonaNamesResolved, true, resolved.toValue()));
+	}
+	
+	if ((s_storeScheduler.pending || s_progressPending > 0) && CheckInit())
+	{
+		if (s_storeScheduler.pending) StoreSchedulerUpdate();
+		if (s_progressPending > 0) ProgressQueueUpdate();
+	}
+	
+	WorkshopDownloadsUpdate();
+	UGCStreamsUpdate();
+	WorkshopIndexUpdate();
+	WorkshopMappedFilesUpdate();
+	
+	//the journal is replayed from UserStatsReceived, so ask for stats every so often until we're back online
+	if (!s_journal.empty() && NowSeconds() >= s_journalNextStatsRequest)
+	{
+		s_journalNextStatsRequest = NowSeconds() + kJournalStatsRequestInterval;
+		if (CheckInit()) SteamUserStats()->RequestCurrentStats();
+	}
+}
+DEFINE_PRIM(SteamWrap_RunCallbacks, 0);
+
+#pragma region Stats
+//-----------------------------------------------------------------------------------------------------------
+value SteamWrap_RequestStats()
+{
+	if (!CheckInit())
+		return alloc_bool(false);
+
+	bool result = SteamUserStats()->RequestCurrentStats();
+	return alloc_bool(result);
+}
+DEFINE_PRIM(SteamWrap_RequestStats, 0);
+
+//-----------------------------------------------------------------------------------------------------------
+value SteamWrap_GetStat(value name)
+{
+	if (!val_is_string(name)|| !CheckInit())
+		return alloc_int(0);
+
+	//a registered stat may have a value that hasn't been committed yet
+	CachedStat* stat = StatCacheFind(val_string(name));
+	if (stat != NULL && stat->dirty && !stat->isFloat)
+		return alloc_int(stat->iValue);
+
+	int val = 0;
+	SteamUserStats()->GetStat(val_string(name), &val);
+	return alloc_int(val);
+}
+DEFINE_PRIM(SteamWrap_GetStat, 1);
+
+//-----------------------------------------------------------------------------------------------------------
+value SteamWrap_GetStatFloat(value name)
+{
+	if (!val_is_string(name)|| !CheckInit())
+		return alloc_float(0.0);
+
+	//a registered stat may have a value that hasn't been committed yet
+	CachedStat* stat = StatCacheFind(val_string(name));
+	if (stat != NULL && stat->dirty && stat->isFloat)
+		return alloc_float(stat->fValue);
+
+	float val = 0.0;
+	SteamUserStats()->GetStat(val_string(name), &val);
+	return alloc_float(val);
+}
+DEFINE_PRIM(SteamWrap_GetStatFloat, 1);
+
+//-----------------------------------------------------------------------------------------------------------
+value SteamWrap_GetStatInt(value name)
+{
+	if (!val_is_string(name)|| !CheckInit())
+		return alloc_int(0);
+
+	//a registered stat may have a value that hasn't been committed yet
+	CachedStat* stat = StatCacheFind(val_string(name));
+	if (stat != NULL && stat->dirty && !stat->isFloat)
+		return alloc_int(stat->iValue);
+
+	int val = 0;
+	SteamUserStats()->GetStat(val_string(name), &val);
+	return alloc_int(val);
+}
+DEFINE_PRIM(SteamWrap_GetStatInt, 1);
+
+//-----------------------------------------------------------------------------------------------------------
+value SteamWrap_SetStat(value name, value val)
+{
+	if (!val_is_string(name) || !val_is_int(val))
+		return alloc_bool(false);
+	
+	if (!CheckInit())
+	{
+		if (!JournalStatSet(val_string(name), false, val_int(val)))
+			return alloc_bool(false);
+		StatCacheWrote(val_string(name), (int32)val_int(val));
+		return alloc_bool(true);
+	}
+
+	bool result = SteamUserStats()->SetStat(val_string(name), (int) val_int(val));
+	if (result) StatCacheWrote(val_string(name), (int32)val_int(val));
+
+	return alloc_bool(result);
+}
+DEFINE_PRIM(SteamWrap_SetStat, 2);
+
+//-----------------------------------------------------------------------------------------------------------
+value SteamWrap_SetStatFloat(value name, value val)
+{
+	if (!val_is_string(name) || !val_is_float(val))
+		return alloc_bool(false);
+	
+	if (!CheckInit())
+	{
+		if (!JournalStatSet(val_string(name), true, val_float(val)))
+			return alloc_bool(false);
+		StatCacheWrote(val_string(name), (float)val_float(val));
+		return alloc_bool(true);
+	}
+
+	bool result = SteamUserStats()->SetStat(val_string(name), (float) val_float(val));
+	if (result) StatCacheWrote(val_string(name), (float)val_float(val));
+
+	return alloc_bool(result);
+}
+DEFINE_PRIM(SteamWrap_SetStatFloat, 2);
+
+//-----------------------------------------------------------------------------------------------------------
+value SteamWrap_SetStatInt(value name, value val)
+{
+	if (!val_is_string(name) || !val_is_int(val))
+		return alloc_bool(false);
+	
+	if (!CheckInit())
+	{
+		if (!JournalStatSet(val_string(name), false, val_int(val)))
+			return alloc_bool(false);
+		StatCacheWrote(val_string(name), (int32)val_int(val));
+		return alloc_bool(true);
+	}
+
+	bool result = SteamUserStats()->SetStat(val_string(name), (int) val_int(val));
+	if (result) StatCacheWrote(val_string(name), (int32)val_int(val));
+
+	return alloc_bool(result);
+}
+DEFINE_PRIM(SteamWrap_SetStatInt, 2);
+
+//-----------------------------------------------------------------------------------------------------------
+//Adds to an int stat. Unlike SetStatInt this works without knowing the current value, so it can be journaled
+//while offline and applied on top of whatever the server has once we're back.
+value SteamWrap_AddStatInt(value name, value delta)
+{
+	if (!val_is_string(name) || !val_is_int(delta))
+		return alloc_bool(false);
+	
+	if (!CheckInit())
+	{
+		JournalRecord(kJournalStatAddInt, val_string(name), val_int(delta), 0);
+		return alloc_bool(true);
+	}
+	
+	//add on top of an uncommitted cached value rather than the one Steam still has
+	int32 current = 0;
+	CachedStat* stat = StatCacheFind(val_string(name));
+	if (stat != NULL && stat->dirty && !stat->isFloat)
+		current = stat->iValue;
+	else if (!SteamUserStats()->GetStat(val_string(name), &current))
+		return alloc_bool(false);
+	
+	bool result = SteamUserStats()->SetStat(val_string(name), (int32)(current + val_int(delta)));
+	if (result) StatCacheWrote(val_string(name), (int32)(current + val_int(delta)));
+	return alloc_bool(result);
+}
+DEFINE_PRIM(SteamWrap_AddStatInt, 2);
+
+//-----------------------------------------------------------------------------------------------------------
+//Sets the local file the offline journal is kept in, loading anything a previous session left there
+value SteamWrap_SetStatsJournalPath(value path)
+{
+	if (!val_is_string(path))
+		return alloc_int(0);
+	
+	//the entries in memory are already in this file
+	if (s_journalPath == val_string(path))
+		return alloc_int((int)s_journal.size());
+	
+	//entries recorded before the path was known, or kept in a previous file, move to the new one
+	if (!s_journalPath.empty()) remove(s_journalPath.c_str());
+	std::vector<JournalEntry> pending;
+	pending.swap(s_journal);
+	JournalLoad(val_string(path));
+	for (size_t i = 0; i < s_journalUnconfirmed.size(); i++) JournalAppendToFile(s_journalUnconfirmed[i]);
+	for (size_t i = 0; i < pending.size(); i++)
+	{
+		s_journal.push_back(pending[i]);
+		JournalAppendToFile(pending[i]);
+	}
+	return alloc_int((int)s_journal.size());
+}
+DEFINE_PRIM(SteamWrap_SetStatsJournalPath, 1);
+
+//-----------------------------------------------------------------------------------------------------------
+value SteamWrap_StoreStats()
+{
+	if (!CheckInit())
+		return alloc_bool(false);
+
+	//registered stats changed through the cache go along with this store
+	StatCacheCommit();
+	bool result = SteamUserStats()->StoreStats();
+	return alloc_bool(result);
+}
+DEFINE_PRIM(SteamWrap_StoreStats, 0);
+
+//-----------------------------------------------------------------------------------------------------------
+value SteamWrap_RegisterStat(value name, value isFloat)
+{
+	if (!val_is_string(name) || !val_is_bool(isFloat))
+		return alloc_int(-1);
+	
+	std::map<std::string, int>::iterator it = s_statCacheIds.find(val_string(name));
+	if (it != s_statCacheIds.end())
+		return alloc_int(it->second);
+	
+	CachedStat stat;
+	stat.name = val_string(name);
+	stat.isFloat = val_bool(isFloat);
+	stat.loaded = false;
+	stat.dirty = false;
+	stat.iValue = 0;
+	stat.fValue = 0;
+	
+	int id = (int)s_statCache.size();
+	s_statCache.push_back(stat);
+	s_statCacheIds[stat.name] = id;
+	
+	if (s_statCacheReady && CheckInit())
+	{
+		StatCacheLoadEntry(s_statCache[id]);
+	}
+	return alloc_int(id);
+}
+DEFINE_PRIM(SteamWrap_RegisterStat, 2);
+
+//-----------------------------------------------------------------------------------------------------------
+value SteamWrap_IsStatCacheReady()
+{
+	return alloc_bool(s_statCacheReady);
+}
+DEFINE_PRIM(SteamWrap_IsStatCacheReady, 0);
+
+//-----------------------------------------------------------------------------------------------------------
+//Reads the cached value of every stat in ids (Array<Int>) into out (Array<Float>, at least as long as ids).
+//Int stats are widened, so one call covers a mix of both kinds.
+value SteamWrap_GetCachedStats(value ids, value out)
+{
+	if (!val_is_array(ids) || !val_is_array(out))
+		return alloc_bool(false);
+	
+	int count = val_array_size(ids);
+	for (int i = 0; i < count; i++)
+	{
+		CachedStat* stat = StatCacheGet(val_int(val_array_i(ids, i)));
+		double v = 0;
+		if (stat != NULL) v = stat->isFloat ? stat->fValue : stat->iValue;
+		val_array_set_i(out, i, alloc_float(v));
+	}
+	return alloc_bool(true);
+}
+DEFINE_PRIM(SteamWrap_GetCachedStats, 2);
+
+//-----------------------------------------------------------------------------------------------------------
+//Sets the stats in ids (Array<Int>) to the matching entries of values (Array<Float>); int stats are truncated.
+//Only stats whose value actually changed are marked dirty. Returns how many entries were accepted.
+value SteamWrap_SetCachedStats(value ids, value values)
+{
+	if (!val_is_array(ids) || !val_is_array(values))
+		return alloc_int(0);
+	
+	int count = val_array_size(ids);
+	if (val_array_size(values) < count) count = val_array_size(values);
+	
+	int accepted = 0;
+	for (int i = 0; i < count; i++)
+	{
+		CachedStat* stat = StatCacheGet(val_int(val_array_i(ids, i)));
+		if (stat == NULL) continue;
+		
+		//converting a NaN/infinity, or a value the stat's type can't hold, is undefined; those aren't accepted
+		double v = val_number(val_array_i(values, i));
+		if (!isfinite(v)) continue;
+		if (stat->isFloat ? (v > FLT_MAX || v < -FLT_MAX) : (v >= 2147483648.0 || v <= -2147483649.0)) continue;
+		
+		if (stat->isFloat)
+		{
+			if (stat->fValue != (float)v || !stat->loaded)
+			{
+				stat->fValue = (float)v;
+				stat->dirty = true;
+			}
+		}
+		else
+		{
+			if (stat->iValue != (int32)v || !stat->loaded)
+			{
+				stat->iValue = (int32)v;
+				stat->dirty = true;
+			}
+		}
+		accepted++;
+	}
+	return alloc_int(accepted);
+}
+DEFINE_PRIM(SteamWrap_SetCachedStats, 2);
+
+//-----------------------------------------------------------------------------------------------------------
+//Writes dirty cached stats to Steam, then optionally calls StoreStats. Returns how many stats were written, or -1
+value SteamWrap_CommitStats(value store)
+{
+	if (!val_is_bool(store) || !CheckInit())
+		return alloc_int(-1);
+	
+	int written = StatCacheCommit();
+	if (val_bool(store) && !SteamUserStats()->StoreStats())
+		return alloc_int(-1);
+	return alloc_int(written);
+}
+DEFINE_PRIM(SteamWrap_CommitStats, 1);
+
+//-----------------------------------------------------------------------------------------------------------
+//Asks the store scheduler for a StoreStats; dirty cached stats are committed right before it goes out
+value SteamWrap_RequestStoreStats()
+{
+	if (!CheckInit())
+		return alloc_bool(false);
+	
+	StoreSchedulerRequest();
+	return alloc_bool(true);
+}
+DEFINE_PRIM(SteamWrap_RequestStoreStats, 0);
+
+//-----------------------------------------------------------------------------------------------------------
+value SteamWrap_SetStoreStatsSchedule(value window, value minInterval, value maxBackoff)
+{
+	if (!val_is_number(window) || !val_is_number(minInterval) || !val_is_number(maxBackoff))
+		return alloc_bool(false);
+	
+	double w = val_number(window), m = val_number(minInterval), b = val_number(maxBackoff);
+	s_storeScheduler.window = w > 0 ? w : 0;
+	s_storeScheduler.minInterval = m > 0 ? m : 0;
+	s_storeScheduler.maxBackoff = b > kStoreInitialBackoff ? b : kStoreInitialBackoff;
+	return alloc_bool(true);
+}
+DEFINE_PRIM(SteamWrap_SetStoreStatsSchedule, 3);
+
+#pragma endregion
+
+#pragma region UGC
+//Packed query results: u32 count, u8 flags (1 = metadata, 2 = key-value tags), u32 pool length, the string pool,
+//then one fixed-size row per result with (offset, length) references into the pool; key-value tags follow the
+//row as a u32 count of key/value reference pairs. Mirrored by SteamUGCDetails.listFromPacked.
+static const uint8 kUGCPackMetadata = 1;
+static const uint8 kUGCPackKeyValueTags = 2;
+
+//One result with whatever extras were asked for
+struct UGCItemDetails
+{
+	SteamUGCDetails_t details;
+	std::string metadata;
+	std::vector<std::pair<std::string, std::string> > keyValueTags;
+};
+
+//Metadata and key-value tags only come back if the query asked for them (SetReturnMetadata/SetReturnKeyValueTags)
+static void ReadUGCItemDetails(UGCQueryHandle_t handle, uint32 index, uint8 flags, UGCItemDetails& item)
+{
+	ISteamUGC* ugc = SteamUGC();
+	if (!ugc->GetQueryUGCResult(handle, index, &item.details))
+	{
+		item.details = SteamUGCDetails_t();
+		item.details.m_eResult = k_EResultFail;
+	}
+	
+	item.metadata.clear();
+	if (flags & kUGCPackMetadata)
+	{
+		char metadata[k_cchDeveloperMetadataMax + 1];
+		if (!ugc->GetQueryUGCMetadata(handle, index, metadata, sizeof(metadata))) metadata[0] = 0;
+		metadata[k_cchDeveloperMetadataMax] = 0;
+		item.metadata = metadata;
+	}
+	
+	item.keyValueTags.clear();
+	if (flags & kUGCPackKeyValueTags)
+	{
+		uint32 count = ugc->GetQueryUGCNumKeyValueTags(handle, index);
+		for (uint32 i = 0; i < count; i++)
+		{
+			char key[256];
+			char val[256];
+			if (!ugc->GetQueryUGCKeyValueTag(handle, index, i, key, sizeof(key), val, sizeof(val)))
+			{
+				key[0] = 0;
+				val[0] = 0;
+			}
+			item.keyValueTags.push_back(std::make_pair(std::string(key), std::string(val)));
+		}
+	}
+}
+
+static void PackUGCItem(PackedWriter& w, PackedStringPool& pool, const UGCItemDetails& item, uint8 flags)
+{
+	const SteamUGCDetails_t& d = item.details;
+	w.u64(d.m_nPublishedFileId);
+	w.u32((uint32)d.m_eResult);
+	w.u32((uint32)d.m_eFileType);
+	w.u32(d.m_nCreatorAppID);
+	w.u32(d.m_nConsumerAppID);
+	w.u64(d.m_ulSteamIDOwner);
+	w.u32(d.m_rtimeCreated);
+	w.u32(d.m_rtimeUpdated);
+	w.u32(d.m_rtimeAddedToUserList);
+	w.u32((uint32)d.m_eVisibility);
+	w.u8(d.m_bBanned ? 1 : 0);
+	w.u8(d.m_bAcceptedForUse ? 1 : 0);
+	w.u8(d.m_bTagsTruncated ? 1 : 0);
+	w.u64(d.m_hFile);
+	w.u64(d.m_hPreviewFile);
+	w.i32(d.m_nFileSize);
+	w.i32(d.m_nPreviewFileSize);
+	w.u32(d.m_unVotesUp);
+	w.u32(d.m_unVotesDown);
+	w.f32(d.m_flScore);
+	w.u32(d.m_unNumChildren);
+	pool.ref(w, d.m_rgchTitle);
+	pool.ref(w, d.m_rgchDescription);
+	pool.ref(w, d.m_rgchTags);
+	pool.ref(w, d.m_rgchURL);
+	pool.ref(w, d.m_pchFileName);
+	
+	if (flags & kUGCPackMetadata)
+	{
+		pool.ref(w, item.metadata);
+	}
+	if (flags & kUGCPackKeyValueTags)
+	{
+		w.u32((uint32)item.keyValueTags.size());
+		for (size_t i = 0; i < item.keyValueTags.size(); i++)
+		{
+			pool.ref(w, item.keyValueTags[i].first);
+			pool.ref(w, item.keyValueTags[i].second);
+		}
+	}
+}
+
+//Puts the table together: header and pool first, so the reader can resolve strings as it reads the rows
+static void PackUGCTable(PackedWriter& out, uint32 count, uint8 flags, const PackedStringPool& pool, const PackedWriter& rows)
+{
+	out.u32(count);
+	out.u8(flags);
+	out.u32((uint32)pool.data.size());
+	out.raw(pool.data.data(), pool.data.size());
+	out.raw(rows.data.data(), rows.data.size());
+}
+
+static void PackUGCQueryResults(PackedWriter& out, UGCQueryHandle_t handle, uint32 count, uint8 flags)
+{
+	PackedStringPool pool;
+	PackedWriter rows;
+	UGCItemDetails item;
+	for (uint32 i = 0; i < count; i++)
+	{
+		ReadUGCItemDetails(handle, i, flags, item);
+		PackUGCItem(rows, pool, item, flags);
+	}
+	PackUGCTable(out, count, flags, pool, rows);
+}
+
+//-----------------------------------------------------------------------------------------------------------
+//All results of a completed query (numResultsReturned of them) in one packed table; see PackUGCQueryResults.
+value SteamWrap_GetQueryUGCResults(value sHandle, value count, value withMetadata, value withKeyValueTags)
+{
+	if (!val_is_string(sHandle) || !val_is_int(count) || !val_is_bool(withMetadata) || !val_is_bool(withKeyValueTags) || !CheckInit())
+		return alloc_null();
+	
+	UGCQueryHandle_t handle = strtoull(val_string(sHandle), NULL, 0);
+	int n = val_int(count);
+	uint8 flags = (val_bool(withMetadata) ? kUGCPackMetadata : 0) | (val_bool(withKeyValueTags) ? kUGCPackKeyValueTags : 0);
+	
+	PackedWriter w;
+	PackUGCQueryResults(w, handle, n > 0 ? (uint32)n : 0, flags);
+	return w.toValue();
+}
+DEFINE_PRIM(SteamWrap_GetQueryUGCResults, 4);
+
+//-----------------------------------------------------------------------------------------------------------
+// Query cursors
+//-----------------------------------------------------------------------------------------------------------
+//A cursor holds the filters of a CreateQueryAllUGCRequest query and fetches its pages on demand. Asking for a page
+//also prefetches the one after it, so it's usually there by the time the player scrolls on. Each page is packed
+//(as above) as soon as it arrives and its query handle released; only the last few pages used are kept.
+enum UGCCursorPageState
+{
+	kUGCPageFetching = 0,
+	kUGCPageReady = 1
+};
+
+struct UGCCursorPage
+{
+	int state;
+	bool wanted;		//asked for by the game rather than prefetched, so it gets an event once it's in
+	bool cachedData;
+	uint32 lastUse;
+	std::shared_ptr<std::vector<unsigned char> > packed;
+};
+
+struct UGCCursor
+{
+	EUGCQuery queryType;
+	EUGCMatchingUGCType matchingType;
+	AppId_t creatorAppID;
+	AppId_t consumerAppID;
+	uint8 flags;
+	std::vector<std::string> requiredTags;
+	std::vector<std::string> excludedTags;
+	std::vector<std::pair<std::string, std::string> > requiredKeyValueTags;
+	std::string searchText;
+	uint32 window;
+	uint32 useCounter;
+	int64 totalResults;		//-1 until the first page is in
+	std::map<uint32, UGCCursorPage> pages;
+};
+
+//cursor flags on top of kUGCPackMetadata/kUGCPackKeyValueTags
+static const uint8 kUGCCursorMatchAnyTag = 4;
+
+static std::map<int, UGCCursor> s_ugcCursors;
+static int s_ugcCursorCounter = 0;
+
+static void UGCCursorsReset()
+{
+	s_ugcCursors.clear();
+}
+
+inline UGCCursor* UGCCursorGet(int id)
+{
+	std::map<int, UGCCursor>::iterator it = s_ugcCursors.find(id);
+	return it == s_ugcCursors.end() ? NULL : &it->second;
+}
+
+static void SendUGCCursorPage(int id, uint32 page, int64 total, bool cachedData, const std::vector<unsigned char>* packed)
+{
+	value data = alloc_empty_object();
+	alloc_field(data, val_id("cursor"), alloc_int(id));
+	alloc_field(data, val_id("page"), alloc_int(page));
+	alloc_field(data, val_id("total"), alloc_int((int)total));
+	alloc_field(data, val_id("cachedData"), alloc_bool(cachedData));
+	if (packed != NULL)
+	{
+		alloc_field(data, val_id("results"), bytes_to_hx(packed->data(), (int)packed->size()));
+	}
+	SendEvent(Event(kEventTypeOnUGCCursorPage, packed != NULL, data));
+}
+
+//Drops the least recently used pages past the window, never the one just asked for, the one after it or ones in flight
+static void UGCCursorEvict(UGCCursor& c, uint32 current)
+{
+	while (c.pages.size() > c.window)
+	{
+		std::map<uint32, UGCCursorPage>::iterator oldest = c.pages.end();
+		for (std::map<uint32, UGCCursorPage>::iterator it = c.pages.begin(); it != c.pages.end(); ++it)
+		{
+			if (it->first == current || it->first == current + 1 || it->second.state == kUGCPageFetching) continue;
+			if (oldest == c.pages.end() || it->second.lastUse < oldest->second.lastUse) oldest = it;
+		}
+		if (oldest == c.pages.end()) return;
+		c.pages.erase(oldest);
+	}
+}
+
+static void UGCCursorPageDone(int id, uint32 page, const std::shared_ptr<std::vector<unsigned char> >& packed, int64 total, bool cachedData)
+{
+	UGCCursor* c = UGCCursorGet(id);
+	if (c == NULL) return;
+	std::map<uint32, UGCCursorPage>::iterator it = c->pages.find(page);
+	if (it == c->pages.end()) return;
+	
+	if (packed) c->totalResults = total;
+	bool wanted = it->second.wanted;
+	if (packed)
+	{
+		it->second.state = kUGCPageReady;
+		it->second.packed = packed;
+		it->second.cachedData = cachedData;
+	}
+	else
+	{
+		//forget failed pages so the next request for them tries again
+		c->pages.erase(it);
+	}
+	
+	if (wanted)
+	{
+		SendUGCCursorPage(id, page, c->totalResults, cachedData, packed.get());
+	}
+}
+
+//A query that fails before it's sent is reported from RunCallbacks like any other result
+static void UGCCursorFailLater(int id, uint32 page)
+{
+	DeferEvent([id, page]() {
+		UGCCursorPageDone(id, page, std::shared_ptr<std::vector<unsigned char> >(), 0, false);
+	});
+}
+
+static void UGCCursorFetch(int id, uint32 page, bool wanted)
+{
+	UGCCursor& c = s_ugcCursors[id];
+	UGCCursorPage& p = c.pages[page];
+	p.state = kUGCPageFetching;
+	p.wanted = wanted;
+	p.cachedData = false;
+	p.lastUse = ++c.useCounter;
+	
+	ISteamUGC* ugc = SteamUGC();
+	UGCQueryHandle_t query = ugc->CreateQueryAllUGCRequest(c.queryType, c.matchingType, c.creatorAppID, c.consumerAppID, page);
+	if (query == k_UGCQueryHandleInvalid)
+	{
+		UGCCursorFailLater(id, page);
+		return;
+	}
+	
+	for (size_t i = 0; i < c.requiredTags.size(); i++) ugc->AddRequiredTag(query, c.requiredTags[i].c_str());
+	for (size_t i = 0; i < c.excludedTags.size(); i++) ugc->AddExcludedTag(query, c.excludedTags[i].c_str());
+	for (size_t i = 0; i < c.requiredKeyValueTags.size(); i++)
+	{
+		ugc->AddRequiredKeyValueTag(query, c.requiredKeyValueTags[i].first.c_str(), c.requiredKeyValueTags[i].second.c_str());
+	}
+	if (!c.searchText.empty()) ugc->SetSearchText(query, c.searchText.c_str());
+	if (c.flags & kUGCCursorMatchAnyTag) ugc->SetMatchAnyTag(query, true);
+	if (c.flags & kUGCPackMetadata) ugc->SetReturnMetadata(query, true);
+	if (c.flags & kUGCPackKeyValueTags) ugc->SetReturnKeyValueTags(query, true);
+	
+	uint8 packFlags = c.flags & (kUGCPackMetadata | kUGCPackKeyValueTags);
+	SteamAPICall_t call = ugc->SendQueryUGCRequest(query);
+	bool started = StartSteamCall<SteamUGCQueryCompleted_t>(call, [id, page, query, packFlags](SteamUGCQueryCompleted_t* result, bool ioFailure) {
+		std::shared_ptr<std::vector<unsigned char> > packed;
+		int64 total = 0;
+		bool cachedData = false;
+		if (!ioFailure && result->m_eResult == k_EResultOK)
+		{
+			PackedWriter w;
+			PackUGCQueryResults(w, query, result->m_unNumResultsReturned, packFlags);
+			packed.reset(new std::vector<unsigned char>());
+			packed->swap(w.data);
+			total = result->m_unTotalMatchingResults;
+			cachedData = result->m_bCachedData;
+		}
+		SteamUGC()->ReleaseQueryUGCRequest(query);
+		UGCCursorPageDone(id, page, packed, total, cachedData);
+	});
+	if (!started)
+	{
+		ugc->ReleaseQueryUGCRequest(query);
+		UGCCursorFailLater(id, page);
+	}
+}
+
+//-----------------------------------------------------------------------------------------------------------
+//Creates a cursor over a CreateQueryAllUGCRequest query. flags: 1 = return metadata, 2 = return key-value tags,
+//4 = match any required tag rather than all. pageWindow is how many pages are kept in memory (at least 2).
+int SteamWrap_CreateUGCCursor(int queryType, int matchingType, int creatorAppID, int consumerAppID, int flags, int pageWindow)
+{
+	if (!CheckInit()) return -1;
+	
+	int id = ++s_ugcCursorCounter;
+	UGCCursor& c = s_ugcCursors[id];
+	c.queryType = (EUGCQuery)queryType;
+	c.matchingType = (EUGCMatchingUGCType)matchingType;
+	c.creatorAppID = creatorAppID;
+	c.consumerAppID = consumerAppID;
+	c.flags = (uint8)flags;
+	c.window = pageWindow < 2 ? 2 : pageWindow;
+	c.useCounter = 0;
+	c.totalResults = -1;
+	return id;
+}
+DEFINE_PRIME6(SteamWrap_CreateUGCCursor);
+
+//-----------------------------------------------------------------------------------------------------------
+//Filters can only be added before the first page is asked for
+int SteamWrap_AddUGCCursorTag(int id, const char * tagName, int required)
+{
+	UGCCursor* c = UGCCursorGet(id);
+	if (c == NULL || !c->pages.empty()) return 0;
+	if (required) c->requiredTags.push_back(tagName);
+	else c->excludedTags.push_back(tagName);
+	return 1;
+}
+DEFINE_PRIME3(SteamWrap_AddUGCCursorTag);
+
+//-----------------------------------------------------------------------------------------------------------
+int SteamWrap_AddUGCCursorKeyValueTag(int id, const char * pKey, const char * pValue)
+{
+	UGCCursor* c = UGCCursorGet(id);
+	if (c == NULL || !c->pages.empty()) return 0;
+	c->requiredKeyValueTags.push_back(std::make_pair(std::string(pKey), std::string(pValue)));
+	return 1;
+}
+DEFINE_PRIME3(SteamWrap_AddUGCCursorKeyValueTag);
+
+//-----------------------------------------------------------------------------------------------------------
+int SteamWrap_SetUGCCursorSearchText(int id, const char * text)
+{
+	UGCCursor* c = UGCCursorGet(id);
+	if (c == NULL || !c->pages.empty()) return 0;
+	c->searchText = text;
+	return 1;
+}
+DEFINE_PRIME2(SteamWrap_SetUGCCursorSearchText);
+
+//-----------------------------------------------------------------------------------------------------------
+//Asks for a page (from 1); UGCCursorPage comes back with it, right from memory if it's been fetched already.
+//The page after it is prefetched.
+int SteamWrap_RequestUGCCursorPage(int id, int page)
+{
+	UGCCursor* c = UGCCursorGet(id);
+	if (c == NULL || page < 1 || !CheckInit()) return 0;
+	
+	std::map<uint32, UGCCursorPage>::iterator it = c->pages.find(page);
+	if (it == c->pages.end())
+	{
+		UGCCursorFetch(id, page, true);
+	}
+	else
+	{
+		it->second.lastUse = ++c->useCounter;
+		if (it->second.state == kUGCPageFetching)
+		{
+			it->second.wanted = true;
+		}
+		else
+		{
+			std::shared_ptr<std::vector<unsigned char> > packed = it->second.packed;
+			int64 total = c->totalResults;
+			bool cachedData = it->second.cachedData;
+			DeferEvent([id, page, total, cachedData, packed]() {
+				SendUGCCursorPage(id, page, total, cachedData, packed.get());
+			});
+		}
+	}
+	
+	uint32 next = page + 1;
+	int64 pages = (c->totalResults + kNumUGCResultsPerPage - 1) / kNumUGCResultsPerPage;
+	if ((c->totalResults < 0 || next <= pages) && c->pages.find(next) == c->pages.end())
+	{
+		UGCCursorFetch(id, next, false);
+	}
+	
+	UGCCursorEvict(*c, page);
+	return 1;
+}
+DEFINE_PRIME2(SteamWrap_RequestUGCCursorPage);
+
+//-----------------------------------------------------------------------------------------------------------
+//Total matching results, or -1 if no page has come back yet
+int SteamWrap_GetUGCCursorTotal(int id)
+{
+	UGCCursor* c = UGCCursorGet(id);
+	return c ? (int)c->totalResults : -1;
+}
+DEFINE_PRIME1(SteamWrap_GetUGCCursorTotal);
+
+//-----------------------------------------------------------------------------------------------------------
+//Frees the cursor's pages; queries still in flight release their handles when they come back
+void SteamWrap_DestroyUGCCursor(int id)
+{
+	s_ugcCursors.erase(id);
+}
+DEFINE_PRIME1v(SteamWrap_DestroyUGCCursor);
+
+//-----------------------------------------------------------------------------------------------------------
+// Batched details queries
+//-----------------------------------------------------------------------------------------------------------
+//Steam returns at most a page of results per details query, so any number of ids is split into page-sized queries
+//that run a few at a time. Each result goes to onItem as it comes in and onDone runs once, after the last query.
+static const int kUGCDetailsDefaultConcurrency = 4;
+
+struct UGCDetailsBatch
+{
+	uint8 flags;
+	uint32 maxAge;			//for SetAllowCachedResponse, 0 to always ask the server
+	int maxConcurrent;
+	int inFlight;
+	size_t nextQuery;
+	bool finished;
+	std::vector<std::vector<PublishedFileId_t> > queries;
+	int received;
+	int fromSteamCache;
+	int failed;
+	std::function<void(UGCItemDetails&, bool)> onItem;
+	std::function<void(UGCDetailsBatch&)> onDone;
+	
+	UGCDetailsBatch() : flags(0), maxAge(0), maxConcurrent(kUGCDetailsDefaultConcurrency), inFlight(0), nextQuery(0),
+		finished(false), received(0), fromSteamCache(0), failed(0) {}
+};
+typedef std::shared_ptr<UGCDetailsBatch> UGCDetailsBatchPtr;
+
+static void UGCDetailsBatchPump(const UGCDetailsBatchPtr& batch);
+
+static void UGCDetailsBatchQueryDone(const UGCDetailsBatchPtr& batch, UGCQueryHandle_t query, SteamUGCQueryCompleted_t* result, int asked)
+{
+	if (result != NULL && result->m_eResult == k_EResultOK)
+	{
+		UGCItemDetails item;
+		for (uint32 i = 0; i < result->m_unNumResultsReturned; i++)
+		{
+			ReadUGCItemDetails(query, i, batch->flags, item);
+			if (item.details.m_eResult != k_EResultOK)
+			{
+				batch->failed++;
+				continue;
+			}
+			batch->onItem(item, result->m_bCachedData);
+			batch->received++;
+			if (result->m_bCachedData) batch->fromSteamCache++;
+		}
+		batch->failed += asked - (int)result->m_unNumResultsReturned;
+	}
+	else
+	{
+		batch->failed += asked;
+	}
+	if (query != k_UGCQueryHandleInvalid) SteamUGC()->ReleaseQueryUGCRequest(query);
+	
+	batch->inFlight--;
+	UGCDetailsBatchPump(batch);
+}
+
+//Failures before the query is out are reported from RunCallbacks too, so the pump never recurses into itself
+static void UGCDetailsBatchSend(const UGCDetailsBatchPtr& batch, std::vector<PublishedFileId_t>& ids)
+{
+	int asked = (int)ids.size();
+	batch->inFlight++;
+	
+	ISteamUGC* ugc = SteamUGC();
+	UGCQueryHandle_t query = ugc->CreateQueryUGCDetailsRequest(ids.data(), (uint32)ids.size());
+	if (query == k_UGCQueryHandleInvalid)
+	{
+		DeferEvent([batch, asked]() {
+			UGCDetailsBatchQueryDone(batch, k_UGCQueryHandleInvalid, NULL, asked);
+		});
+		return;
+	}
+	
+	if (batch->flags & kUGCPackMetadata) ugc->SetReturnMetadata(query, true);
+	if (batch->flags & kUGCPackKeyValueTags) ugc->SetReturnKeyValueTags(query, true);
+	if (batch->maxAge > 0) ugc->SetAllowCachedResponse(query, batch->maxAge);
+	
+	SteamAPICall_t call = ugc->SendQueryUGCRequest(query);
+	bool started = StartSteamCall<SteamUGCQueryCompleted_t>(call, [batch, query, asked](SteamUGCQueryCompleted_t* result, bool ioFailure) {
+		UGCDetailsBatchQueryDone(batch, query, ioFailure ? NULL : result, asked);
+	});
+	if (!started)
+	{
+		DeferEvent([batch, query, asked]() {
+			UGCDetailsBatchQueryDone(batch, query, NULL, asked);
+		});
+	}
+}
+
+static void UGCDetailsBatchPump(const UGCDetailsBatchPtr& batch)
+{
+	while (batch->inFlight < batch->maxConcurrent && batch->nextQuery < batch->queries.size())
+	{
+		UGCDetailsBatchSend(batch, batch->queries[batch->nextQuery++]);
+	}
+	if (batch->inFlight == 0 && batch->nextQuery >= batch->queries.size() && !batch->finished)
+	{
+		batch->finished = true;
+		batch->onDone(*batch);
+	}
+}
+
+static void UGCDetailsBatchStart(const UGCDetailsBatchPtr& batch, const std::vector<PublishedFileId_t>& ids)
+{
+	for (size_t i = 0; i < ids.size(); i += kNumUGCResultsPerPage)
+	{
+		size_t end = i + kNumUGCResultsPerPage < ids.size() ? i + kNumUGCResultsPerPage : ids.size();
+		batch->queries.push_back(std::vector<PublishedFileId_t>(ids.begin() + i, ids.begin() + end));
+	}
+	
+	if (batch->queries.empty())
+	{
+		//nothing to ask; still answer from RunCallbacks
+		DeferEvent([batch]() {
+			UGCDetailsBatchPump(batch);
+		});
+		return;
+	}
+	UGCDetailsBatchPump(batch);
+}
+
+//-----------------------------------------------------------------------------------------------------------
+// Details cache
+//-----------------------------------------------------------------------------------------------------------
+//Details of items we've seen, persisted to a file so the mod list can be shown straight from disk at startup.
+//A refresh only queries the items that are missing, lack the extras asked for, are older than the caller's
+//limit, or that Steam says have moved on: a subscribed item that needs an update, or whose installed
+//version is newer than the m_rtimeUpdated we have.
+struct UGCDetailsCacheEntry
+{
+	UGCItemDetails item;
+	uint8 flags;		//which extras item holds
+	uint64 fetchedAt;	//wall clock, since it's compared across sessions
+};
+
+static const char kUGCDetailsCacheMagic[4] = { 'S', 'W', 'D', '1' };
+static std::map<PublishedFileId_t, UGCDetailsCacheEntry> s_ugcDetailsCache;
+static std::string s_ugcDetailsCachePath;
+static int s_ugcDetailsRequestCounter = 0;
+
+inline void CopyToField(char* field, size_t fieldSize, const std::string& s)
+{
+	size_t length = s.size() < fieldSize - 1 ? s.size() : fieldSize - 1;
+	memcpy(field, s.data(), length);
+	field[length] = 0;
+}
+
+static void UGCDetailsCacheWriteEntry(PackedWriter& w, const UGCDetailsCacheEntry& e)
+{
+	const SteamUGCDetails_t& d = e.item.details;
+	w.u8(e.flags);
+	w.u64(e.fetchedAt);
+	w.u64(d.m_nPublishedFileId);
+	w.u32((uint32)d.m_eResult);
+	w.u32((uint32)d.m_eFileType);
+	w.u32(d.m_nCreatorAppID);
+	w.u32(d.m_nConsumerAppID);
+	w.u64(d.m_ulSteamIDOwner);
+	w.u32(d.m_rtimeCreated);
+	w.u32(d.m_rtimeUpdated);
+	w.u32(d.m_rtimeAddedToUserList);
+	w.u32((uint32)d.m_eVisibility);
+	w.u8((d.m_bBanned ? 1 : 0) | (d.m_bAcceptedForUse ? 2 : 0) | (d.m_bTagsTruncated ? 4 : 0));
+	w.u64(d.m_hFile);
+	w.u64(d.m_hPreviewFile);
+	w.i32(d.m_nFileSize);
+	w.i32(d.m_nPreviewFileSize);
+	w.u32(d.m_unVotesUp);
+	w.u32(d.m_unVotesDown);
+	w.f32(d.m_flScore);
+	w.u32(d.m_unNumChildren);
+	w.str(d.m_rgchTitle);
+	w.str(d.m_rgchDescription);
+	w.str(d.m_rgchTags);
+	w.str(d.m_rgchURL);
+	w.str(d.m_pchFileName);
+	w.str(e.item.metadata);
+	w.u32((uint32)e.item.keyValueTags.size());
+	for (size_t i = 0; i < e.item.keyValueTags.size(); i++)
+	{
+		w.str(e.item.keyValueTags[i].first);
+		w.str(e.item.keyValueTags[i].second);
+	}
+}
+
+static bool UGCDetailsCacheReadEntry(PackedParser& r, UGCDetailsCacheEntry& e)
+{
+	SteamUGCDetails_t& d = e.item.details;
+	d = SteamUGCDetails_t();
+	e.flags = r.u8();
+	e.fetchedAt = r.u64();
+	d.m_nPublishedFileId = r.u64();
+	d.m_eResult = (EResult)r.u32();
+	d.m_eFileType = (EWorkshopFileType)r.u32();
+	d.m_nCreatorAppID = r.u32();
+	d.m_nConsumerAppID = r.u32();
+	d.m_ulSteamIDOwner = r.u64();
+	d.m_rtimeCreated = r.u32();
+	d.m_rtimeUpdated = r.u32();
+	d.m_rtimeAddedToUserList = r.u32();
+	d.m_eVisibility = (ERemoteStoragePublishedFileVisibility)r.u32();
+	uint8 bits = r.u8();
+	d.m_bBanned = (bits & 1) != 0;
+	d.m_bAcceptedForUse = (bits & 2) != 0;
+	d.m_bTagsTruncated = (bits & 4) != 0;
+	d.m_hFile = r.u64();
+	d.m_hPreviewFile = r.u64();
+	d.m_nFileSize = r.i32();
+	d.m_nPreviewFileSize = r.i32();
+	d.m_unVotesUp = r.u32();
+	d.m_unVotesDown = r.u32();
+	d.m_flScore = r.f32();
+	d.m_unNumChildren = r.u32();
+	CopyToField(d.m_rgchTitle, sizeof(d.m_rgchTitle), r.str());
+	CopyToField(d.m_rgchDescription, sizeof(d.m_rgchDescription), r.str());
+	CopyToField(d.m_rgchTags, sizeof(d.m_rgchTags), r.str());
+	CopyToField(d.m_rgchURL, sizeof(d.m_rgchURL), r.str());
+	CopyToField(d.m_pchFileName, sizeof(d.m_pchFileName), r.str());
+	e.item.metadata = r.str();
+	e.item.keyValueTags.clear();
+	uint32 kvCount = r.u32();
+	for (uint32 i = 0; i < kvCount && r.ok; i++)
+	{
+		std::string key = r.str();
+		std::string val = r.str();
+		e.item.keyValueTags.push_back(std::make_pair(key, val));
+	}
+	return r.ok;
+}
+
+static void UGCDetailsCacheSave()
+{
+	if (s_ugcDetailsCachePath.empty()) return;
+	
+	PackedWriter w;
+	w.raw(kUGCDetailsCacheMagic, 4);
+	w.u32((uint32)s_ugcDetailsCache.size());
+	for (std::map<PublishedFileId_t, UGCDetailsCacheEntry>::iterator it = s_ugcDetailsCache.begin(); it != s_ugcDetailsCache.end(); ++it)
+	{
+		UGCDetailsCacheWriteEntry(w, it->second);
+	}
+	
+	//write next to it and swap it in, so a crash mid-write leaves the old cache intact
+	std::string temp = s_ugcDetailsCachePath + ".tmp";
+	FILE* f = fopen(temp.c_str(), "wb");
+	if (f == NULL) return;
+	bool written = fwrite(w.data.data(), 1, w.data.size(), f) == w.data.size();
+	fclose(f);
+	if (!written)
+	{
+		remove(temp.c_str());
+		return;
+	}
+	remove(s_ugcDetailsCachePath.c_str());
+	rename(temp.c_str(), s_ugcDetailsCachePath.c_str());
+}
+
+//Entries up to a torn one are kept
+static int UGCDetailsCacheLoad(const char* path)
+{
+	s_ugcDetailsCachePath = path;
+	s_ugcDetailsCache.clear();
+	
+	FILE* f = fopen(path, "rb");
+	if (f == NULL) return 0;
+	std::vector<unsigned char> data;
+	unsigned char chunk[65536];
+	size_t n;
+	while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0) data.insert(data.end(), chunk, chunk + n);
+	fclose(f);
+	
+	if (data.size() < 8 || memcmp(data.data(), kUGCDetailsCacheMagic, 4) != 0) return 0;
+	PackedParser r(data.data() + 4, data.size() - 4);
+	uint32 count = r.u32();
+	for (uint32 i = 0; i < count && r.ok; i++)
+	{
+		UGCDetailsCacheEntry e;
+		if (!UGCDetailsCacheReadEntry(r, e)) break;
+		s_ugcDetailsCache[e.item.details.m_nPublishedFileId] = e;
+	}
+	return (int)s_ugcDetailsCache.size();
+}
+
+//Does Steam know of a newer version of this item than the one we have details for?
+static bool UGCDetailsMoved(const UGCDetailsCacheEntry& e)
+{
+	PublishedFileId_t id = e.item.details.m_nPublishedFileId;
+	uint32 state = SteamUGC()->GetItemState(id);
+	if (state & k_EItemStateNeedsUpdate) return true;
+	if (state & k_EItemStateInstalled)
+	{
+		uint64 sizeOnDisk;
+		uint32 timeStamp;
+		char folder[1];
+		if (SteamUGC()->GetItemInstallInfo(id, &sizeOnDisk, folder, sizeof(folder), &timeStamp) && timeStamp > e.item.details.m_rtimeUpdated)
+			return true;
+	}
+	return false;
+}
+
+//The cached details of ids, in order; ids that aren't cached are left out
+static void PackCachedUGCDetails(PackedWriter& out, const std::vector<PublishedFileId_t>& ids, uint8 flags)
+{
+	PackedStringPool pool;
+	PackedWriter rows;
+	uint32 count = 0;
+	for (size_t i = 0; i < ids.size(); i++)
+	{
+		std::map<PublishedFileId_t, UGCDetailsCacheEntry>::iterator it = s_ugcDetailsCache.find(ids[i]);
+		if (it == s_ugcDetailsCache.end()) continue;
+		PackUGCItem(rows, pool, it->second.item, flags);
+		count++;
+	}
+	PackUGCTable(out, count, flags, pool, rows);
+}
+
+//-----------------------------------------------------------------------------------------------------------
+//Loads the details cache from path (and saves it there from now on). Returns how many items it holds.
+int SteamWrap_SetUGCDetailsCachePath(const char * path)
+{
+	return UGCDetailsCacheLoad(path);
+}
+DEFINE_PRIME1(SteamWrap_SetUGCDetailsCachePath);
+
+//-----------------------------------------------------------------------------------------------------------
+//Packed table (see PackUGCQueryResults) of the cached details of a comma-separated list of ids, without touching
+//the network. flags: 1 = metadata, 2 = key-value tags.
+value SteamWrap_GetCachedUGCDetails(value fileIDs, value flags)
+{
+	if (!val_is_string(fileIDs) || !val_is_int(flags))
+		return alloc_null();
+	
+	uint32 count = 0;
+	PublishedFileId_t* ids = getUint64Array(val_string(fileIDs), &count);
+	std::vector<PublishedFileId_t> idList(ids, ids + count);
+	delete[] ids;
+	
+	PackedWriter w;
+	PackCachedUGCDetails(w, idList, (uint8)val_int(flags));
+	return w.toValue();
+}
+DEFINE_PRIM(SteamWrap_GetCachedUGCDetails, 2);
+
+//-----------------------------------------------------------------------------------------------------------
+//Brings the cached details of a comma-separated list of ids up to date, querying only the ones that need it
+//(see above); Steam may answer from its own cache if that's under maxAgeSeconds old. Returns the request id;
+//UGCDetailsRefreshed carries the details of all the ids once everything is in.
+value SteamWrap_RefreshUGCDetails(value fileIDs, value flags, value maxAgeSeconds)
+{
+	if (!val_is_string(fileIDs) || !val_is_int(flags) || !val_is_int(maxAgeSeconds) || !CheckInit())
+		return alloc_int(-1);
+	
+	int request = ++s_ugcDetailsRequestCounter;
+	uint8 packFlags = (uint8)val_int(flags) & (kUGCPackMetadata | kUGCPackKeyValueTags);
+	uint32 maxAge = val_int(maxAgeSeconds) > 0 ? (uint32)val_int(maxAgeSeconds) : 0;
+	
+	uint32 count = 0;
+	PublishedFileId_t* ids = getUint64Array(val_string(fileIDs), &count);
+	std::shared_ptr<std::vector<PublishedFileId_t> > idList(new std::vector<PublishedFileId_t>(ids, ids + count));
+	delete[] ids;
+	
+	uint64 now = (uint64)time(NULL);
+	std::vector<PublishedFileId_t> stale;
+	std::set<PublishedFileId_t> seen;
+	for (size_t i = 0; i < idList->size(); i++)
+	{
+		PublishedFileId_t id = (*idList)[i];
+		if (!seen.insert(id).second) continue;
+		
+		std::map<PublishedFileId_t, UGCDetailsCacheEntry>::iterator it = s_ugcDetailsCache.find(id);
+		bool fresh = it != s_ugcDetailsCache.end()
+			&& (it->second.flags & packFlags) == packFlags
+			&& (maxAge == 0 || now - it->second.fetchedAt < maxAge)
+			&& !UGCDetailsMoved(it->second);
+		if (!fresh) stale.push_back(id);
+	}
+	
+	UGCDetailsBatchPtr batch(new UGCDetailsBatch());
+	batch->flags = packFlags;
+	batch->maxAge = maxAge;
+	batch->maxConcurrent = kUGCDetailsDefaultConcurrency;
+	batch->onItem = [packFlags, now](UGCItemDetails& item, bool cachedData) {
+		//an answer out of Steam's own cache is no fresher than what it replaced, so don't reset its age
+		PublishedFileId_t id = item.details.m_nPublishedFileId;
+		std::map<PublishedFileId_t, UGCDetailsCacheEntry>::iterator old = s_ugcDetailsCache.find(id);
+		UGCDetailsCacheEntry e;
+		e.item = item;
+		e.flags = packFlags;
+		e.fetchedAt = cachedData && old != s_ugcDetailsCache.end() ? old->second.fetchedAt : now;
+		s_ugcDetailsCache[id] = e;
+	};
+	batch->onDone = [request, idList](UGCDetailsBatch& b) {
+		if (b.received > 0) UGCDetailsCacheSave();
+		
+		PackedWriter w;
+		PackCachedUGCDetails(w, *idList, b.flags);
+		value data = alloc_empty_object();
+		alloc_field(data, val_id("request"), alloc_int(request));
+		alloc_field(data, val_id("fetched"), alloc_int(b.received));
+		alloc_field(data, val_id("fromSteamCache"), alloc_int(b.fromSteamCache));
+		alloc_field(data, val_id("failed"), alloc_int(b.failed));
+		alloc_field(data, val_id("results"), w.toValue());
+		SendEvent(Event(kEventTypeOnUGCDetailsRefreshed, b.failed == 0, data));
+	};
+	UGCDetailsBatchStart(batch, stale);
+	return alloc_int(request);
+}
+DEFINE_PRIM(SteamWrap_RefreshUGCDetails, 3);
+
+//-----------------------------------------------------------------------------------------------------------
+//Queries the details of any number of ids (comma-separated), split into page-sized queries with at most
+//maxConcurrent of them in flight. Returns the request id; UGCDetailsQueried carries one packed table with every
+//item that came back, once each, in the order first asked for.
+value SteamWrap_QueryUGCDetails(value fileIDs, value flags, value maxConcurrent)
+{
+	if (!val_is_string(fileIDs) || !val_is_int(flags) || !val_is_int(maxConcurrent) || !CheckInit())
+		return alloc_int(-1);
+	
+	int request = ++s_ugcDetailsRequestCounter;
+	
+	uint32 count = 0;
+	PublishedFileId_t* ids = getUint64Array(val_string(fileIDs), &count);
+	std::shared_ptr<std::vector<PublishedFileId_t> > unique(new std::vector<PublishedFileId_t>());
+	std::set<PublishedFileId_t> seen;
+	for (uint32 i = 0; i < count; i++)
+	{
+		if (seen.insert(ids[i]).second) unique->push_back(ids[i]);
+	}
+	delete[] ids;
+	
+	std::shared_ptr<std::map<PublishedFileId_t, UGCItemDetails> > results(new std::map<PublishedFileId_t, UGCItemDetails>());
+	UGCDetailsBatchPtr batch(new UGCDetailsBatch());
+	batch->flags = (uint8)val_int(flags) & (kUGCPackMetadata | kUGCPackKeyValueTags);
+	batch->maxConcurrent = val_int(maxConcurrent) > 0 ? val_int(maxConcurrent) : kUGCDetailsDefaultConcurrency;
+	batch->onItem = [results](UGCItemDetails& item, bool cachedData) {
+		(*results)[item.details.m_nPublishedFileId] = item;
+	};
+	batch->onDone = [request, unique, results](UGCDetailsBatch& b) {
+		PackedStringPool pool;
+		PackedWriter rows;
+		uint32 packed = 0;
+		for (size_t i = 0; i < unique->size(); i++)
+		{
+			std::map<PublishedFileId_t, UGCItemDetails>::iterator it = results->find((*unique)[i]);
+			if (it == results->end()) continue;
+			PackUGCItem(rows, pool, it->second, b.flags);
+			packed++;
+		}
+		PackedWriter w;
+		PackUGCTable(w, packed, b.flags, pool, rows);
+		
+		value data = alloc_empty_object();
+		alloc_field(data, val_id("request"), alloc_int(request));
+		alloc_field(data, val_id("failed"), alloc_int(b.failed));
+		alloc_field(data, val_id("results"), w.toValue());
+		SendEvent(Event(kEventTypeOnUGCDetailsQueried, b.failed == 0, data));
+	};
+	UGCDetailsBatchStart(batch, *unique);
+	return alloc_int(request);
+}
+DEFINE_PRIM(SteamWrap_QueryUGCDetails, 3);
+
+//-----------------------------------------------------------------------------------------------------------
+value SteamWrap_SubmitUGCItemUpdate(value updateHandle, value changeNotes)
+{
+	if (!val_is_string(updateHandle)  || !val_is_string(changeNotes) || !CheckInit())
+	{
+		return alloc_bool(false);
+	}
+
+	// Create uint64 from the string.
+	uint64 updateHandle64;
+	std::istringstream handleStream(val_string(updateHandle));
+	if (!(handleStream >> updateHandle64))
+	{
+		return alloc_bool(false);
+	}
+
+	s_callbackHandler->SubmitUGCItemUpdate(updateHandle64, val_string(changeNotes));
+ 	return alloc_bool(true);
+}
+DEFINE_PRIM(SteamWrap_SubmitUGCItemUpdate, 2);
+
+//-----------------------------------------------------------------------------------------------------------
+value SteamWrap_OpenOverlay(value url)
+{
+	if (!val_is_string(url) || !CheckInit())
+	{
+		return alloc_bool(false);
+	}
+
+	SteamFriends()->ActivateGameOverlayToWebPage(val_string(url));
+	return alloc_bool(true);
+}
+DEFINE_PRIM(SteamWrap_OpenOverlay, 1);
+//-----------------------------------------------------------------------------------------------------------
+value SteamWrap_StartUpdateUGCItem(value id, value itemID)
+{
+	if (!val_is_int(id)  || !val_is_int(itemID) || !CheckInit())
+	{
+		return alloc_string("0");
+	}
+
+	UGCUpdateHandle_t ugcUpdateHandle = SteamUGC()->StartItemUpdate(val_int(id), val_int(itemID));
+
+	//Change the uint64 to string, easier to handle between haxe & cpp.
+	std::ostringstream updateHandleStream;
+	updateHandleStream << ugcUpdateHandle;
+
+ 	return alloc_string(updateHandleStream.str().c_str());
+}
+DEFINE_PRIM(SteamWrap_StartUpdateUGCItem, 2);
+
+//-----------------------------------------------------------------------------------------------------------
+value SteamWrap_SetUGCItemTitle(value updateHandle, value title)
+{
+	if (!val_is_string(updateHandle) || !val_is_string(title) || !CheckInit())
+	{
+		return alloc_bool(false);
+	}
+
+	// Create uint64 from the string.
+	uint64 updateHandle64;
+	std::istringstream handleStream(val_string(updateHandle));
+	if (!(handleStream >> updateHandle64))
+	{
+		return alloc_bool(false);
+	}
+	bool result = SteamUGC()->SetItemTitle(updateHandle64, val_string(title));
+	return alloc_bool(result);
+}
+DEFINE_PRIM(SteamWrap_SetUGCItemTitle, 2);
+
+//-----------------------------------------------------------------------------------------------------------
+value SteamWrap_SetUGCItemDescription(value updateHandle, value description)
+{
+	if (!val_is_string(updateHandle) || !val_is_string(description) || !CheckInit())
+	{
+		return alloc_bool(false);
+	}
+
+	// Create uint64 from the string.
+	uint64 updateHandle64;
+	std::istringstream handleStream(val_string(updateHandle));
+	if (!(handleStream >> updateHandle64))
+	{
+		return alloc_bool(false);
+	}
+
+	bool result = SteamUGC()->SetItemDescription(updateHandle64, val_string(description));
+	return alloc_bool(result);
+}
+DEFINE_PRIM(SteamWrap_SetUGCItemDescription, 2);
+
+//-----------------------------------------------------------------------------------------------------------
+value SteamWrap_SetUGCItemTags(value updateHandle, value tags)
+{
+	if (!val_is_string(updateHandle) || !val_is_string(tags) || !CheckInit())
+	{
+		return alloc_bool(false);
+	}
+
+	// Create uint64 from the string.
+	uint64 updateHandle64;
+	std::istringstream handleStream(val_string(updateHandle));
+	if (!(handleStream >> updateHandle64))
+	{
+		return alloc_bool(false);
+	}
+	
+	// Create tag array from the string.
+	SteamParamStringArray_t *pTags = getSteamParamStringArray(val_string(tags));
+	
+	bool result = SteamUGC()->SetItemTags(updateHandle64, pTags);
+	
+	deleteSteamParamStringArray(pTags);
+	
+	return alloc_bool(result);
+}
+DEFINE_PRIM(SteamWrap_SetUGCItemTags, 2);
+
+//-----------------------------------------------------------------------------------------------------------
+value SteamWrap_AddUGCItemKeyValueTag(value updateHandle, value keyStr, value valueStr)
+{
+	if (!CheckInit()) return alloc_bool(false);
+	if (!val_is_string(updateHandle)) return alloc_bool(false);
+	if (!val_is_string(keyStr)) return alloc_bool(false);
+	if (!val_is_string(valueStr)) return alloc_bool(false);
+	
+	// Create uint64 from the string.
+	uint64 updateHandle64;
+	std::istringstream handleStream(val_string(updateHandle));
+	if (!(handleStream >> updateHandle64))
+	{
+		return alloc_bool(false);
+	}
+	
+	bool result = SteamUGC()->AddItemKeyValueTag(updateHandle64, val_string(keyStr), val_string(valueStr));
+	return alloc_bool(result);
+}
+DEFINE_PRIM(SteamWrap_AddUGCItemKeyValueTag, 3);
+
+//-----------------------------------------------------------------------------------------------------------
+value SteamWrap_RemoveUGCItemKeyValueTags(value updateHandle, value keyStr)
+{
+	if (!CheckInit()) return alloc_bool(false);
+	if (!val_is_string(updateHandle)) return alloc_bool(false);
+	if (!val_is_string(keyStr)) return alloc_bool(false);
+	
+	// Create uint64 from the string.
+	uint64 updateHandle64;
+	std::istringstream handleStream(val_string(updateHandle));
+	if (!(handleStream >> updateHandle64))
+	{
+		return alloc_bool(false);
+	}
+	
+	bool result = SteamUGC()->RemoveItemKeyValueTags(updateHandle64, val_string(keyStr));
+	return alloc_bool(result);
+}
+DEFINE_PRIM(SteamWrap_RemoveUGCItemKeyValueTags, 2);
+
+//-----------------------------------------------------------------------------------------------------------
+value SteamWrap_SetUGCItemVisibility(value updateHandle, value visibility)
+{
+	if (!val_is_string(updateHandle) || !val_is_int(visibility) || !CheckInit())
+	{
+		return alloc_bool(false);
+	}
+
+	// Create uint64 from the string.
+	uint64 updateHandle64;
+	std::istringstream handleStream(val_string(updateHandle));
+	if (!(handleStream >> updateHandle64))
+	{
+		return alloc_bool(false);
+	}
+
+	ERemoteStoragePublishedFileVisibility visibilityEnum = static_cast<ERemoteStoragePublishedFileVisibility>(val_int(visibility));
+
+	bool result = SteamUGC()->SetItemVisibility(updateHandle64, visibilityEnum);
+	return alloc_bool(result);
+}
+DEFINE_PRIM(SteamWrap_SetUGCItemVisibility, 2);
+
+//-----------------------------------------------------------------------------------------------------------
+value SteamWrap_SetUGCItemContent(value updateHandle, value path)
+{
+	if (!val_is_string(updateHandle) || !val_is_string(path) || !CheckInit())
+	{
+		return alloc_bool(false);
+	}
+
+	// Create uint64 from the string.
+	uint64 updateHandle64;
+	std::istringstream handleStream(val_string(updateHandle));
+	if (!(handleStream >> updateHandle64))
+	{
+		return alloc_bool(false);
+	}
+
+	bool result = SteamUGC()->SetItemContent(updateHandle64, val_string(path));
+	return alloc_bool(result);
+}
+DEFINE_PRIM(SteamWrap_SetUGCItemContent, 2);
+
+//-----------------------------------------------------------------------------------------------------------
+value SteamWrap_SetUGCItemPreviewImage(value updateHandle, value path)
+{
+	if (!val_is_string(updateHandle) || !val_is_string(path) || !CheckInit())
+	{
+		return alloc_bool(false);
+	}
+
+	// Create uint64 from the string.
+	uint64 updateHandle64;
+	std::istringstream handleStream(val_string(updateHandle));
+	if (!(handleStream >> updateHandle64))
+	{
+		return alloc_bool(false);
+	}
+
+	bool result = SteamUGC()->SetItemPreview(updateHandle64, val_string(path));
+	return alloc_bool(result);
+}
+DEFINE_PRIM(SteamWrap_SetUGCItemPreviewImage, 2);
+
+//-----------------------------------------------------------------------------------------------------------
+value SteamWrap_CreateUGCItem(value id)
+{
+	if (!val_is_int(id) || !CheckInit())
+		return alloc_bool(false);
+
+	s_callbackHandler->CreateUGCItem(val_int(id), k_EWorkshopFileTypeCommunity);
+
+ 	return alloc_bool(true);
+}
+DEFINE_PRIM(SteamWrap_CreateUGCItem, 1);
+
+//-----------------------------------------------------------------------------------------------------------
+// Batch publishing: a manifest of items is created (if new) and updated with at most maxConcurrent items in
+// flight, each on its own SteamCall rather than the CallbackHandler's single create/submit call results.
+
+//Which manifest fields an item sets; anything else is left as it is on the Workshop
+static const uint32 kUGCPublishTitle = 1;
+static const uint32 kUGCPublishDescription = 2;
+static const uint32 kUGCPublishMetadata = 4;
+static const uint32 kUGCPublishTags = 8;
+static const uint32 kUGCPublishVisibility = 16;
+static const uint32 kUGCPublishContent = 32;
+static const uint32 kUGCPublishPreview = 64;
+static const uint32 kUGCPublishKeyValueTags = 128;
+
+struct UGCPublishItem
+{
+	PublishedFileId_t id;		//0 to create a new item
+	uint32 fields;
+	std::string title;
+	std::string description;
+	std::string metadata;
+	std::string tags;
+	int32 visibility;
+	std::string content;
+	std::string preview;
+	std::string changeNote;
+	std::vector<std::pair<std::string, std::string> > keyValueTags;
+	
+	UGCUpdateHandle_t update;	//k_UGCUpdateHandleInvalid unless it's being submitted
+	EResult result;
+	bool needsLegalAgreement;
+};
+
+struct UGCPublishBatch
+{
+	int id;
+	AppId_t appID;
+	int maxConcurrent;
+	int inFlight;
+	size_t next;
+	size_t finished;
+	std::vector<UGCPublishItem> items;
+};
+typedef std::shared_ptr<UGCPublishBatch> UGCPublishBatchPtr;
+
+static std::map<int, UGCPublishBatchPtr> s_ugcPublishBatches;
+static int s_ugcPublishCounter = 0;
+
+static bool UGCPublishReadManifest(const unsigned char* data, size_t length, std::vector<UGCPublishItem>& items)
+{
+	PackedParser r(data, length);
+	uint32 count = r.u32();
+	for (uint32 i = 0; i < count && r.ok; i++)
+	{
+		UGCPublishItem item;
+		item.id = strtoull(r.str().c_str(), NULL, 10);
+		item.fields = r.u32();
+		item.title = r.str();
+		item.description = r.str();
+		item.metadata = r.str();
+		item.tags = r.str();
+		item.visibility = r.i32();
+		item.content = r.str();
+		item.preview = r.str();
+		item.changeNote = r.str();
+		uint32 kvCount = r.u32();
+		for (uint32 k = 0; k < kvCount && r.ok; k++)
+		{
+			std::string key = r.str();
+			std::string val = r.str();
+			item.keyValueTags.push_back(std::make_pair(key, val));
+		}
+		item.update = k_UGCUpdateHandleInvalid;
+		item.result = k_EResultOK;
+		item.needsLegalAgreement = false;
+		items.push_back(item);
+	}
+	return r.ok && r.atEnd();
+}
+
+static void UGCPublishPump(const UGCPublishBatchPtr& batch);
+
+static void UGCPublishReset()
+{
+	s_ugcPublishBatches.clear();
+}
+
+static void UGCPublishItemDone(const UGCPublishBatchPtr& batch, size_t index, EResult result, bool needsLegalAgreement)
+{
+	UGCPublishItem& item = batch->items[index];
+	item.update = k_UGCUpdateHandleInvalid;
+	item.result = result;
+	item.needsLegalAgreement = needsLegalAgreement;
+	batch->inFlight--;
+	batch->finished++;
+	
+	value data = alloc_empty_object();
+	alloc_field(data, val_id("batch"), alloc_int(batch->id));
+	alloc_field(data, val_id("index"), alloc_int((int)index));
+	alloc_field(data, val_id("id"), u64_to_hx(item.id));
+	alloc_field(data, val_id("result"), alloc_int(result));
+	alloc_field(data, val_id("needsLegalAgreement"), alloc_bool(needsLegalAgreement));
+	SendEvent(Event(kEventTypeOnUGCItemPublished, result == k_EResultOK, data));
+	
+	if (batch->finished < batch->items.size())
+	{
+		UGCPublishPump(batch);
+		return;
+	}
+	
+	PackedWriter w;
+	w.u32((uint32)batch->items.size());
+	int failed = 0;
+	for (size_t i = 0; i < batch->items.size(); i++)
+	{
+		const UGCPublishItem& it = batch->items[i];
+		w.u64(it.id);
+		w.i32(it.result);
+		w.u8(it.needsLegalAgreement ? 1 : 0);
+		if (it.result != k_EResultOK) failed++;
+	}
+	s_ugcPublishBatches.erase(batch->id);
+	
+	value done = alloc_empty_object();
+	alloc_field(done, val_id("batch"), alloc_int(batch->id));
+	alloc_field(done, val_id("failed"), alloc_int(failed));
+	alloc_field(done, val_id("results"), w.toValue());
+	SendEvent(Event(kEventTypeOnUGCBatchPublished, failed == 0, done));
+}
+
+//Failures known before any call went out are reported from the next RunCallbacks, so the pump never recurses
+//into itself (a manifest full of bad items would otherwise go one frame deeper per item)
+static void UGCPublishItemFailed(const UGCPublishBatchPtr& batch, size_t index, EResult result)
+{
+	DeferEvent([batch, index, result]() {
+		UGCPublishItemDone(batch, index, result, false);
+	});
+}
+
+static bool UGCPublishApply(UGCUpdateHandle_t update, const UGCPublishItem& item)
+{
+	ISteamUGC* ugc = SteamUGC();
+	bool ok = true;
+	if (item.fields & kUGCPublishTitle) ok = ok && ugc->SetItemTitle(update, item.title.c_str());
+	if (item.fields & kUGCPublishDescription) ok = ok && ugc->SetItemDescription(update, item.description.c_str());
+	if (item.fields & kUGCPublishMetadata) ok = ok && ugc->SetItemMetadata(update, item.metadata.c_str());
+	if (item.fields & kUGCPublishVisibility) ok = ok && ugc->SetItemVisibility(update, (ERemoteStoragePublishedFileVisibility)item.visibility);
+	if (item.fields & kUGCPublishContent) ok = ok && ugc->SetItemContent(update, item.content.c_str());
+	if (item.fields & kUGCPublishPreview) ok = ok && ugc->SetItemPreview(update, item.preview.c_str());
+	if (ok && (item.fields & kUGCPublishTags))
+	{
+		SteamParamStringArray_t* tags = getSteamParamStringArray(item.tags.c_str());
+		ok = ugc->SetItemTags(update, tags);
+		deleteSteamParamStringArray(tags);
+	}
+	if (item.fields & kUGCPublishKeyValueTags)
+	{
+		//replaces the values of the given keys
+		for (size_t i = 0; i < item.keyValueTags.size() && ok; i++)
+		{
+			ugc->RemoveItemKeyValueTags(update, item.keyValueTags[i].first.c_str());
+			ok = ugc->AddItemKeyValueTag(update, item.keyValueTags[i].first.c_str(), item.keyValueTags[i].second.c_str());
+		}
+	}
+	return ok;
+}
+
+static void UGCPublishSubmit(const UGCPublishBatchPtr& batch, size_t index)
+{
+	UGCPublishItem& item = batch->items[index];
+	UGCUpdateHandle_t update = SteamUGC()->StartItemUpdate(batch->appID, item.id);
+	if (update == k_UGCUpdateHandleInvalid)
+	{
+		UGCPublishItemFailed(batch, index, k_EResultFail);
+		return;
+	}
+	if (!UGCPublishApply(update, item))
+	{
+		UGCPublishItemFailed(batch, index, k_EResultInvalidParam);
+		return;
+	}
+	
+	SteamAPICall_t call = SteamUGC()->SubmitItemUpdate(update, item.changeNote.empty() ? NULL : item.changeNote.c_str());
+	bool started = StartSteamCall<SubmitItemUpdateResult_t>(call, [batch, index](SubmitItemUpdateResult_t* result, bool ioFailure) {
+		if (ioFailure) UGCPublishItemDone(batch, index, k_EResultIOFailure, false);
+		else UGCPublishItemDone(batch, index, result->m_eResult, result->m_bUserNeedsToAcceptWorkshopLegalAgreement);
+	});
+	if (!started)
+	{
+		UGCPublishItemFailed(batch, index, k_EResultFail);
+		return;
+	}
+	item.update = update;
+}
+
+static void UGCPublishStart(const UGCPublishBatchPtr& batch, size_t index)
+{
+	batch->inFlight++;
+	if (batch->items[index].id != 0)
+	{
+		UGCPublishSubmit(batch, index);
+		return;
+	}
+	
+	SteamAPICall_t call = SteamUGC()->CreateItem(batch->appID, k_EWorkshopFileTypeCommunity);
+	bool started = StartSteamCall<CreateItemResult_t>(call, [batch, index](CreateItemResult_t* result, bool ioFailure) {
+		if (ioFailure)
+		{
+			UGCPublishItemDone(batch, index, k_EResultIOFailure, false);
+			return;
+		}
+		if (result->m_eResult != k_EResultOK)
+		{
+			UGCPublishItemDone(batch, index, result->m_eResult, result->m_bUserNeedsToAcceptWorkshopLegalAgreement);
+			return;
+		}
+		batch->items[index].id = result->m_nPublishedFileId;
+		batch->items[index].needsLegalAgreement = result->m_bUserNeedsToAcceptWorkshopLegalAgreement;
+		UGCPublishSubmit(batch, index);
+	});
+	if (!started) UGCPublishItemFailed(batch, index, k_EResultFail);
+}
+
+static void UGCPublishPump(const UGCPublishBatchPtr& batch)
+{
+	while (batch->inFlight < batch->maxConcurrent && batch->next < batch->items.size())
+	{
+		UGCPublishStart(batch, batch->next++);
+	}
+}
+
+//-----------------------------------------------------------------------------------------------------------
+//Publishes a packed manifest of items (see UGC.publishItems) with at most maxConcurrent of them in flight.
+//Returns the batch id; UGCItemPublished follows each item and UGCBatchPublished the whole batch.
+value SteamWrap_PublishUGCBatch(value appID, value haxeBytes, value maxConcurrent)
+{
+	if (!val_is_int(appID) || !val_is_int(maxConcurrent) || !CheckInit())
+		return alloc_int(-1);
+	
+	CffiBytes bytes = getByteData(haxeBytes);
+	if (bytes.data == 0) return alloc_int(-1);
+	
+	UGCPublishBatchPtr batch(new UGCPublishBatch());
+	if (!UGCPublishReadManifest(bytes.data, bytes.length, batch->items) || batch->items.empty())
+		return alloc_int(-1);
+	
+	batch->id = ++s_ugcPublishCounter;
+	batch->appID = val_int(appID);
+	batch->maxConcurrent = val_int(maxConcurrent) > 0 ? val_int(maxConcurrent) : 1;
+	batch->inFlight = 0;
+	batch->next = 0;
+	batch->finished = 0;
+	s_ugcPublishBatches[batch->id] = batch;
+	
+	//started from RunCallbacks, so even items that fail straight away are reported after the id is returned
+	DeferEvent([batch]() {
+		UGCPublishPump(batch);
+	});
+	return alloc_int(batch->id);
+}
+DEFINE_PRIM(SteamWrap_PublishUGCBatch, 3);
+
+//-----------------------------------------------------------------------------------------------------------
+//GetItemUpdateProgress of every item being submitted, in one table: u32 count, then per item i32 batch,
+//u32 index, u64 id, u32 status, u64 bytes processed, u64 bytes total
+value SteamWrap_GetUGCPublishProgress()
+{
+	if (!CheckInit()) return alloc_null();
+	
+	PackedWriter w;
+	w.u32(0);
+	uint32 count = 0;
+	for (std::map<int, UGCPublishBatchPtr>::iterator it = s_ugcPublishBatches.begin(); it != s_ugcPublishBatches.end(); ++it)
+	{
+		const UGCPublishBatch& batch = *it->second;
+		for (size_t i = 0; i < batch.items.size(); i++)
+		{
+			const UGCPublishItem& item = batch.items[i];
+			if (item.update == k_UGCUpdateHandleInvalid) continue;
+			uint64 processed = 0;
+			uint64 total = 0;
+			EItemUpdateStatus status = SteamUGC()->GetItemUpdateProgress(item.update, &processed, &total);
+			w.i32(batch.id);
+			w.u32((uint32)i);
+			w.u64(item.id);
+			w.u32(status);
+			w.u64(processed);
+			w.u64(total);
+			count++;
+		}
+	}
+	w.setU32(0, count);
+	return w.toValue();
+}
+DEFINE_PRIM(SteamWrap_GetUGCPublishProgress, 0);
+
+//-----------------------------------------------------------------------------------------------------------
+int SteamWrap_AddRequiredTag(const char * handle, const char * tagName)
+{
+	if (!CheckInit()) return 0;
+	
+	UGCQueryHandle_t u64Handle = strtoull(handle, NULL, 0);
+	
+	bool result = SteamUGC()->AddRequiredTag(u64Handle, tagName);
+	return result;
+}
+DEFINE_PRIME2(SteamWrap_AddRequiredTag);
+
+//-----------------------------------------------------------------------------------------------------------
+int SteamWrap_AddRequiredKeyValueTag(const char * handle, const char * pKey, const char * pValue)
+{
+	if (!CheckInit()) return 0;
+	
+	UGCQueryHandle_t u64Handle = strtoull(handle, NULL, 0);
+	
+	bool result = SteamUGC()->AddRequiredKeyValueTag(u64Handle, pKey, pValue);
+	return result;
+}
+DEFINE_PRIME3(SteamWrap_AddRequiredKeyValueTag);
+
+//-----------------------------------------------------------------------------------------------------------
+int SteamWrap_AddExcludedTag(const char * handle, const char * tagName)
+{
+	if (!CheckInit()) return 0;
+	
+	UGCQueryHandle_t u64Handle = strtoull(handle, NULL, 0);
+	
+	bool result = SteamUGC()->AddExcludedTag(u64Handle, tagName);
+	return result;
+}
+DEFINE_PRIME2(SteamWrap_AddExcludedTag);
+
+//-----------------------------------------------------------------------------------------------------------
+int SteamWrap_SetReturnMetadata(const char * handle, int returnMetadata)
+{
+	if (!CheckInit()) return 0;
+	
+	UGCQueryHandle_t u64Handle = strtoull(handle, NULL, 0);
+	
+	bool result = SteamUGC()->SetReturnMetadata(u64Handle, returnMetadata == 1);
+	return result;
+}
+DEFINE_PRIME2(SteamWrap_SetReturnMetadata);
+
+//-----------------------------------------------------------------------------------------------------------
+int SteamWrap_SetReturnKeyValueTags(const char * handle, int returnKeyValueTags)
+{
+	if (!CheckInit()) return 0;
+	
+	UGCQueryHandle_t u64Handle = strtoull(handle, NULL, 0);
+	bool setValue = returnKeyValueTags == 1;
+	
+	bool result = SteamUGC()->SetReturnKeyValueTags(u64Handle, setValue);
+	return result;
+}
+DEFINE_PRIME2(SteamWrap_SetReturnKeyValueTags);
+
+#pragma endregion
+
+#pragma region Scores/Achievements
+static const int kGlobalStatMaxHistoryDays = 60;
+
+//-----------------------------------------------------------------------------------------------------------
+value SteamWrap_SetAchievement(value name)
+{
+	if (!val_is_string(name))
+		return alloc_bool(false);
+	
+	if (!CheckInit())
+	{
+		JournalRecord(kJournalUnlock, val_string(name), 0, 0);
+		return alloc_bool(true);
+	}
+
+	SteamUserStats()->SetAchievement(val_string(name));
+	AchievementSnapshotInvalidate();
+	ProgressQueueDrop(val_string(name));
+	bool result = SteamUserStats()->StoreStats();
+
+	return alloc_bool(result);
+}
+DEFINE_PRIM(SteamWrap_SetAchievement, 1);
+
+value SteamWrap_GetAchievement(value name)
+{
+  if (!val_is_string(name) || !CheckInit()) return alloc_bool(false);
+  bool achieved = false;
+  SteamUserStats()->GetAchievement(val_string(name), &achieved);
+  return alloc_bool(achieved);
+}
+DEFINE_PRIM(SteamWrap_GetAchievement, 1);
+
+value SteamWrap_GetAchievementDisplayAttribute(value name, value key)
+{
+  if (!val_is_string(name) || !val_is_string(key) || !CheckInit()) return alloc_string("");
+  
+  const char* result = SteamUserStats()->GetAchievementDisplayAttribute(val_string(name), val_string(key));
+  return alloc_string(result);
+}
+DEFINE_PRIM(SteamWrap_GetAchievementDisplayAttribute, 2);
+
+value SteamWrap_GetNumAchievements()
+{
+  if (!CheckInit()) return alloc_int(0);
+  
+  uint32 count = SteamUserStats()->GetNumAchievements();
+  return alloc_int((int)count);
+}
+DEFINE_PRIM(SteamWrap_GetNumAchievements, 0);
+
+value SteamWrap_GetAchievementName(value index)
+{
+  if (!val_is_int(index) && !CheckInit()) return alloc_string("");
+  const char* name = SteamUserStats()->GetAchievementName(val_int(index));
+  return alloc_string(name);
+}
+DEFINE_PRIM(SteamWrap_GetAchievementName, 1);
+
+//-----------------------------------------------------------------------------------------------------------
+value SteamWrap_ClearAchievement(value name)
+{
+	if (!val_is_string(name) || !CheckInit())
+		return alloc_bool(false);
+
+	SteamUserStats()->ClearAchievement(val_string(name));
+	AchievementSnapshotInvalidate();
+	bool result = SteamUserStats()->StoreStats();
+
+	return alloc_bool(result);
+}
+DEFINE_PRIM(SteamWrap_ClearAchievement, 1);
+
+//-----------------------------------------------------------------------------------------------------------
+value SteamWrap_IndicateAchievementProgress(value name, value numCurProgres, value numMaxProgress)
+{
+	if (!val_is_string(name) || !val_is_int(numCurProgres) || !val_is_int(numMaxProgress) || !CheckInit())
+		return alloc_bool(false);
+
+	bool result = SteamUserStats()->IndicateAchievementProgress(val_string(name), val_int(numCurProgres), val_int(numMaxProgress));
+
+	return alloc_bool(result);
+}
+DEFINE_PRIM(SteamWrap_IndicateAchievementProgress, 3);
+
+//-----------------------------------------------------------------------------------------------------------
+//Throttled IndicateAchievementProgress: replaces whatever progress was queued for this achievement and lets
+//the pump show it when the achievement's interval allows. Returns false if the indicator was suppressed
+//(progress complete, or achievement already unlocked).
+value SteamWrap_QueueAchievementProgress(value name, value numCurProgress, value numMaxProgress)
+{
+	if (!val_is_string(name) || !val_is_int(numCurProgress) || !val_is_int(numMaxProgress) || !CheckInit())
+		return alloc_bool(false);
+	
+	const char* achName = val_string(name);
+	int cur = val_int(numCurProgress);
+	int max = val_int(numMaxProgress);
+	bool achieved = false;
+	if (max <= 0 || cur < 0 || cur >= max || !SteamUserStats()->GetAchievement(achName, &achieved) || achieved)
+	{
+		ProgressQueueDrop(achName);
+		return alloc_bool(false);
+	}
+	
+	std::map<std::string, QueuedProgress>::iterator it = s_progressQueue.find(achName);
+	if (it == s_progressQueue.end())
+	{
+		QueuedProgress p = { 0, 0, false, -1e9 };
+		it = s_progressQueue.insert(std::make_pair(std::string(achName), p)).first;
+	}
+	
+	QueuedProgress& p = it->second;
+	if (!p.pending) s_progressPending++;
+	p.current = (uint32)cur;
+	p.max = (uint32)max;
+	p.pending = true;
+	return alloc_bool(true);
+}
+DEFINE_PRIM(SteamWrap_QueueAchievementProgress, 3);
+
+//-----------------------------------------------------------------------------------------------------------
+value SteamWrap_SetAchievementProgressInterval(value seconds)
+{
+	if (!val_is_number(seconds))
+		return alloc_bool(false);
+	
+	double interval = val_number(seconds);
+	s_progressInterval = interval > 0 ? interval : 0;
+	return alloc_bool(true);
+}
+DEFINE_PRIM(SteamWrap_SetAchievementProgressInterval, 1);
+
+//-----------------------------------------------------------------------------------------------------------
+//Everything an achievements screen needs in one packed table:
+//  count:u32, then per achievement:
+//  apiName:str | unlocked:u8 | unlockTime:u32 | displayName:str | description:str | hidden:u8 | globalPercent:f32 (-1 until known)
+value SteamWrap_GetAchievementSnapshot()
+{
+	if (!CheckInit())
+		return alloc_null();
+	
+	if (!s_achievementPercentsRequested)
+	{
+		s_achievementPercentsRequested = true;
+		s_callbackHandler->RequestGlobalAchievementPercentages();
+	}
+	
+	if (!s_achievementSnapshotValid)
+	{
+		ISteamUserStats* stats = SteamUserStats();
+		PackedWriter& w = s_achievementSnapshot;
+		w.data.clear();
+		
+		uint32 count = stats->GetNumAchievements();
+		w.u32(count);
+		for (uint32 i = 0; i < count; i++)
+		{
+			const char* name = stats->GetAchievementName(i);
+			bool unlocked = false;
+			uint32 unlockTime = 0;
+			stats->GetAchievementAndUnlockTime(name, &unlocked, &unlockTime);
+			float percent = -1;
+			if (!s_achievementPercentsReady || !stats->GetAchievementAchievedPercent(name, &percent))
+				percent = -1;
+			
+			w.str(name);
+			w.u8(unlocked ? 1 : 0);
+			w.u32(unlockTime);
+			w.str(stats->GetAchievementDisplayAttribute(name, "name"));
+			w.str(stats->GetAchievementDisplayAttribute(name, "desc"));
+			w.u8(strcmp(stats->GetAchievementDisplayAttribute(name, "hidden"), "1") == 0 ? 1 : 0);
+			w.f32(percent);
+		}
+		s_achievementSnapshotValid = true;
+	}
+	
+	return s_achievementSnapshot.toValue();
+}
+DEFINE_PRIM(SteamWrap_GetAchievementSnapshot, 0);
+
+//-----------------------------------------------------------------------------------------------------------
+value SteamWrap_FindLeaderboard(value name)
+{
+	if (!val_is_string(name) || !CheckInit())
+		return alloc_bool(false);
+
+	s_callbackHandler->FindLeaderboard(val_string(name));
+
+ 	return alloc_bool(true);
+}
+DEFINE_PRIM(SteamWrap_FindLeaderboard, 1);
+
+//-----------------------------------------------------------------------------------------------------------
+value SteamWrap_UploadScore(value name, value score, value detail)
+{
+	if (!val_is_string(name) || !val_is_int(score) || !val_is_int(detail) || !CheckInit())
+		return alloc_bool(false);
+
+	bool result = s_callbackHandler->UploadScore(val_string(name), val_int(score), val_int(detail));
+	return alloc_bool(result);
+}
+DEFINE_PRIM(SteamWrap_UploadScore, 3);
+
+//-----------------------------------------------------------------------------------------------------------
+value SteamWrap_DownloadScores(value name, value downloadType, value numBefore, value numAfter)
+{
+	if (!val_is_string(name) || !val_is_int(downloadType) || !val_is_int(numBefore) || !val_is_int(numAfter) || !CheckInit())
+		return alloc_bool(false);
+
+	bool result = s_callbackHandler->DownloadScores(val_string(name), val_int(downloadType), val_int(numBefore), val_int(numAfter));
+	return alloc_bool(result);
+}
+DEFINE_PRIM(SteamWrap_DownloadScores, 4);
+
+//-----------------------------------------------------------------------------------------------------------
+value SteamWrap_RequestGlobalStats()
+{
+	if (!CheckInit())
+		return alloc_bool(false);
+
+	s_callbackHandler->RequestGlobalStats(0);
+	return alloc_bool(true);
+}
+DEFINE_PRIM(SteamWrap_RequestGlobalStats, 0);
+
+//-----------------------------------------------------------------------------------------------------------
+//Like RequestGlobalStats, but also asks for up to historyDays (Steam caps this at 60) of daily history
+value SteamWrap_RequestGlobalStatsWithHistory(value historyDays)
+{
+	if (!val_is_int(historyDays) || !CheckInit())
+		return alloc_bool(false);
+	
+	int days = val_int(historyDays);
+	if (days < 0) days = 0;
+	if (days > kGlobalStatMaxHistoryDays) days = kGlobalStatMaxHistoryDays;
+	
+	s_callbackHandler->RequestGlobalStats(days);
+	return alloc_bool(true);
+}
+DEFINE_PRIM(SteamWrap_RequestGlobalStatsWithHistory, 1);
+
+//-----------------------------------------------------------------------------------------------------------
+value SteamWrap_GetGlobalStat(value name)
+{
+	if (!val_is_string(name) || !CheckInit())
+		return alloc_int(0);
+
+	int64 val;
+	SteamUserStats()->GetGlobalStat(val_string(name), &val);
+
+	return alloc_int((int)val);
+}
+DEFINE_PRIM(SteamWrap_GetGlobalStat, 1);
+
+//-----------------------------------------------------------------------------------------------------------
+//Totals and daily history (most recent day first) for a comma-separated list of global stats, packed as
+//  count:u32, then per stat: name:str | type:u8 | total | days:u32 | day[days]
+//where type is 1 for int64 stats (total and days are i64), 2 for double stats (f64), 0 if the stat isn't
+//available (no total or days follow). Int stats are tried first, since asking with the wrong type just fails.
+value SteamWrap_GetGlobalStatHistory(value names, value maxDays)
+{
+	if (!val_is_string(names) || !val_is_int(maxDays) || !CheckInit())
+		return alloc_null();
+	
+	int days = val_int(maxDays);
+	if (days < 0) days = 0;
+	if (days > kGlobalStatMaxHistoryDays) days = kGlobalStatMaxHistoryDays;
+	
+	std::vector<std::string> statNames;
+	split(val_string(names), ',', statNames);
+	
+	ISteamUserStats* stats = SteamUserStats();
+	int64 intHistory[kGlobalStatMaxHistoryDays];
+	double floatHistory[kGlobalStatMaxHistoryDays];
+	
+	PackedWriter w;
+	w.u32((uint32)statNames.size());
+	for (size_t i = 0; i < statNames.size(); i++)
+	{
+		const char* name = statNames[i].c_str();
+		w.str(statNames[i]);
+		
+		int64 intTotal = 0;
+		double floatTotal = 0;
+		if (stats->GetGlobalStat(name, &intTotal))
+		{
+			int32 count = days > 0 ? stats->GetGlobalStatHistory(name, intHistory, days * sizeof(int64)) : 0;
+			if (count < 0) count = 0;
+			w.u8(1);
+			w.u64((uint64)intTotal);
+			w.u32((uint32)count);
+			for (int32 d = 0; d < count; d++) w.u64((uint64)intHistory[d]);
+		}
+		else if (stats->GetGlobalStat(name, &floatTotal))
+		{
+			int32 count = days > 0 ? stats->GetGlobalStatHistory(name, floatHistory, days * sizeof(double)) : 0;
+			if (count < 0) count = 0;
+			w.u8(2);
+			w.f64(floatTotal);
+			w.u32((uint32)count);
+			for (int32 d = 0; d < count; d++) w.f64(floatHistory[d]);
+		}
+		else
+		{
+			w.u8(0);
+		}
+	}
+	
+	return w.toValue();
+}
+DEFINE_PRIM(SteamWrap_GetGlobalStatHistory, 2);
+
+//-----------------------------------------------------------------------------------------------------------
+value SteamWrap_GetFriendPersonaName(value steamID)
+{
+	if (!val_is_string(steamID) || !CheckInit())
+		return alloc_string("");
+	
+	const char* name = PersonaCacheLookup(hx_to_id(steamID).ConvertToUint64());
+	return alloc_string(name ? name : "");
+}
+DEFINE_PRIM(SteamWrap_GetFriendPersonaName, 1);
+
+//-----------------------------------------------------------------------------------------------------------
+//Looks up a comma-separated list of Steam IDs in the persona cache, requesting the unknown ones.
+//Returns count:u32, then (steamID:u64, known:u8, name:str) per ID; unknown names arrive with PersonaNamesResolved.
+value SteamWrap_GetPersonaNames(value steamIDs)
+{
+	if (!val_is_string(steamIDs) || !CheckInit())
+		return alloc_null();
+	
+	uint32 count = 0;
+	uint64* ids = getUint64Array(val_string(steamIDs), &count);
+	
+	PackedWriter w;
+	w.u32(count);
+	for (uint32 i = 0; i < count; i++)
+	{
+		const char* name = PersonaCacheLookup(ids[i]);
+		w.u64(ids[i]);
+		w.u8(name ? 1 : 0);
+		w.str(name ? name : "");
+	}
+	delete[] ids;
+	
+	return w.toValue();
+}
+DEFINE_PRIM(SteamWrap_GetPersonaNames, 1);
+
+//-----------------------------------------------------------------------------------------------------------
+value SteamWrap_GetPersonaName()
+{
+	if(!CheckInit())
+		return alloc_string("unknown");
+	
+	const char * persona = SteamFriends()->GetPersonaName();
+	
+	return alloc_string(persona);
+}
+DEFINE_PRIM(SteamWrap_GetPersonaName, 0);
+
+//-----------------------------------------------------------------------------------------------------------
+value SteamWrap_BIsAppInstalled(value appID)
+{
+	if(!val_is_int(appID) || !CheckInit()) return alloc_bool(false);
+	bool result = SteamApps()->BIsAppInstalled(val_int(appID));
+	return alloc_bool(result);
+}
+DEFINE_PRIM(SteamWrap_BIsAppInstalled, 1);
+
+//-----------------------------------------------------------------------------------------------------------
+value SteamWrap_BIsDlcInstalled(value appID)
+{
+	if(!val_is_int(appID) || !CheckInit()) return alloc_bool(false);
+	bool result = SteamApps()->BIsDlcInstalled(val_int(appID));
+	return alloc_bool(result);
+}
+DEFINE_PRIM(SteamWrap_BIsDlcInstalled, 1);
+
+//-----------------------------------------------------------------------------------------------------------
+value SteamWrap_GetSteamID()
+{
+	if(!CheckInit())
+		return alloc_string("0");
+	
+	CSteamID userId = SteamUser()->GetSteamID();
+	
+	std::ostringstream returnData;
+	returnData << userId.ConvertToUint64();
+	
+	return alloc_string(returnData.str().c_str());
+}
+DEFINE_PRIM(SteamWrap_GetSteamID, 0);
+
+//-----------------------------------------------------------------------------------------------------------
+value SteamWrap_RestartAppIfNecessary(value appId)
+{
+	if (!val_is_int(appId))
+		return alloc_bool(false);
+
+	bool result = SteamAPI_RestartAppIfNecessary(val_int(appId));
+	return alloc_bool(result);
+}
+DEFINE_PRIM(SteamWrap_RestartAppIfNecessary, 1);
+
+//-----------------------------------------------------------------------------------------------------------
+value SteamWrap_IsOverlayEnabled()
+{
+	bool result = SteamUtils()->IsOverlayEnabled();
+	return alloc_bool(result);
+}
+DEFINE_PRIM(SteamWrap_IsOverlayEnabled, 0);
+
+//-----------------------------------------------------------------------------------------------------------
+value SteamWrap_BOverlayNeedsPresent()
+{
+	bool result = SteamUtils()->BOverlayNeedsPresent();
+	return alloc_bool(result);
+}
+DEFINE_PRIM(SteamWrap_BOverlayNeedsPresent, 0);
+
+//-----------------------------------------------------------------------------------------------------------
+value SteamWrap_IsSteamInBigPictureMode()
+{
+	bool result = SteamUtils()->IsSteamInBigPictureMode();
+	return alloc_bool(result);
+}
+DEFINE_PRIM(SteamWrap_IsSteamInBigPictureMode, 0);
+
+//-----------------------------------------------------------------------------------------------------------
+value SteamWrap_IsSteamRunning()
+{
+	bool result = SteamAPI_IsSteamRunning();
+	return alloc_bool(result);
+}
+DEFINE_PRIM(SteamWrap_IsSteamRunning, 0);
+
+//-----------------------------------------------------------------------------------------------------------
+value SteamWrap_GetCurrentGameLanguage()
+{
+	const char* result = SteamApps()->GetCurrentGameLanguage();
+	return alloc_string(result);
+}
+DEFINE_PRIM(SteamWrap_GetCurrentGameLanguage, 0);
+
+//-----------------------------------------------------------------------------------------------------------
+
+#pragma endregion
+
+#pragma region Leaderboards
+//Leaderboards the game works with are resolved once into integer ids, all in parallel, and every upload and
+//download is its own SteamCall, so any number of them can be in flight at once, across boards and on one board.
+//Requests made while a board is still being resolved wait on the board and go out the moment it's found.
+//Each request gets a request id, which comes back with its result event.
+enum LeaderboardState
 {
-	SteamAPICall_t hSteamAPICall = SteamRemoteStorage()->UGCDownload( hContent, unPriority );
-	m_callResultUGCDownload.Set(hSteamAPICall, this, &CallbackHandler::OnUGCDownload);
-}
+	kLeaderboardFinding = 0,
+	kLeaderboardFound = 1,
+	kLeaderboardFailed = 2
+};
 
-void CallbackHandler::OnUGCDownload(RemoteStorageDownloadUGCResult_t* pResult, bool bIOFailure)
+struct ManagedLeaderboard
 {
-	if(pResult->m_eResult == k_EResultOK)
+	std::string name;
+	SteamLeaderboard_t handle;
+	int state;
+	std::vector<std::function<void()> > waiting;
+	
+	//the user's current entry, so uploads that can't improve it are skipped without a round trip
+	ELeaderboardSortMethod sortMethod;
+	bool bestKnown;		//whether we know if the user has an entry at all
+	bool hasBest;
+	int32 best;
+};
+
+static std::vector<ManagedLeaderboard> s_managedLeaderboards;
+static std::map<std::string, int> s_managedLeaderboardIds;
+static int s_leaderboardRequestCounter = 0;
+
+//Downloaded windows (board, request type, range), kept for s_leaderboardWindowTTL seconds. Identical downloads
+//asked for while one is in flight join it instead of making their own call. An entry only exists while its call
+//is in flight or its result is still fresh; expired ones are evicted whenever a new window is added.
+struct LeaderboardWindowKey
+{
+	int board;
+	int type;
+	int start;
+	int end;
+	
+	bool operator<(const LeaderboardWindowKey& o) const
 	{
-		std::ostringstream data;
-		
-		data << "result:";
-		data << pResult->m_eResult;
-		data << ",fileHandle:";
-		data << pResult->m_hFile;
-		data << ",appID:";
-		data << pResult->m_nAppID;
-		data << ",sizeInBytes:";
-		data << pResult->m_nSizeInBytes;
-		data << ",fileName:";
-		data << pResult->m_pchFileName;
-		data << ",steamIDOwner:";
-		data << pResult->m_ulSteamIDOwner;
-		
-		SendEvent(Event(kEventTypeOnUGCDownload, pResult->m_eResult == k_EResultOK, data.str()));
-		return;
+		if (board != o.board) return board < o.board;
+		if (type != o.type) return type < o.type;
+		if (start != o.start) return start < o.start;
+		return end < o.end;
 	}
-	SendEvent(Event(kEventTypeOnUGCDownload, false));
-}
+};
 
-void CallbackHandler::OnDownloadItem( DownloadItemResult_t *pCallback )
+struct LeaderboardWindowFetch
 {
-	if (pCallback->m_unAppID != SteamUtils()->GetAppID()) return;
-	
-	std::ostringstream fileIDStream;
-	PublishedFileId_t m_ugcFileID = pCallback->m_nPublishedFileId;
-	fileIDStream << m_ugcFileID;
-	SendEvent(Event(kEventTypeOnDownloadItem, pCallback->m_eResult == k_EResultOK, fileIDStream.str().c_str()));
+	std::vector<int> requests;
+};
+
+struct LeaderboardWindow
+{
+	std::shared_ptr<std::vector<unsigned char> > packed;		//PackLeaderboardEntries output, null until fetched
+	double fetched;
+	std::shared_ptr<LeaderboardWindowFetch> fetch;			//the call in flight for this window, if any
+};
+
+static std::map<LeaderboardWindowKey, LeaderboardWindow> s_leaderboardWindows;
+static double s_leaderboardWindowTTL = 0;
+
+static void CloudForgetFile(const char* fileName);
+
+static void ManagedLeaderboardsReset()
+{
+	s_managedLeaderboards.clear();
+	s_managedLeaderboardIds.clear();
+	s_leaderboardWindows.clear();
 }
 
-void CallbackHandler::OnItemInstalled( ItemInstalled_t *pCallback )
+//Forgets every cached window of a board. Calls in flight for it still answer their requests but aren't cached,
+//and later requests don't join them, since they may predate whatever changed the board.
+static void ManagedLeaderboardInvalidateWindows(int id)
 {
-	if (pCallback->m_unAppID != SteamUtils()->GetAppID()) return;
-	
-	std::ostringstream fileIDStream;
-	PublishedFileId_t m_ugcFileID = pCallback->m_nPublishedFileId;
-	fileIDStream << m_ugcFileID;
-	SendEvent(Event(kEventTypeOnDownloadItem, true, fileIDStream.str().c_str()));
+	std::map<LeaderboardWindowKey, LeaderboardWindow>::iterator it = s_leaderboardWindows.begin();
+	while (it != s_leaderboardWindows.end())
+	{
+		if (it->first.board == id) s_leaderboardWindows.erase(it++);
+		else ++it;
+	}
 }
 
-#pragma endregion
-//-----------------------------------------------------------------------------------------------------------
-static CallbackHandler* s_callbackHandler = NULL;
+//Drops every window that has no call in flight and no result younger than the TTL
+static void ManagedLeaderboardEvictWindows()
+{
+	double now = NowSeconds();
+	std::map<LeaderboardWindowKey, LeaderboardWindow>::iterator it = s_leaderboardWindows.begin();
+	while (it != s_leaderboardWindows.end())
+	{
+		const LeaderboardWindow& window = it->second;
+		bool fresh = window.packed && s_leaderboardWindowTTL > 0 && now - window.fetched < s_leaderboardWindowTTL;
+		if (!window.fetch && !fresh) s_leaderboardWindows.erase(it++);
+		else ++it;
+	}
+}
 
-#pragma endregion
+inline ManagedLeaderboard* ManagedLeaderboardGet(int id)
+{
+	if (id < 0 || id >= (int)s_managedLeaderboards.size()) return NULL;
+	return &s_managedLeaderboards[id];
+}
 
-extern "C"
+//Would uploading score (without ForceUpdate) change the user's entry?
+static bool ManagedLeaderboardImproves(const ManagedLeaderboard& board, int32 score)
 {
+	if (!board.bestKnown || !board.hasBest) return true;
+	switch (board.sortMethod)
+	{
+		case k_ELeaderboardSortMethodAscending: return score < board.best;
+		case k_ELeaderboardSortMethodDescending: return score > board.best;
+		default: return true;
+	}
+}
 
-//-----------------------------------------------------------------------------------------------------------
-static bool CheckInit()
+static void ManagedLeaderboardSetBest(int id, int32 score)
 {
-	return SteamUser() && SteamUser()->BLoggedOn() && SteamUserStats() && (s_callbackHandler != 0) && (g_eventHandler != 0);
+	ManagedLeaderboard& board = s_managedLeaderboards[id];
+	board.bestKnown = true;
+	board.hasBest = true;
+	board.best = score;
 }
 
-//-----------------------------------------------------------------------------------------------------------
-value SteamWrap_Init(value onEvent, value notificationPosition)
+//Reads the user's own entry (if any) from a downloaded page into the best-score tracking
+static void ManagedLeaderboardSeedBest(int id, SteamLeaderboardEntries_t entries, int count)
 {
-	bool result = SteamAPI_Init();
-	if (result)
+	CSteamID self = SteamUser()->GetSteamID();
+	for (int i = 0; i < count; i++)
 	{
-		g_eventHandler = new AutoGCRoot(onEvent);
-		s_callbackHandler = new CallbackHandler();
-
-		switch (val_int(notificationPosition))
+		LeaderboardEntry_t entry;
+		if (SteamUserStats()->GetDownloadedLeaderboardEntry(entries, i, &entry, NULL, 0) && entry.m_steamIDUser == self)
 		{
-			case 0:
-				SteamUtils()->SetOverlayNotificationPosition(k_EPositionTopLeft);
-				break;
-			case 1:
-				SteamUtils()->SetOverlayNotificationPosition(k_EPositionTopRight);
-				break;
-			case 2:
-				SteamUtils()->SetOverlayNotificationPosition(k_EPositionBottomRight);
-				break;
-			case 3:
-				SteamUtils()->SetOverlayNotificationPosition(k_EPositionBottomLeft);
-				break;
-			default:
-				SteamUtils()->SetOverlayNotificationPosition(k_EPositionBottomRight);
-				break;
+			ManagedLeaderboardSetBest(id, entry.m_nScore);
+			return;
 		}
 	}
-	return alloc_bool(result);
 }
-DEFINE_PRIM(SteamWrap_Init, 2);
 
-//-----------------------------------------------------------------------------------------------------------
-void SteamWrap_Shutdown()
+//Asks for just the user's own entry to learn their current best
+static void ManagedLeaderboardFetchBest(int id)
 {
-	SteamAPI_Shutdown();
-	delete g_eventHandler;
-	g_eventHandler = NULL;
-	delete s_callbackHandler;
-	s_callbackHandler = NULL;
+	SteamAPICall_t call = SteamUserStats()->DownloadLeaderboardEntries(s_managedLeaderboards[id].handle, k_ELeaderboardDataRequestGlobalAroundUser, 0, 0);
+	StartSteamCall<LeaderboardScoresDownloaded_t>(call, [id](LeaderboardScoresDownloaded_t* result, bool ioFailure) {
+		if (ioFailure || id >= (int)s_managedLeaderboards.size()) return;
+		ManagedLeaderboard& board = s_managedLeaderboards[id];
+		
+		//an upload may have landed while this was in flight; that result is newer
+		if (board.bestKnown) return;
+		
+		ManagedLeaderboardSeedBest(id, result->m_hSteamLeaderboardEntries, result->m_cEntryCount);
+		board.bestKnown = true;
+	});
 }
-DEFINE_PRIM(SteamWrap_Shutdown, 0);
 
-//-----------------------------------------------------------------------------------------------------------
-void SteamWrap_RunCallbacks()
+static void ManagedLeaderboardResolved(int id, LeaderboardFindResult_t* result, bool ioFailure)
 {
-	SteamAPI_RunCallbacks();
+	ManagedLeaderboard& board = s_managedLeaderboards[id];
+	bool found = !ioFailure && result->m_bLeaderboardFound;
+	board.state = found ? kLeaderboardFound : kLeaderboardFailed;
+	if (found)
+	{
+		board.handle = result->m_hSteamLeaderboard;
+		board.sortMethod = SteamUserStats()->GetLeaderboardSortMethod(board.handle);
+		ManagedLeaderboardFetchBest(id);
+	}
+	
+	value data = alloc_empty_object();
+	alloc_field(data, val_id("board"), alloc_int(id));
+	alloc_field(data, val_id("name"), alloc_string(board.name.c_str()));
+	alloc_field(data, val_id("entryCount"), alloc_int(found ? SteamUserStats()->GetLeaderboardEntryCount(board.handle) : 0));
+	SendEvent(Event(kEventTypeOnManagedLeaderboardFound, found, data));
+	
+	//the board vector may grow while these run, so take them out first
+	std::vector<std::function<void()> > waiting;
+	waiting.swap(s_managedLeaderboards[id].waiting);
+	for (size_t i = 0; i < waiting.size(); i++) waiting[i]();
 }
-DEFINE_PRIM(SteamWrap_RunCallbacks, 0);
 
-#pragma region Stats
-//-----------------------------------------------------------------------------------------------------------
-value SteamWrap_RequestStats()
+static void ManagedLeaderboardFind(int id, int sortMethod, int displayType)
 {
-	if (!CheckInit())
-		return alloc_bool(false);
+	ManagedLeaderboard& board = s_managedLeaderboards[id];
+	board.state = kLeaderboardFinding;
+	
+	SteamAPICall_t call = sortMethod > 0 ?
+		SteamUserStats()->FindOrCreateLeaderboard(board.name.c_str(), (ELeaderboardSortMethod)sortMethod, (ELeaderboardDisplayType)displayType) :
+		SteamUserStats()->FindLeaderboard(board.name.c_str());
+	
+	bool started = StartSteamCall<LeaderboardFindResult_t>(call, [id](LeaderboardFindResult_t* result, bool ioFailure) {
+		ManagedLeaderboardResolved(id, result, ioFailure);
+	});
+	if (!started)
+	{
+		//still kLeaderboardFinding until then, so anything asked in the meantime waits for this as usual
+		DeferEvent([id]() {
+			ManagedLeaderboardResolved(id, NULL, true);
+		});
+	}
+}
 
-	bool result = SteamUserStats()->RequestCurrentStats();
-	return alloc_bool(result);
+//Runs op once the board is resolved (right away if it already is); op checks the board's state itself. Whatever
+//op reports without waiting on Steam goes through DeferEvent, since it may run inside the prim that asked for it.
+static void ManagedLeaderboardWhenResolved(int id, const std::function<void()>& op)
+{
+	if (s_managedLeaderboards[id].state == kLeaderboardFinding)
+		s_managedLeaderboards[id].waiting.push_back(op);
+	else
+		op();
 }
-DEFINE_PRIM(SteamWrap_RequestStats, 0);
 
-//-----------------------------------------------------------------------------------------------------------
-value SteamWrap_GetStat(value name)
+static void SendManagedScoreUploaded(int request, int board, bool success, LeaderboardScoreUploaded_t* result, int32 skippedScore = 0)
 {
-	if (!val_is_string(name)|| !CheckInit())
-		return alloc_int(0);
+	bool skipped = success && result == NULL;
+	value data = alloc_empty_object();
+	alloc_field(data, val_id("request"), alloc_int(request));
+	alloc_field(data, val_id("board"), alloc_int(board));
+	alloc_field(data, val_id("skipped"), alloc_bool(skipped));
+	alloc_field(data, val_id("score"), alloc_int(skipped ? skippedScore : (success ? result->m_nScore : 0)));
+	alloc_field(data, val_id("scoreChanged"), alloc_bool(success && !skipped && result->m_bScoreChanged));
+	alloc_field(data, val_id("rankNew"), alloc_int(success && !skipped ? result->m_nGlobalRankNew : 0));
+	alloc_field(data, val_id("rankPrevious"), alloc_int(success && !skipped ? result->m_nGlobalRankPrevious : 0));
+	SendEvent(Event(kEventTypeOnManagedScoreUploaded, success, data));
+}
 
-	int val = 0;
-	SteamUserStats()->GetStat(val_string(name), &val);
-	return alloc_int(val);
+static void ManagedLeaderboardUpload(int request, int id, int32 score, const std::vector<int32>& details, bool forceUpdate)
+{
+	ManagedLeaderboard& board = s_managedLeaderboards[id];
+	if (board.state != kLeaderboardFound)
+	{
+		DeferEvent([request, id]() {
+			SendManagedScoreUploaded(request, id, false, NULL);
+		});
+		return;
+	}
+	
+	//KeepBest would leave the entry as it is anyway, so don't bother the server
+	if (!forceUpdate && !ManagedLeaderboardImproves(board, score))
+	{
+		DeferEvent([request, id, score]() {
+			SendManagedScoreUploaded(request, id, true, NULL, score);
+		});
+		return;
+	}
+	
+	SteamAPICall_t call = SteamUserStats()->UploadLeaderboardScore(board.handle,
+		forceUpdate ? k_ELeaderboardUploadScoreMethodForceUpdate : k_ELeaderboardUploadScoreMethodKeepBest,
+		score, details.empty() ? NULL : details.data(), (int)details.size());
+	
+	bool started = StartSteamCall<LeaderboardScoreUploaded_t>(call, [request, id, forceUpdate](LeaderboardScoreUploaded_t* result, bool ioFailure) {
+		bool success = !ioFailure && result->m_bSuccess;
+		if (success && (forceUpdate || result->m_bScoreChanged))
+		{
+			ManagedLeaderboardSetBest(id, result->m_nScore);
+		}
+		else if (success && !s_managedLeaderboards[id].hasBest)
+		{
+			//KeepBest kept an entry we didn't know about, and it beats this score: go and read it
+			s_managedLeaderboards[id].bestKnown = false;
+			ManagedLeaderboardFetchBest(id);
+		}
+		if (success && result->m_bScoreChanged)
+		{
+			ManagedLeaderboardInvalidateWindows(id);
+		}
+		SendManagedScoreUploaded(request, id, success, result);
+	});
+	if (!started)
+	{
+		DeferEvent([request, id]() {
+			SendManagedScoreUploaded(request, id, false, NULL);
+		});
+	}
 }
-DEFINE_PRIM(SteamWrap_GetStat, 1);
 
-//-----------------------------------------------------------------------------------------------------------
-value SteamWrap_GetStatFloat(value name)
+//entries is null if the download failed
+static void SendManagedScoresDownloaded(int request, int board, const std::vector<unsigned char>* entries)
 {
-	if (!val_is_string(name)|| !CheckInit())
-		return alloc_float(0.0);
+	value data = alloc_empty_object();
+	alloc_field(data, val_id("request"), alloc_int(request));
+	alloc_field(data, val_id("board"), alloc_int(board));
+	if (entries != NULL)
+	{
+		alloc_field(data, val_id("entries"), bytes_to_hx(entries->data(), (int)entries->size()));
+	}
+	SendEvent(Event(kEventTypeOnManagedScoresDownloaded, entries != NULL, data));
+}
 
-	float val = 0.0;
-	SteamUserStats()->GetStat(val_string(name), &val);
-	return alloc_float(val);
+static void ManagedLeaderboardWindowDone(const LeaderboardWindowKey& key, const std::shared_ptr<LeaderboardWindowFetch>& fetch, const std::shared_ptr<std::vector<unsigned char> >& packed)
+{
+	std::map<LeaderboardWindowKey, LeaderboardWindow>::iterator it = s_leaderboardWindows.find(key);
+	if (it != s_leaderboardWindows.end() && it->second.fetch == fetch)
+	{
+		it->second.fetch.reset();
+		if (packed && s_leaderboardWindowTTL > 0)
+		{
+			it->second.packed = packed;
+			it->second.fetched = NowSeconds();
+		}
+		else
+		{
+			s_leaderboardWindows.erase(it);
+		}
+	}
+	
+	for (size_t i = 0; i < fetch->requests.size(); i++)
+	{
+		SendManagedScoresDownloaded(fetch->requests[i], key.board, packed.get());
+	}
 }
-DEFINE_PRIM(SteamWrap_GetStatFloat, 1);
 
-//-----------------------------------------------------------------------------------------------------------
-value SteamWrap_GetStatInt(value name)
+static void ManagedLeaderboardDownload(int request, int id, int requestType, int rangeStart, int rangeEnd)
 {
-	if (!val_is_string(name)|| !CheckInit())
-		return alloc_int(0);
+	ManagedLeaderboard& board = s_managedLeaderboards[id];
+	if (board.state != kLeaderboardFound)
+	{
+		DeferEvent([request, id]() {
+			SendManagedScoresDownloaded(request, id, NULL);
+		});
+		return;
+	}
+	
+	LeaderboardWindowKey key = { id, requestType, rangeStart, rangeEnd };
+	std::map<LeaderboardWindowKey, LeaderboardWindow>::iterator it = s_leaderboardWindows.find(key);
+	if (it != s_leaderboardWindows.end())
+	{
+		LeaderboardWindow& window = it->second;
+		if (window.packed && NowSeconds() - window.fetched < s_leaderboardWindowTTL)
+		{
+			std::shared_ptr<std::vector<unsigned char> > packed = window.packed;
+			DeferEvent([request, id, packed]() {
+				SendManagedScoresDownloaded(request, id, packed.get());
+			});
+			return;
+		}
+		if (window.fetch)
+		{
+			window.fetch->requests.push_back(request);
+			return;
+		}
+	}
+	
+	ManagedLeaderboardEvictWindows();
+	LeaderboardWindow& window = s_leaderboardWindows[key];
+	window.packed.reset();
+	std::shared_ptr<LeaderboardWindowFetch> fetch(new LeaderboardWindowFetch());
+	fetch->requests.push_back(request);
+	window.fetch = fetch;
+	
+	SteamAPICall_t call = SteamUserStats()->DownloadLeaderboardEntries(board.handle, (ELeaderboardDataRequest)requestType, rangeStart, rangeEnd);
+	
+	bool started = StartSteamCall<LeaderboardScoresDownloaded_t>(call, [key, fetch](LeaderboardScoresDownloaded_t* result, bool ioFailure) {
+		std::shared_ptr<std::vector<unsigned char> > packed;
+		if (!ioFailure)
+		{
+			if (!s_managedLeaderboards[key.board].bestKnown)
+			{
+				ManagedLeaderboardSeedBest(key.board, result->m_hSteamLeaderboardEntries, result->m_cEntryCount);
+			}
+			PackedWriter w;
+			PackLeaderboardEntries(w, s_managedLeaderboards[key.board].name.c_str(), result->m_hSteamLeaderboardEntries, result->m_cEntryCount);
+			packed.reset(new std::vector<unsigned char>());
+			packed->swap(w.data);
+		}
+		ManagedLeaderboardWindowDone(key, fetch, packed);
+	});
+	if (!started)
+	{
+		DeferEvent([key, fetch]() {
+			ManagedLeaderboardWindowDone(key, fetch, std::shared_ptr<std::vector<unsigned char> >());
+		});
+	}
+}
 
-	int val = 0;
-	SteamUserStats()->GetStat(val_string(name), &val);
-	return alloc_int(val);
+//-----------------------------------------------------------------------------------------------------------
+//Resolves a leaderboard and returns its id; call it for every board up front and they're all found in parallel.
+//sortMethod/displayType follow ELeaderboardSortMethod/ELeaderboardDisplayType; with a sort method the board is
+//created if it doesn't exist yet, with sortMethod 0 it's only looked up. Asking again for a board that failed
+//to resolve retries it.
+value SteamWrap_ResolveLeaderboard(value name, value sortMethod, value displayType)
+{
+	if (!val_is_string(name) || !val_is_int(sortMethod) || !val_is_int(displayType) || !CheckInit())
+		return alloc_int(-1);
+	
+	int sort = val_int(sortMethod);
+	int display = val_int(displayType);
+	if (sort < k_ELeaderboardSortMethodNone || sort > k_ELeaderboardSortMethodDescending) sort = k_ELeaderboardSortMethodNone;
+	if (display < k_ELeaderboardDisplayTypeNumeric || display > k_ELeaderboardDisplayTypeTimeMilliSeconds) display = k_ELeaderboardDisplayTypeNumeric;
+	
+	std::map<std::string, int>::iterator it = s_managedLeaderboardIds.find(val_string(name));
+	if (it != s_managedLeaderboardIds.end())
+	{
+		if (s_managedLeaderboards[it->second].state == kLeaderboardFailed)
+			ManagedLeaderboardFind(it->second, sort, display);
+		return alloc_int(it->second);
+	}
+	
+	ManagedLeaderboard board;
+	board.name = val_string(name);
+	board.handle = 0;
+	board.state = kLeaderboardFinding;
+	board.sortMethod = k_ELeaderboardSortMethodNone;
+	board.bestKnown = false;
+	board.hasBest = false;
+	board.best = 0;
+	
+	int id = (int)s_managedLeaderboards.size();
+	s_managedLeaderboards.push_back(board);
+	s_managedLeaderboardIds[board.name] = id;
+	ManagedLeaderboardFind(id, sort, display);
+	return alloc_int(id);
 }
-DEFINE_PRIM(SteamWrap_GetStatInt, 1);
+DEFINE_PRIM(SteamWrap_ResolveLeaderboard, 3);
 
 //-----------------------------------------------------------------------------------------------------------
-value SteamWrap_SetStat(value name, value val)
+//0 = still resolving, 1 = found, 2 = failed, -1 = no such id
+int SteamWrap_GetLeaderboardState(int id)
 {
-	if (!val_is_string(name) || !val_is_int(val) || !CheckInit())
-		return alloc_bool(false);
-
-	bool result = SteamUserStats()->SetStat(val_string(name), (int) val_int(val));
-
-	return alloc_bool(result);
+	ManagedLeaderboard* board = ManagedLeaderboardGet(id);
+	return board ? board->state : -1;
 }
-DEFINE_PRIM(SteamWrap_SetStat, 2);
+DEFINE_PRIME1(SteamWrap_GetLeaderboardState);
 
 //-----------------------------------------------------------------------------------------------------------
-value SteamWrap_SetStatFloat(value name, value val)
+//The user's best score on a board as far as we know it, or null if they have no entry (or it isn't known yet)
+value SteamWrap_GetLeaderboardBest(value board)
 {
-	if (!val_is_string(name) || !val_is_float(val) || !CheckInit())
-		return alloc_bool(false);
-
-	bool result = SteamUserStats()->SetStat(val_string(name), (float) val_float(val));
-
-	return alloc_bool(result);
+	if (!val_is_int(board))
+		return alloc_null();
+	
+	ManagedLeaderboard* b = ManagedLeaderboardGet(val_int(board));
+	if (b == NULL || !b->bestKnown || !b->hasBest)
+		return alloc_null();
+	return alloc_int(b->best);
 }
-DEFINE_PRIM(SteamWrap_SetStatFloat, 2);
+DEFINE_PRIM(SteamWrap_GetLeaderboardBest, 1);
 
 //-----------------------------------------------------------------------------------------------------------
-value SteamWrap_SetStatInt(value name, value val)
+//How long downloaded windows are reused for, in seconds; 0 (the default) turns the cache off. Identical downloads
+//in flight at the same time are always merged into one call.
+void SteamWrap_SetLeaderboardCacheTTL(float seconds)
 {
-	if (!val_is_string(name) || !val_is_int(val) || !CheckInit())
-		return alloc_bool(false);
+	s_leaderboardWindowTTL = seconds > 0 ? seconds : 0;
+	ManagedLeaderboardEvictWindows();
+}
+DEFINE_PRIME1v(SteamWrap_SetLeaderboardCacheTTL);
 
-	bool result = SteamUserStats()->SetStat(val_string(name), (int) val_int(val));
+//-----------------------------------------------------------------------------------------------------------
+//Uploads a score with any number of details (Array<Int>, up to k_cLeaderboardDetailsMax). Returns the request id.
+value SteamWrap_UploadLeaderboardScoreById(value board, value score, value details, value forceUpdate)
+{
+	if (!val_is_int(board) || !val_is_int(score) || !val_is_bool(forceUpdate) || !CheckInit())
+		return alloc_int(-1);
+	
+	int id = val_int(board);
+	if (ManagedLeaderboardGet(id) == NULL)
+		return alloc_int(-1);
+	
+	std::vector<int32> detailValues;
+	if (val_is_array(details))
+	{
+		int count = val_array_size(details);
+		if (count > k_cLeaderboardDetailsMax) count = k_cLeaderboardDetailsMax;
+		for (int i = 0; i < count; i++) detailValues.push_back(val_int(val_array_i(details, i)));
+	}
+	
+	int request = ++s_leaderboardRequestCounter;
+	int32 scoreValue = val_int(score);
+	bool force = val_bool(forceUpdate);
+	ManagedLeaderboardWhenResolved(id, [request, id, scoreValue, detailValues, force]() {
+		ManagedLeaderboardUpload(request, id, scoreValue, detailValues, force);
+	});
+	return alloc_int(request);
+}
+DEFINE_PRIM(SteamWrap_UploadLeaderboardScoreById, 4);
 
-	return alloc_bool(result);
+//-----------------------------------------------------------------------------------------------------------
+//Downloads entries; requestType follows ELeaderboardDataRequest (0 global, 1 around user, 2 friends) and the range
+//is passed straight to DownloadLeaderboardEntries. Returns the request id.
+value SteamWrap_DownloadLeaderboardScoresById(value board, value requestType, value rangeStart, value rangeEnd)
+{
+	if (!val_is_int(board) || !val_is_int(requestType) || !val_is_int(rangeStart) || !val_is_int(rangeEnd) || !CheckInit())
+		return alloc_int(-1);
+	
+	int id = val_int(board);
+	int type = val_int(requestType);
+	if (ManagedLeaderboardGet(id) == NULL || type < k_ELeaderboardDataRequestGlobal || type > k_ELeaderboardDataRequestFriends)
+		return alloc_int(-1);
+	
+	int request = ++s_leaderboardRequestCounter;
+	int start = val_int(rangeStart);
+	int end = val_int(rangeEnd);
+	ManagedLeaderboardWhenResolved(id, [request, id, type, start, end]() {
+		ManagedLeaderboardDownload(request, id, type, start, end);
+	});
+	return alloc_int(request);
 }
-DEFINE_PRIM(SteamWrap_SetStatInt, 2);
+DEFINE_PRIM(SteamWrap_DownloadLeaderboardScoresById, 4);
 
 //-----------------------------------------------------------------------------------------------------------
-value SteamWrap_StoreStats()
+// Replays
+//-----------------------------------------------------------------------------------------------------------
+//Blobs (ghost replays and the like) attached to the user's entry on a board. Attaching compresses the blob,
+//writes it to the cloud, shares it and attaches the UGC handle in one go; downloading takes the ugcHandles of
+//any number of downloaded entries and fetches them all in parallel. Blobs are kept as stored (compressed) in
+//an optional LRU disk cache keyed by UGC handle, so a ghost is only ever downloaded once.
+struct ReplayCacheEntry
+{
+	uint64 size;
+	uint64 lastUse;
+};
+
+struct ReplayCache
 {
-	if (!CheckInit())
-		return alloc_bool(false);
+	std::string dir;
+	uint64 maxBytes;
+	uint64 totalBytes;
+	uint64 useCounter;
+	bool lruDirty;		//only use order changed since the index was last written
+	std::map<uint64, ReplayCacheEntry> entries;
+};
 
-	bool result = SteamUserStats()->StoreStats();
-	return alloc_bool(result);
-}
-DEFINE_PRIM(SteamWrap_StoreStats, 0);
+static const char kReplayCacheMagic[4] = { 'S', 'W', 'R', '1' };
+static ReplayCache s_replayCache;
 
-#pragma endregion
+static std::string ReplayCacheFile(uint64 handle)
+{
+	std::ostringstream path;
+	path << s_replayCache.dir << "/" << handle << ".replay";
+	return path.str();
+}
 
-#pragma region UGC
-//-----------------------------------------------------------------------------------------------------------
-value SteamWrap_SubmitUGCItemUpdate(value updateHandle, value changeNotes)
+static void ReplayCacheSaveIndex()
 {
-	if (!val_is_string(updateHandle)  || !val_is_string(changeNotes) || !CheckInit())
+	std::string path = s_replayCache.dir + "/index";
+	FILE* f = fopen(path.c_str(), "wb");
+	if (f == NULL) return;
+	s_replayCache.lruDirty = false;
+	
+	fwrite(kReplayCacheMagic, 1, 4, f);
+	for (std::map<uint64, ReplayCacheEntry>::iterator it = s_replayCache.entries.begin(); it != s_replayCache.entries.end(); ++it)
 	{
-		return alloc_bool(false);
+		uint64 record[3] = { it->first, it->second.size, it->second.lastUse };
+		fwrite(record, sizeof(uint64), 3, f);
 	}
+	fclose(f);
+}
 
-	// Create uint64 from the string.
-	uint64 updateHandle64;
-	std::istringstream handleStream(val_string(updateHandle));
-	if (!(handleStream >> updateHandle64))
+static void ReplayCacheRemove(std::map<uint64, ReplayCacheEntry>::iterator it)
+{
+	remove(ReplayCacheFile(it->first).c_str());
+	s_replayCache.totalBytes -= it->second.size;
+	s_replayCache.entries.erase(it);
+}
+
+//Drops least recently used blobs until the cache fits
+static void ReplayCacheEvict()
+{
+	while (s_replayCache.totalBytes > s_replayCache.maxBytes && !s_replayCache.entries.empty())
 	{
-		return alloc_bool(false);
+		std::map<uint64, ReplayCacheEntry>::iterator oldest = s_replayCache.entries.begin();
+		for (std::map<uint64, ReplayCacheEntry>::iterator it = s_replayCache.entries.begin(); it != s_replayCache.entries.end(); ++it)
+		{
+			if (it->second.lastUse < oldest->second.lastUse) oldest = it;
+		}
+		ReplayCacheRemove(oldest);
 	}
+}
 
-	s_callbackHandler->SubmitUGCItemUpdate(updateHandle64, val_string(changeNotes));
- 	return alloc_bool(true);
+//Writes out the use order of cache hits, which isn't saved as it happens
+static void ReplayCacheClose()
+{
+	if (!s_replayCache.dir.empty() && s_replayCache.lruDirty) ReplayCacheSaveIndex();
+	s_replayCache.lruDirty = false;
 }
-DEFINE_PRIM(SteamWrap_SubmitUGCItemUpdate, 2);
 
-//-----------------------------------------------------------------------------------------------------------
-value SteamWrap_OpenOverlay(value url)
+static void ReplayCacheOpen(const char* dir, uint64 maxBytes)
 {
-	if (!val_is_string(url) || !CheckInit())
+	ReplayCacheClose();
+	s_replayCache.dir = dir;
+	s_replayCache.maxBytes = maxBytes;
+	s_replayCache.totalBytes = 0;
+	s_replayCache.useCounter = 0;
+	s_replayCache.entries.clear();
+	if (s_replayCache.dir.empty()) return;
+	
+	std::string path = s_replayCache.dir + "/index";
+	FILE* f = fopen(path.c_str(), "rb");
+	if (f != NULL)
 	{
-		return alloc_bool(false);
+		char magic[4];
+		uint64 record[3];
+		if (fread(magic, 1, 4, f) == 4 && memcmp(magic, kReplayCacheMagic, 4) == 0)
+		{
+			while (fread(record, sizeof(uint64), 3, f) == 3)
+			{
+				ReplayCacheEntry entry;
+				entry.size = record[1];
+				entry.lastUse = record[2];
+				s_replayCache.entries[record[0]] = entry;
+				s_replayCache.totalBytes += entry.size;
+				if (entry.lastUse > s_replayCache.useCounter) s_replayCache.useCounter = entry.lastUse;
+			}
+		}
+		fclose(f);
 	}
-
-	SteamFriends()->ActivateGameOverlayToWebPage(val_string(url));
-	return alloc_bool(true);
+	
+	//the limit may have shrunk since last time
+	ReplayCacheEvict();
+	ReplayCacheSaveIndex();
 }
-DEFINE_PRIM(SteamWrap_OpenOverlay, 1);
-//-----------------------------------------------------------------------------------------------------------
-value SteamWrap_StartUpdateUGCItem(value id, value itemID)
+
+static bool ReplayCacheGet(uint64 handle, std::vector<unsigned char>& out)
 {
-	if (!val_is_int(id)  || !val_is_int(itemID) || !CheckInit())
+	if (s_replayCache.dir.empty()) return false;
+	std::map<uint64, ReplayCacheEntry>::iterator it = s_replayCache.entries.find(handle);
+	if (it == s_replayCache.entries.end()) return false;
+	
+	out.resize((size_t)it->second.size);
+	FILE* f = fopen(ReplayCacheFile(handle).c_str(), "rb");
+	size_t read = 0;
+	if (f != NULL)
 	{
-		return alloc_string("0");
+		read = out.empty() ? 0 : fread(out.data(), 1, out.size(), f);
+		fclose(f);
 	}
+	if (f == NULL || read != out.size())
+	{
+		//deleted or torn behind our back
+		ReplayCacheRemove(it);
+		ReplayCacheSaveIndex();
+		return false;
+	}
+	
+	//a hit only changes the use order; that's saved with the next add or eviction, or at shutdown
+	it->second.lastUse = ++s_replayCache.useCounter;
+	s_replayCache.lruDirty = true;
+	return true;
+}
 
-	UGCUpdateHandle_t ugcUpdateHandle = SteamUGC()->StartItemUpdate(val_int(id), val_int(itemID));
-
-	//Change the uint64 to string, easier to handle between haxe & cpp.
-	std::ostringstream updateHandleStream;
-	updateHandleStream << ugcUpdateHandle;
+static void ReplayCachePut(uint64 handle, const unsigned char* data, uint64 length)
+{
+	if (s_replayCache.dir.empty() || length > s_replayCache.maxBytes) return;
+	
+	std::map<uint64, ReplayCacheEntry>::iterator it = s_replayCache.entries.find(handle);
+	if (it != s_replayCache.entries.end()) ReplayCacheRemove(it);
+	
+	FILE* f = fopen(ReplayCacheFile(handle).c_str(), "wb");
+	if (f == NULL) return;
+	bool written = fwrite(data, 1, (size_t)length, f) == length;
+	fclose(f);
+	if (!written)
+	{
+		remove(ReplayCacheFile(handle).c_str());
+		return;
+	}
+	
+	ReplayCacheEntry entry;
+	entry.size = length;
+	entry.lastUse = ++s_replayCache.useCounter;
+	s_replayCache.entries[handle] = entry;
+	s_replayCache.totalBytes += length;
+	ReplayCacheEvict();
+	ReplayCacheSaveIndex();
+}
 
- 	return alloc_string(updateHandleStream.str().c_str());
+static void SendReplayAttached(int request, int board, bool success, UGCHandle_t handle)
+{
+	value data = alloc_empty_object();
+	alloc_field(data, val_id("request"), alloc_int(request));
+	alloc_field(data, val_id("board"), alloc_int(board));
+	alloc_field(data, val_id("handle"), u64_to_hx(success ? handle : k_UGCHandleInvalid));
+	SendEvent(Event(kEventTypeOnReplayAttached, success, data));
 }
-DEFINE_PRIM(SteamWrap_StartUpdateUGCItem, 2);
 
-//-----------------------------------------------------------------------------------------------------------
-value SteamWrap_SetUGCItemTitle(value updateHandle, value title)
+//blob is what's stored under the handle; it's unwrapped here if it was compressed by AttachLeaderboardReplay
+static void SendReplayDownloaded(int request, UGCHandle_t handle, const std::vector<unsigned char>* blob)
 {
-	if (!val_is_string(updateHandle) || !val_is_string(title) || !CheckInit())
+	value data = alloc_empty_object();
+	alloc_field(data, val_id("request"), alloc_int(request));
+	alloc_field(data, val_id("handle"), u64_to_hx(handle));
+	
+	bool success = blob != NULL;
+	if (success)
 	{
-		return alloc_bool(false);
+		std::vector<unsigned char> raw;
+		if (IsCompressedFrame(blob->data(), (uint32)blob->size()))
+		{
+			success = DecompressFrame(blob->data(), (uint32)blob->size(), raw);
+			blob = &raw;
+		}
+		if (success) alloc_field(data, val_id("data"), bytes_to_hx(blob->data(), (int)blob->size()));
 	}
+	SendEvent(Event(kEventTypeOnReplayDownloaded, success, data));
+}
 
-	// Create uint64 from the string.
-	uint64 updateHandle64;
-	std::istringstream handleStream(val_string(updateHandle));
-	if (!(handleStream >> updateHandle64))
+static void ManagedLeaderboardAttachReplay(int request, int id, const std::string& fileName, const std::shared_ptr<std::vector<unsigned char> >& frame)
+{
+	if (s_managedLeaderboards[id].state != kLeaderboardFound || !SteamRemoteStorage()->FileWrite(fileName.c_str(), frame->data(), (int32)frame->size()))
 	{
-		return alloc_bool(false);
+		DeferEvent([request, id]() {
+			SendReplayAttached(request, id, false, k_UGCHandleInvalid);
+		});
+		return;
+	}
+	CloudForgetFile(fileName.c_str());
+	
+	SteamAPICall_t call = SteamRemoteStorage()->FileShare(fileName.c_str());
+	bool started = StartSteamCall<RemoteStorageFileShareResult_t>(call, [request, id, frame](RemoteStorageFileShareResult_t* shared, bool ioFailure) {
+		if (ioFailure || shared->m_eResult != k_EResultOK)
+		{
+			SendReplayAttached(request, id, false, k_UGCHandleInvalid);
+			return;
+		}
+		
+		//we already have the bytes, so a download of our own ghost never has to go to the network
+		UGCHandle_t handle = shared->m_hFile;
+		ReplayCachePut(handle, frame->data(), frame->size());
+		
+		SteamAPICall_t attach = SteamUserStats()->AttachLeaderboardUGC(s_managedLeaderboards[id].handle, handle);
+		bool attaching = StartSteamCall<LeaderboardUGCSet_t>(attach, [request, id, handle](LeaderboardUGCSet_t* result, bool ioFailure) {
+			SendReplayAttached(request, id, !ioFailure && result->m_eResult == k_EResultOK, handle);
+		});
+		if (!attaching)
+		{
+			SendReplayAttached(request, id, false, k_UGCHandleInvalid);
+		}
+	});
+	if (!started)
+	{
+		DeferEvent([request, id]() {
+			SendReplayAttached(request, id, false, k_UGCHandleInvalid);
+		});
 	}
-	bool result = SteamUGC()->SetItemTitle(updateHandle64, val_string(title));
-	return alloc_bool(result);
 }
-DEFINE_PRIM(SteamWrap_SetUGCItemTitle, 2);
 
-//-----------------------------------------------------------------------------------------------------------
-value SteamWrap_SetUGCItemDescription(value updateHandle, value description)
+static void ReplayDownload(int request, UGCHandle_t handle, uint32 priority)
 {
-	if (!val_is_string(updateHandle) || !val_is_string(description) || !CheckInit())
+	std::shared_ptr<std::vector<unsigned char> > cached(new std::vector<unsigned char>());
+	if (handle == k_UGCHandleInvalid || ReplayCacheGet(handle, *cached))
 	{
-		return alloc_bool(false);
+		bool hit = handle != k_UGCHandleInvalid;
+		DeferEvent([request, handle, cached, hit]() {
+			SendReplayDownloaded(request, handle, hit ? cached.get() : NULL);
+		});
+		return;
 	}
-
-	// Create uint64 from the string.
-	uint64 updateHandle64;
-	std::istringstream handleStream(val_string(updateHandle));
-	if (!(handleStream >> updateHandle64))
+	
+	SteamAPICall_t call = SteamRemoteStorage()->UGCDownload(handle, priority);
+	bool started = StartSteamCall<RemoteStorageDownloadUGCResult_t>(call, [request, handle](RemoteStorageDownloadUGCResult_t* result, bool ioFailure) {
+		if (ioFailure || result->m_eResult != k_EResultOK || result->m_nSizeInBytes < 0)
+		{
+			SendReplayDownloaded(request, handle, NULL);
+			return;
+		}
+		
+		std::vector<unsigned char> blob(result->m_nSizeInBytes);
+		int32 read = blob.empty() ? 0 : SteamRemoteStorage()->UGCRead(handle, blob.data(), (int32)blob.size(), 0, k_EUGCRead_ContinueReadingUntilFinished);
+		if (read != (int32)blob.size())
+		{
+			SendReplayDownloaded(request, handle, NULL);
+			return;
+		}
+		
+		ReplayCachePut(handle, blob.data(), blob.size());
+		SendReplayDownloaded(request, handle, &blob);
+	});
+	if (!started)
 	{
-		return alloc_bool(false);
+		DeferEvent([request, handle]() {
+			SendReplayDownloaded(request, handle, NULL);
+		});
 	}
+}
 
-	bool result = SteamUGC()->SetItemDescription(updateHandle64, val_string(description));
-	return alloc_bool(result);
+//-----------------------------------------------------------------------------------------------------------
+//Enables the replay disk cache in an existing directory (its own, nothing else should live there), capped at
+//maxBytes; an empty directory turns it off. Blobs cached by earlier sessions are picked up again.
+void SteamWrap_SetReplayCache(const char* directory, int maxBytes)
+{
+	ReplayCacheOpen(directory, maxBytes > 0 ? (uint64)maxBytes : 0);
 }
-DEFINE_PRIM(SteamWrap_SetUGCItemDescription, 2);
+DEFINE_PRIME2v(SteamWrap_SetReplayCache);
 
 //-----------------------------------------------------------------------------------------------------------
-value SteamWrap_SetUGCItemTags(value updateHandle, value tags)
+//Compresses data, writes it to the cloud as fileName, shares it and attaches it to the user's entry on the board
+//(so upload the score first). Returns the request id; ReplayAttached carries the UGC handle.
+value SteamWrap_AttachLeaderboardReplay(value board, value fileName, value haxeBytes)
 {
-	if (!val_is_string(updateHandle) || !val_is_string(tags) || !CheckInit())
+	if (!val_is_int(board) || !val_is_string(fileName) || !CheckInit())
+		return alloc_int(-1);
+	
+	int id = val_int(board);
+	CffiBytes bytes = getByteData(haxeBytes);
+	if (ManagedLeaderboardGet(id) == NULL || bytes.data == 0)
+		return alloc_int(-1);
+	
+	std::shared_ptr<std::vector<unsigned char> > frame(new std::vector<unsigned char>());
+	CompressFrame(bytes.data, bytes.length, 1, *frame);
+	
+	int request = ++s_leaderboardRequestCounter;
+	std::string name = val_string(fileName);
+	ManagedLeaderboardWhenResolved(id, [request, id, name, frame]() {
+		ManagedLeaderboardAttachReplay(request, id, name, frame);
+	});
+	return alloc_int(request);
+}
+DEFINE_PRIM(SteamWrap_AttachLeaderboardReplay, 3);
+
+//-----------------------------------------------------------------------------------------------------------
+//Downloads the blobs behind any number of entries' UGC handles (Array<String>) in parallel. Returns one request
+//id for all of them; there is one ReplayDownloaded event per handle, in whatever order they finish.
+value SteamWrap_DownloadLeaderboardReplays(value handles, value priority)
+{
+	if (!val_is_array(handles) || !val_is_int(priority) || !CheckInit())
+		return alloc_int(-1);
+	
+	int request = ++s_leaderboardRequestCounter;
+	int count = val_array_size(handles);
+	for (int i = 0; i < count; i++)
 	{
-		return alloc_bool(false);
+		value handle = val_array_i(handles, i);
+		UGCHandle_t ugc = val_is_string(handle) ? strtoull(val_string(handle), NULL, 0) : k_UGCHandleInvalid;
+		ReplayDownload(request, ugc == 0 ? k_UGCHandleInvalid : ugc, (uint32)val_int(priority));
 	}
+	return alloc_int(request);
+}
+DEFINE_PRIM(SteamWrap_DownloadLeaderboardReplays, 2);
 
-	// Create uint64 from the string.
-	uint64 updateHandle64;
-	std::istringstream handleStream(val_string(updateHandle));
-	if (!(handleStream >> updateHandle64))
-	{
-		return alloc_bool(false);
+#pragma endregion
+
+#pragma region New Workshop
+//NEW STEAM WORKSHOP---------------------------------------------------------------------------------------------
+
+int SteamWrap_GetNumSubscribedItems(int dummy)
+{
+	if (!CheckInit()) return 0;
+	int numItems = SteamUGC()->GetNumSubscribedItems();
+	return numItems;
+}
+DEFINE_PRIME1(SteamWrap_GetNumSubscribedItems);
+
+value SteamWrap_GetSubscribedItems()
+{
+	if (!CheckInit()) return alloc_string("");
+	
+	int numSubscribed = SteamUGC()->GetNumSubscribedItems();
+	if(numSubscribed <= 0) return alloc_string("");
+	std::vector<PublishedFileId_t> vecPublishedFileID(numSubscribed);
+	
+	int result = SteamUGC()->GetSubscribedItems(vecPublishedFileID.data(), numSubscribed);
+	
+	std::ostringstream data;
+	for(int i = 0; i < result; i++){
+		if(i != 0){
+			data << ",";
+		}
+		data << vecPublishedFileID[i];
 	}
 	
-	// Create tag array from the string.
-	SteamParamStringArray_t *pTags = getSteamParamStringArray(val_string(tags));
+	return alloc_string(data.str().c_str());
+}
+DEFINE_PRIM(SteamWrap_GetSubscribedItems, 0);
+
+int SteamWrap_GetItemState(const char * publishedFileID)
+{
+	if (!CheckInit()) return 0;
+	PublishedFileId_t nPublishedFileID = (PublishedFileId_t) strtoll(publishedFileID, NULL, 10);
+	return SteamUGC()->GetItemState(nPublishedFileID);
+}
+DEFINE_PRIME1(SteamWrap_GetItemState);
+
+value SteamWrap_GetItemDownloadInfo(value publishedFileID)
+{
+	if (!CheckInit()) return alloc_string("");
+	if (!val_is_string(publishedFileID)) return alloc_string("");
 	
-	bool result = SteamUGC()->SetItemTags(updateHandle64, pTags);
+	PublishedFileId_t nPublishedFileID = (PublishedFileId_t) strtoll(val_string(publishedFileID), NULL, 10);
 	
-	deleteSteamParamStringArray(pTags);
+	uint64 punBytesDownloaded;
+	uint64 punBytesTotal;
 	
-	return alloc_bool(result);
+	bool result = SteamUGC()->GetItemDownloadInfo(nPublishedFileID, &punBytesDownloaded, &punBytesTotal);
+	
+	if(result){
+		std::ostringstream data;
+		data << punBytesDownloaded;
+		data << ",";
+		data << punBytesTotal;
+		return alloc_string(data.str().c_str());
+	}
+	
+	return alloc_string("0,0");
 }
-DEFINE_PRIM(SteamWrap_SetUGCItemTags, 2);
+DEFINE_PRIM(SteamWrap_GetItemDownloadInfo, 1);
 
-//-----------------------------------------------------------------------------------------------------------
-value SteamWrap_AddUGCItemKeyValueTag(value updateHandle, value keyStr, value valueStr)
+int SteamWrap_DownloadItem(const char * publishedFileID, int highPriority)
 {
-	if (!CheckInit()) return alloc_bool(false);
-	if (!val_is_string(updateHandle)) return alloc_bool(false);
-	if (!val_is_string(keyStr)) return alloc_bool(false);
-	if (!val_is_string(valueStr)) return alloc_bool(false);
+	if (!CheckInit()) return false;
+	PublishedFileId_t nPublishedFileID = (PublishedFileId_t) strtoll(publishedFileID, NULL, 10);
 	
-	// Create uint64 from the string.
-	uint64 updateHandle64;
-	std::istringstream handleStream(val_string(updateHandle));
-	if (!(handleStream >> updateHandle64))
-	{
-		return alloc_bool(false);
+	bool bHighPriority = highPriority == 1;
+	WorkshopMappedFilesRelease(nPublishedFileID);
+	bool result = SteamUGC()->DownloadItem(nPublishedFileID, bHighPriority);
+	return result;
+}
+DEFINE_PRIME2(SteamWrap_DownloadItem);
+
+value SteamWrap_GetItemInstallInfo(value publishedFileID, value maxFolderPathLength)
+{
+	if (!CheckInit()) return alloc_string("");
+	if (!val_is_string(publishedFileID)) return alloc_string("");
+	if (!val_is_int(maxFolderPathLength)) return alloc_string("");
+	
+	PublishedFileId_t nPublishedFileID = (PublishedFileId_t) strtoll(val_string(publishedFileID), NULL, 10);
+	
+	uint64 punSizeOnDisk;
+	uint32 punTimeStamp;
+	uint32 cchFolderSize = (uint32) val_int(maxFolderPathLength);
+	if (cchFolderSize == 0) return alloc_string("0||0|");
+	std::vector<char> folder(cchFolderSize, 0);
+	char * pchFolder = folder.data();
+	
+	bool result = SteamUGC()->GetItemInstallInfo(nPublishedFileID, &punSizeOnDisk, pchFolder, cchFolderSize, &punTimeStamp);
+	
+	if(result){
+		std::ostringstream data;
+		data << punSizeOnDisk;
+		data << "|";
+		data << pchFolder;
+		data << "|";
+		data << cchFolderSize;
+		data << "|";
+		data << punTimeStamp;
+		return alloc_string(data.str().c_str());
 	}
 	
-	bool result = SteamUGC()->AddItemKeyValueTag(updateHandle64, val_string(keyStr), val_string(valueStr));
-	return alloc_bool(result);
+	return alloc_string("0||0|");
 }
-DEFINE_PRIM(SteamWrap_AddUGCItemKeyValueTag, 3);
+DEFINE_PRIM(SteamWrap_GetItemInstallInfo, 2);
 
-//-----------------------------------------------------------------------------------------------------------
-value SteamWrap_RemoveUGCItemKeyValueTags(value updateHandle, value keyStr)
+static const uint32 kWorkshopFolderMax = 4096;
+
+//one row per subscribed item: u64 id, u32 state, u64 bytes downloaded, u64 bytes total, u64 size on disk,
+//u32 install timestamp, str install folder; sizes and folder are zero/empty when Steam has nothing for them
+value SteamWrap_GetSubscribedItemsInfo()
 {
-	if (!CheckInit()) return alloc_bool(false);
-	if (!val_is_string(updateHandle)) return alloc_bool(false);
-	if (!val_is_string(keyStr)) return alloc_bool(false);
+	if (!CheckInit()) return alloc_null();
 	
-	// Create uint64 from the string.
-	uint64 updateHandle64;
-	std::istringstream handleStream(val_string(updateHandle));
-	if (!(handleStream >> updateHandle64))
+	ISteamUGC* ugc = SteamUGC();
+	uint32 numSubscribed = ugc->GetNumSubscribedItems();
+	std::vector<PublishedFileId_t> ids(numSubscribed);
+	if (numSubscribed > 0) numSubscribed = ugc->GetSubscribedItems(ids.data(), numSubscribed);
+	
+	static char folder[kWorkshopFolderMax];
+	PackedWriter w;
+	w.u32(numSubscribed);
+	for (uint32 i = 0; i < numSubscribed; i++)
 	{
-		return alloc_bool(false);
+		PublishedFileId_t id = ids[i];
+		uint32 state = ugc->GetItemState(id);
+		
+		uint64 downloaded = 0;
+		uint64 total = 0;
+		if (!ugc->GetItemDownloadInfo(id, &downloaded, &total)) downloaded = total = 0;
+		
+		uint64 sizeOnDisk = 0;
+		uint32 timeStamp = 0;
+		folder[0] = 0;
+		if (state & k_EItemStateInstalled)
+		{
+			if (!ugc->GetItemInstallInfo(id, &sizeOnDisk, folder, kWorkshopFolderMax, &timeStamp))
+			{
+				sizeOnDisk = 0;
+				timeStamp = 0;
+				folder[0] = 0;
+			}
+			folder[kWorkshopFolderMax - 1] = 0;
+		}
+		
+		w.u64(id);
+		w.u32(state);
+		w.u64(downloaded);
+		w.u64(total);
+		w.u64(sizeOnDisk);
+		w.u32(timeStamp);
+		w.str(folder);
 	}
-	
-	bool result = SteamUGC()->RemoveItemKeyValueTags(updateHandle64, val_string(keyStr));
-	return alloc_bool(result);
+	return w.toValue();
 }
-DEFINE_PRIM(SteamWrap_RemoveUGCItemKeyValueTags, 2);
+DEFINE_PRIM(SteamWrap_GetSubscribedItemsInfo, 0);
 
 //-----------------------------------------------------------------------------------------------------------
-value SteamWrap_SetUGCItemVisibility(value updateHandle, value visibility)
+// Download manager: items wait in a priority queue and at most s_downloadMaxActive of them are handed to
+// DownloadItem() at once. Failed downloads are retried after a growing delay, and the progress of everything
+// pending is polled here and sent as one packed event per interval rather than polled item by item from Haxe.
+// An item is forgotten once WorkshopDownloadFinished went out for it, so the table only holds pending downloads.
+
+enum WorkshopDownloadState
 {
-	if (!val_is_string(updateHandle) || !val_is_int(visibility) || !CheckInit())
-	{
-		return alloc_bool(false);
-	}
+	kDownloadUnknown = -1,
+	kDownloadQueued = 0,
+	kDownloadActive = 1,
+	kDownloadWaitingRetry = 2,
+};
 
-	// Create uint64 from the string.
-	uint64 updateHandle64;
-	std::istringstream handleStream(val_string(updateHandle));
-	if (!(handleStream >> updateHandle64))
+struct WorkshopDownload
+{
+	int state;
+	int priority;
+	uint64 order;
+	int attempts;
+	double retryAt;
+	uint64 bytesDownloaded;
+	uint64 bytesTotal;
+};
+
+//highest priority first, first come first served within a priority
+struct WorkshopDownloadKey
+{
+	int priority;
+	uint64 order;
+	PublishedFileId_t id;
+	
+	bool operator<(const WorkshopDownloadKey& o) const
 	{
-		return alloc_bool(false);
+		if (priority != o.priority) return priority > o.priority;
+		return order < o.order;
 	}
+};
 
-	ERemoteStoragePublishedFileVisibility visibilityEnum = static_cast<ERemoteStoragePublishedFileVisibility>(val_int(visibility));
+static std::map<PublishedFileId_t, WorkshopDownload> s_downloads;
+static std::set<WorkshopDownloadKey> s_downloadQueue;
+static int s_downloadActive = 0;
+static int s_downloadWaiting = 0;
+static uint64 s_downloadOrder = 0;
+static int s_downloadMaxActive = 2;
+static int s_downloadMaxAttempts = 3;
+static double s_downloadRetryDelay = 5.0;
+static double s_downloadProgressInterval = 0.5;
+static double s_downloadNextProgress = 0;
+static bool s_downloadProgressDirty = false;
 
-	bool result = SteamUGC()->SetItemVisibility(updateHandle64, visibilityEnum);
-	return alloc_bool(result);
+static void WorkshopDownloadsReset()
+{
+	s_downloads.clear();
+	s_downloadQueue.clear();
+	s_downloadActive = 0;
+	s_downloadWaiting = 0;
+	s_downloadProgressDirty = false;
 }
-DEFINE_PRIM(SteamWrap_SetUGCItemVisibility, 2);
 
-//-----------------------------------------------------------------------------------------------------------
-value SteamWrap_SetUGCItemContent(value updateHandle, value path)
+inline WorkshopDownloadKey WorkshopDownloadKeyOf(PublishedFileId_t id, const WorkshopDownload& d)
 {
-	if (!val_is_string(updateHandle) || !val_is_string(path) || !CheckInit())
+	WorkshopDownloadKey key = { d.priority, d.order, id };
+	return key;
+}
+
+static void WorkshopDownloadSettle(PublishedFileId_t id, WorkshopDownload& d, EResult result)
+{
+	s_downloadProgressDirty = true;
+	if (result != k_EResultOK && d.attempts < s_downloadMaxAttempts)
 	{
-		return alloc_bool(false);
+		d.state = kDownloadWaitingRetry;
+		d.retryAt = NowSeconds() + s_downloadRetryDelay * d.attempts;
+		s_downloadWaiting++;
+		return;
 	}
+	
+	value data = alloc_empty_object();
+	alloc_field(data, val_id("id"), u64_to_hx(id));
+	alloc_field(data, val_id("result"), alloc_int(result));
+	alloc_field(data, val_id("attempts"), alloc_int(d.attempts));
+	s_downloads.erase(id);	//d is gone from here on
+	SendEvent(Event(kEventTypeOnWorkshopDownloadFinished, result == k_EResultOK, data));
+}
 
-	// Create uint64 from the string.
-	uint64 updateHandle64;
-	std::istringstream handleStream(val_string(updateHandle));
-	if (!(handleStream >> updateHandle64))
+static void WorkshopDownloadStart(PublishedFileId_t id, WorkshopDownload& d)
+{
+	d.attempts++;
+	d.bytesDownloaded = 0;
+	d.bytesTotal = 0;
+	WorkshopMappedFilesRelease(id);
+	if (!SteamUGC()->DownloadItem(id, d.priority > 0))
 	{
-		return alloc_bool(false);
+		WorkshopDownloadSettle(id, d, k_EResultFail);
+		return;
 	}
-
-	bool result = SteamUGC()->SetItemContent(updateHandle64, val_string(path));
-	return alloc_bool(result);
+	d.state = kDownloadActive;
+	s_downloadActive++;
+	s_downloadProgressDirty = true;
 }
-DEFINE_PRIM(SteamWrap_SetUGCItemContent, 2);
 
-//-----------------------------------------------------------------------------------------------------------
-value SteamWrap_SetUGCItemPreviewImage(value updateHandle, value path)
+static void WorkshopDownloadResult(PublishedFileId_t id, EResult result)
 {
-	if (!val_is_string(updateHandle) || !val_is_string(path) || !CheckInit())
+	std::map<PublishedFileId_t, WorkshopDownload>::iterator it = s_downloads.find(id);
+	if (it == s_downloads.end()) return;
+	WorkshopDownload& d = it->second;
+	
+	if (d.state == kDownloadActive)
 	{
-		return alloc_bool(false);
+		s_downloadActive--;
+		WorkshopDownloadSettle(id, d, result);
 	}
-
-	// Create uint64 from the string.
-	uint64 updateHandle64;
-	std::istringstream handleStream(val_string(updateHandle));
-	if (!(handleStream >> updateHandle64))
+	else if (d.state == kDownloadQueued && result == k_EResultOK)
 	{
-		return alloc_bool(false);
+		//Steam got to it on its own (an auto-update, say), no need to ask again
+		s_downloadQueue.erase(WorkshopDownloadKeyOf(id, d));
+		WorkshopDownloadSettle(id, d, result);
 	}
-
-	bool result = SteamUGC()->SetItemPreview(updateHandle64, val_string(path));
-	return alloc_bool(result);
-}
-DEFINE_PRIM(SteamWrap_SetUGCItemPreviewImage, 2);
-
-//-----------------------------------------------------------------------------------------------------------
-value SteamWrap_CreateUGCItem(value id)
-{
-	if (!val_is_int(id) || !CheckInit())
-		return alloc_bool(false);
-
-	s_callbackHandler->CreateUGCItem(val_int(id), k_EWorkshopFileTypeCommunity);
-
- 	return alloc_bool(true);
 }
-DEFINE_PRIM(SteamWrap_CreateUGCItem, 1);
 
-//-----------------------------------------------------------------------------------------------------------
-int SteamWrap_AddRequiredTag(const char * handle, const char * tagName)
+static void SendWorkshopDownloadProgress()
 {
-	if (!CheckInit()) return 0;
-	
-	UGCQueryHandle_t u64Handle = strtoull(handle, NULL, 0);
+	PackedWriter w;
+	w.u32(0);
+	uint32 count = 0;
+	uint64 downloaded = 0;
+	uint64 total = 0;
+	for (std::map<PublishedFileId_t, WorkshopDownload>::iterator it = s_downloads.begin(); it != s_downloads.end(); ++it)
+	{
+		const WorkshopDownload& d = it->second;
+		w.u64(it->first);
+		w.u8((unsigned char)d.state);
+		w.i32(d.priority);
+		w.u32(d.attempts);
+		w.u64(d.bytesDownloaded);
+		w.u64(d.bytesTotal);
+		downloaded += d.bytesDownloaded;
+		total += d.bytesTotal;
+		count++;
+	}
+	w.setU32(0, count);
 	
-	bool result = SteamUGC()->AddRequiredTag(u64Handle, tagName);
-	return result;
+	value data = alloc_empty_object();
+	alloc_field(data, val_id("bytesDownloaded"), alloc_float((double)downloaded));
+	alloc_field(data, val_id("bytesTotal"), alloc_float((double)total));
+	alloc_field(data, val_id("queued"), alloc_int((int)s_downloadQueue.size()));
+	alloc_field(data, val_id("active"), alloc_int(s_downloadActive));
+	alloc_field(data, val_id("items"), w.toValue());
+	SendEvent(Event(kEventTypeOnWorkshopDownloadProgress, true, data));
 }
-DEFINE_PRIME2(SteamWrap_AddRequiredTag);
 
-//-----------------------------------------------------------------------------------------------------------
-int SteamWrap_AddRequiredKeyValueTag(const char * handle, const char * pKey, const char * pValue)
+static void WorkshopDownloadsUpdate()
 {
-	if (!CheckInit()) return 0;
-	
-	UGCQueryHandle_t u64Handle = strtoull(handle, NULL, 0);
+	if (!s_downloadProgressDirty && s_downloadActive == 0 && s_downloadWaiting == 0 && s_downloadQueue.empty()) return;
+	if (!CheckInit()) return;
 	
-	bool result = SteamUGC()->AddRequiredKeyValueTag(u64Handle, pKey, pValue);
-	return result;
-}
-DEFINE_PRIME3(SteamWrap_AddRequiredKeyValueTag);
-
-//-----------------------------------------------------------------------------------------------------------
-int SteamWrap_AddExcludedTag(const char * handle, const char * tagName)
-{
-	if (!CheckInit()) return 0;
+	double now = NowSeconds();
+	if (s_downloadWaiting > 0)
+	{
+		for (std::map<PublishedFileId_t, WorkshopDownload>::iterator it = s_downloads.begin(); it != s_downloads.end(); ++it)
+		{
+			WorkshopDownload& d = it->second;
+			if (d.state != kDownloadWaitingRetry || d.retryAt > now) continue;
+			d.state = kDownloadQueued;
+			s_downloadWaiting--;
+			s_downloadQueue.insert(WorkshopDownloadKeyOf(it->first, d));
+		}
+	}
 	
-	UGCQueryHandle_t u64Handle = strtoull(handle, NULL, 0);
+	while (s_downloadActive < s_downloadMaxActive && !s_downloadQueue.empty())
+	{
+		PublishedFileId_t id = s_downloadQueue.begin()->id;
+		s_downloadQueue.erase(s_downloadQueue.begin());
+		WorkshopDownloadStart(id, s_downloads[id]);
+	}
 	
-	bool result = SteamUGC()->AddExcludedTag(u64Handle, tagName);
-	return result;
-}
-DEFINE_PRIME2(SteamWrap_AddExcludedTag);
-
-//-----------------------------------------------------------------------------------------------------------
-int SteamWrap_SetReturnMetadata(const char * handle, int returnMetadata)
-{
-	if (!CheckInit()) return 0;
+	if (now < s_downloadNextProgress) return;
+	s_downloadNextProgress = now + s_downloadProgressInterval;
 	
-	UGCQueryHandle_t u64Handle = strtoull(handle, NULL, 0);
+	ISteamUGC* ugc = SteamUGC();
+	for (std::map<PublishedFileId_t, WorkshopDownload>::iterator it = s_downloads.begin(); it != s_downloads.end(); ++it)
+	{
+		WorkshopDownload& d = it->second;
+		if (d.state != kDownloadActive) continue;
+		uint64 downloaded = 0;
+		uint64 total = 0;
+		if (!ugc->GetItemDownloadInfo(it->first, &downloaded, &total)) continue;
+		if (downloaded == d.bytesDownloaded && total == d.bytesTotal) continue;
+		d.bytesDownloaded = downloaded;
+		d.bytesTotal = total;
+		s_downloadProgressDirty = true;
+	}
 	
-	bool result = SteamUGC()->SetReturnMetadata(u64Handle, returnMetadata == 1);
-	return result;
+	if (!s_downloadProgressDirty) return;
+	s_downloadProgressDirty = false;
+	SendWorkshopDownloadProgress();
 }
-DEFINE_PRIME2(SteamWrap_SetReturnMetadata);
 
-//-----------------------------------------------------------------------------------------------------------
-int SteamWrap_SetReturnKeyValueTags(const char * handle, int returnKeyValueTags)
+int SteamWrap_QueueItemDownload(const char * publishedFileID, int priority)
 {
-	if (!CheckInit()) return 0;
+	if (!CheckInit()) return false;
+	PublishedFileId_t id = (PublishedFileId_t) strtoull(publishedFileID, NULL, 10);
+	if (id == 0) return false;
 	
-	UGCQueryHandle_t u64Handle = strtoull(handle, NULL, 0);
-	bool setValue = returnKeyValueTags == 1;
+	std::map<PublishedFileId_t, WorkshopDownload>::iterator it = s_downloads.find(id);
+	if (it == s_downloads.end())
+	{
+		WorkshopDownload& d = s_downloads[id];
+		d.state = kDownloadQueued;
+		d.priority = priority;
+		d.order = s_downloadOrder++;
+		d.attempts = 0;
+		d.retryAt = 0;
+		d.bytesDownloaded = 0;
+		d.bytesTotal = 0;
+		s_downloadQueue.insert(WorkshopDownloadKeyOf(id, d));
+		s_downloadProgressDirty = true;
+		return true;
+	}
 	
-	bool result = SteamUGC()->SetReturnKeyValueTags(u64Handle, setValue);
-	return result;
+	//already pending: just move it in the queue, keeping its place among equal priorities
+	WorkshopDownload& d = it->second;
+	if (d.priority == priority) return true;
+	if (d.state == kDownloadQueued)
+	{
+		s_downloadQueue.erase(WorkshopDownloadKeyOf(id, d));
+		d.priority = priority;
+		s_downloadQueue.insert(WorkshopDownloadKeyOf(id, d));
+	}
+	else
+	{
+		if (d.state == kDownloadActive && priority > 0 && d.priority <= 0) SteamUGC()->DownloadItem(id, true);
+		d.priority = priority;
+	}
+	s_downloadProgressDirty = true;
+	return true;
 }
-DEFINE_PRIME2(SteamWrap_SetReturnKeyValueTags);
+DEFINE_PRIME2(SteamWrap_QueueItemDownload);
 
-#pragma endregion
-
-#pragma region Scores/Achievements
-//-----------------------------------------------------------------------------------------------------------
-value SteamWrap_SetAchievement(value name)
+int SteamWrap_CancelItemDownload(const char * publishedFileID)
 {
-	if (!val_is_string(name) || !CheckInit())
-		return alloc_bool(false);
-
-	SteamUserStats()->SetAchievement(val_string(name));
-	bool result = SteamUserStats()->StoreStats();
-
-	return alloc_bool(result);
+	PublishedFileId_t id = (PublishedFileId_t) strtoull(publishedFileID, NULL, 10);
+	std::map<PublishedFileId_t, WorkshopDownload>::iterator it = s_downloads.find(id);
+	if (it == s_downloads.end()) return false;
+	
+	WorkshopDownload& d = it->second;
+	if (d.state == kDownloadQueued) s_downloadQueue.erase(WorkshopDownloadKeyOf(id, d));
+	else if (d.state == kDownloadActive) s_downloadActive--;
+	else if (d.state == kDownloadWaitingRetry) s_downloadWaiting--;
+	s_downloads.erase(it);
+	s_downloadProgressDirty = true;
+	return true;
 }
-DEFINE_PRIM(SteamWrap_SetAchievement, 1);
+DEFINE_PRIME1(SteamWrap_CancelItemDownload);
 
-value SteamWrap_GetAchievement(value name)
+int SteamWrap_GetItemDownloadState(const char * publishedFileID)
 {
-  if (!val_is_string(name) || !CheckInit()) return alloc_bool(false);
-  bool achieved = false;
-  SteamUserStats()->GetAchievement(val_string(name), &achieved);
-  return alloc_bool(achieved);
+	PublishedFileId_t id = (PublishedFileId_t) strtoull(publishedFileID, NULL, 10);
+	std::map<PublishedFileId_t, WorkshopDownload>::iterator it = s_downloads.find(id);
+	return it == s_downloads.end() ? kDownloadUnknown : it->second.state;
 }
-DEFINE_PRIM(SteamWrap_GetAchievement, 1);
+DEFINE_PRIME1(SteamWrap_GetItemDownloadState);
 
-value SteamWrap_GetAchievementDisplayAttribute(value name, value key)
+void SteamWrap_SetDownloadManagerOptions(int maxActive, int maxAttempts, float retryDelay, float progressInterval)
 {
-  if (!val_is_string(name) || !val_is_string(key) || !CheckInit()) return alloc_string("");
-  
-  const char* result = SteamUserStats()->GetAchievementDisplayAttribute(val_string(name), val_string(key));
-  return alloc_string(result);
+	s_downloadMaxActive = maxActive < 1 ? 1 : maxActive;
+	s_downloadMaxAttempts = maxAttempts < 1 ? 1 : maxAttempts;
+	s_downloadRetryDelay = retryDelay < 0 ? 0 : retryDelay;
+	s_downloadProgressInterval = progressInterval < 0 ? 0 : progressInterval;
 }
-DEFINE_PRIM(SteamWrap_GetAchievementDisplayAttribute, 2);
+DEFINE_PRIME4v(SteamWrap_SetDownloadManagerOptions);
 
-value SteamWrap_GetNumAchievements()
-{
-  if (!CheckInit()) return alloc_int(0);
-  
-  uint32 count = SteamUserStats()->GetNumAchievements();
-  return alloc_int((int)count);
-}
-DEFINE_PRIM(SteamWrap_GetNumAchievements, 0);
+//-----------------------------------------------------------------------------------------------------------
+// Content index: path, size, mtime and content hash of every file in installed items' folders, persisted between
+// runs. Items whose install folder and timestamp haven't changed are skipped without touching the disk; the rest
+// are walked on a pool of worker threads, and only files whose size or mtime changed are hashed again.
 
-value SteamWrap_GetAchievementName(value index)
+struct IndexedFile
 {
-  if (!val_is_int(index) && !CheckInit()) return alloc_string("");
-  const char* name = SteamUserStats()->GetAchievementName(val_int(index));
-  return alloc_string(name);
-}
-DEFINE_PRIM(SteamWrap_GetAchievementName, 1);
+	std::string path;	//relative to the install folder, '/'-separated
+	uint64 size;
+	uint64 mtime;		//as the platform reports it: seconds on posix, FILETIME on Windows
+	uint64 hash;
+};
 
-//-----------------------------------------------------------------------------------------------------------
-value SteamWrap_ClearAchievement(value name)
+struct IndexedItem
 {
-	if (!val_is_string(name) || !CheckInit())
-		return alloc_bool(false);
+	uint32 timeStamp;
+	std::string folder;
+	std::vector<IndexedFile> files;
+};
 
-	SteamUserStats()->ClearAchievement(val_string(name));
-	bool result = SteamUserStats()->StoreStats();
+static const char kWorkshopIndexMagic[4] = { 'S', 'W', 'I', '1' };
+static const size_t kWorkshopIndexHashBlock = 1 << 20;
 
-	return alloc_bool(result);
-}
-DEFINE_PRIM(SteamWrap_ClearAchievement, 1);
+static std::map<PublishedFileId_t, IndexedItem> s_workshopIndex;
+static std::string s_workshopIndexPath;
 
-//-----------------------------------------------------------------------------------------------------------
-value SteamWrap_IndicateAchievementProgress(value name, value numCurProgres, value numMaxProgress)
+struct WorkshopIndexTask
 {
-	if (!val_is_string(name) || !val_is_int(numCurProgres) || !val_is_int(numMaxProgress) || !CheckInit())
-		return alloc_bool(false);
-
-	bool result = SteamUserStats()->IndicateAchievementProgress(val_string(name), val_int(numCurProgres), val_int(numMaxProgress));
-
-	return alloc_bool(result);
-}
-DEFINE_PRIM(SteamWrap_IndicateAchievementProgress, 3);
+	PublishedFileId_t id;
+	bool installed;
+	bool walk;			//false if the install timestamp says nothing changed
+	bool ok;
+	uint32 hashed;
+	IndexedItem previous;
+	IndexedItem result;
+};
 
-//-----------------------------------------------------------------------------------------------------------
-value SteamWrap_FindLeaderboard(value name)
+struct WorkshopIndexJob
 {
-	if (!val_is_string(name) || !CheckInit())
-		return alloc_bool(false);
+	int id;
+	std::vector<WorkshopIndexTask> tasks;
+	std::atomic<size_t> next;
+	std::atomic<int> running;
+	std::atomic<bool> cancel;
+	std::vector<std::thread> workers;
+};
 
-	s_callbackHandler->FindLeaderboard(val_string(name));
+static std::map<int, std::unique_ptr<WorkshopIndexJob> > s_workshopIndexJobs;
+static int s_workshopIndexCounter = 0;
 
- 	return alloc_bool(true);
+//Subfolders that can't be opened are skipped; only a missing root is an error
+#ifdef _WIN32
+static bool WorkshopIndexList(const std::string& root, const std::string& rel, std::vector<IndexedFile>& out)
+{
+	std::string pattern = root + "/" + (rel.empty() ? "" : rel + "/") + "*";
+	WIN32_FIND_DATAA fd;
+	HANDLE find = FindFirstFileA(pattern.c_str(), &fd);
+	if (find == INVALID_HANDLE_VALUE) return false;
+	do
+	{
+		if (strcmp(fd.cFileName, ".") == 0 || strcmp(fd.cFileName, "..") == 0) continue;
+		std::string path = rel.empty() ? std::string(fd.cFileName) : rel + "/" + fd.cFileName;
+		if (fd.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) continue;
+		if (fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+		{
+			WorkshopIndexList(root, path, out);
+			continue;
+		}
+		IndexedFile f;
+		f.path = path;
+		f.size = ((uint64)fd.nFileSizeHigh << 32) | fd.nFileSizeLow;
+		f.mtime = ((uint64)fd.ftLastWriteTime.dwHighDateTime << 32) | fd.ftLastWriteTime.dwLowDateTime;
+		f.hash = 0;
+		out.push_back(f);
+	} while (FindNextFileA(find, &fd));
+	FindClose(find);
+	return true;
 }
-DEFINE_PRIM(SteamWrap_FindLeaderboard, 1);
-
-//-----------------------------------------------------------------------------------------------------------
-value SteamWrap_UploadScore(value name, value score, value detail)
+#else
+static bool WorkshopIndexList(const std::string& root, const std::string& rel, std::vector<IndexedFile>& out)
 {
-	if (!val_is_string(name) || !val_is_int(score) || !val_is_int(detail) || !CheckInit())
-		return alloc_bool(false);
-
-	bool result = s_callbackHandler->UploadScore(val_string(name), val_int(score), val_int(detail));
-	return alloc_bool(result);
+	std::string dirPath = rel.empty() ? root : root + "/" + rel;
+	DIR* dir = opendir(dirPath.c_str());
+	if (dir == NULL) return false;
+	struct dirent* entry;
+	while ((entry = readdir(dir)) != NULL)
+	{
+		if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+		std::string path = rel.empty() ? std::string(entry->d_name) : rel + "/" + entry->d_name;
+		struct stat st;
+		if (lstat((root + "/" + path).c_str(), &st) != 0) continue;
+		if (S_ISDIR(st.st_mode))
+		{
+			WorkshopIndexList(root, path, out);
+			continue;
+		}
+		if (!S_ISREG(st.st_mode)) continue;
+		IndexedFile f;
+		f.path = path;
+		f.size = (uint64)st.st_size;
+		f.mtime = (uint64)st.st_mtime;
+		f.hash = 0;
+		out.push_back(f);
+	}
+	closedir(dir);
+	return true;
 }
-DEFINE_PRIM(SteamWrap_UploadScore, 3);
+#endif
 
-//-----------------------------------------------------------------------------------------------------------
-value SteamWrap_DownloadScores(value name, value downloadType, value numBefore, value numAfter)
+//xxh64 chained over fixed-size blocks (each block seeded with the hash so far), so any file hashes in constant memory
+static bool WorkshopIndexHashFile(const std::string& path, std::vector<unsigned char>& buffer, uint64& hash)
 {
-	if (!val_is_string(name) || !val_is_int(downloadType) || !val_is_int(numBefore) || !val_is_int(numAfter) || !CheckInit())
-		return alloc_bool(false);
-
-	bool result = s_callbackHandler->DownloadScores(val_string(name), val_int(downloadType), val_int(numBefore), val_int(numAfter));
-	return alloc_bool(result);
+	FILE* f = fopen(path.c_str(), "rb");
+	if (f == NULL) return false;
+	hash = 0;
+	size_t n;
+	bool any = false;
+	while ((n = fread(buffer.data(), 1, buffer.size(), f)) > 0)
+	{
+		hash = xxh64(buffer.data(), n, hash);
+		any = true;
+	}
+	bool failed = ferror(f) != 0;
+	fclose(f);
+	if (!any) hash = xxh64(NULL, 0, 0);
+	return !failed;
 }
-DEFINE_PRIM(SteamWrap_DownloadScores, 4);
 
-//-----------------------------------------------------------------------------------------------------------
-value SteamWrap_RequestGlobalStats()
+inline bool IndexedFileLess(const IndexedFile& a, const IndexedFile& b)
 {
-	if (!CheckInit())
-		return alloc_bool(false);
-
-	s_callbackHandler->RequestGlobalStats();
-	return alloc_bool(true);
+	return a.path < b.path;
 }
-DEFINE_PRIM(SteamWrap_RequestGlobalStats, 0);
 
-//-----------------------------------------------------------------------------------------------------------
-value SteamWrap_GetGlobalStat(value name)
+static void WorkshopIndexWalk(WorkshopIndexTask& t, std::vector<unsigned char>& buffer, const std::atomic<bool>& cancel)
 {
-	if (!val_is_string(name) || !CheckInit())
-		return alloc_int(0);
-
-	int64 val;
-	SteamUserStats()->GetGlobalStat(val_string(name), &val);
+	std::vector<IndexedFile>& files = t.result.files;
+	if (!WorkshopIndexList(t.result.folder, "", files)) return;
+	std::sort(files.begin(), files.end(), IndexedFileLess);
+	
+	//both lists are sorted by path, so matching them up is a single merge pass
+	static const std::vector<IndexedFile> kNothing;
+	const std::vector<IndexedFile>& before = t.previous.folder == t.result.folder ? t.previous.files : kNothing;
+	size_t j = 0;
+	for (size_t i = 0; i < files.size(); i++)
+	{
+		if (cancel) return;
+		IndexedFile& f = files[i];
+		while (j < before.size() && before[j].path < f.path) j++;
+		if (j < before.size() && before[j].path == f.path && before[j].size == f.size && before[j].mtime == f.mtime)
+		{
+			f.hash = before[j].hash;
+			continue;
+		}
+		if (!WorkshopIndexHashFile(t.result.folder + "/" + f.path, buffer, f.hash)) return;
+		t.hashed++;
+	}
+	t.ok = true;
+}
 
-	return alloc_int((int)val);
+static void WorkshopIndexWorker(WorkshopIndexJob* job)
+{
+	std::vector<unsigned char> buffer(kWorkshopIndexHashBlock);
+	while (!job->cancel)
+	{
+		size_t i = job->next++;
+		if (i >= job->tasks.size()) break;
+		if (job->tasks[i].walk) WorkshopIndexWalk(job->tasks[i], buffer, job->cancel);
+	}
+	job->running--;
 }
-DEFINE_PRIM(SteamWrap_GetGlobalStat, 1);
 
-//-----------------------------------------------------------------------------------------------------------
-value SteamWrap_GetPersonaName()
+static void WorkshopIndexSave()
 {
-	if(!CheckInit())
-		return alloc_string("unknown");
+	if (s_workshopIndexPath.empty()) return;
 	
-	const char * persona = SteamFriends()->GetPersonaName();
+	PackedWriter w;
+	w.raw(kWorkshopIndexMagic, 4);
+	w.u32((uint32)s_workshopIndex.size());
+	for (std::map<PublishedFileId_t, IndexedItem>::iterator it = s_workshopIndex.begin(); it != s_workshopIndex.end(); ++it)
+	{
+		const IndexedItem& item = it->second;
+		w.u64(it->first);
+		w.u32(item.timeStamp);
+		w.str(item.folder);
+		w.u32((uint32)item.files.size());
+		for (size_t i = 0; i < item.files.size(); i++)
+		{
+			const IndexedFile& f = item.files[i];
+			w.str(f.path);
+			w.u64(f.size);
+			w.u64(f.mtime);
+			w.u64(f.hash);
+		}
+	}
 	
-	return alloc_string(persona);
+	std::string temp = s_workshopIndexPath + ".tmp";
+	FILE* f = fopen(temp.c_str(), "wb");
+	if (f == NULL) return;
+	bool written = fwrite(w.data.data(), 1, w.data.size(), f) == w.data.size();
+	fclose(f);
+	if (!written)
+	{
+		remove(temp.c_str());
+		return;
+	}
+	remove(s_workshopIndexPath.c_str());
+	rename(temp.c_str(), s_workshopIndexPath.c_str());
 }
-DEFINE_PRIM(SteamWrap_GetPersonaName, 0);
 
-//-----------------------------------------------------------------------------------------------------------
-value SteamWrap_BIsAppInstalled(value appID)
+//Items up to a torn one are kept
+static int WorkshopIndexLoad(const char* path)
 {
-	if(!val_is_int(appID) || !CheckInit()) return alloc_bool(false);
-	bool result = SteamApps()->BIsAppInstalled(val_int(appID));
-	return alloc_bool(result);
+	s_workshopIndexPath = path;
+	s_workshopIndex.clear();
+	
+	FILE* f = fopen(path, "rb");
+	if (f == NULL) return 0;
+	std::vector<unsigned char> data;
+	unsigned char chunk[65536];
+	size_t n;
+	while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0) data.insert(data.end(), chunk, chunk + n);
+	fclose(f);
+	
+	if (data.size() < 8 || memcmp(data.data(), kWorkshopIndexMagic, 4) != 0) return 0;
+	PackedParser r(data.data() + 4, data.size() - 4);
+	uint32 count = r.u32();
+	for (uint32 i = 0; i < count && r.ok; i++)
+	{
+		PublishedFileId_t id = r.u64();
+		IndexedItem item;
+		item.timeStamp = r.u32();
+		item.folder = r.str();
+		uint32 fileCount = r.u32();
+		for (uint32 k = 0; k < fileCount && r.ok; k++)
+		{
+			IndexedFile file;
+			file.path = r.str();
+			file.size = r.u64();
+			file.mtime = r.u64();
+			file.hash = r.u64();
+			item.files.push_back(file);
+		}
+		if (!r.ok) break;
+		std::swap(s_workshopIndex[id], item);
+	}
+	return (int)s_workshopIndex.size();
 }
-DEFINE_PRIM(SteamWrap_BIsAppInstalled, 1);
 
-//-----------------------------------------------------------------------------------------------------------
-value SteamWrap_BIsDlcInstalled(value appID)
+static void PackIndexedItem(PackedWriter& w, PublishedFileId_t id, bool walked, const IndexedItem& item)
 {
-	if(!val_is_int(appID) || !CheckInit()) return alloc_bool(false);
-	bool result = SteamApps()->BIsDlcInstalled(val_int(appID));
-	return alloc_bool(result);
+	w.u64(id);
+	w.u8(walked ? 1 : 0);
+	w.u32(item.timeStamp);
+	w.str(item.folder);
+	w.u32((uint32)item.files.size());
+	for (size_t i = 0; i < item.files.size(); i++)
+	{
+		const IndexedFile& f = item.files[i];
+		w.str(f.path);
+		w.u64(f.size);
+		w.u64(f.mtime);
+		w.u64(f.hash);
+	}
 }
-DEFINE_PRIM(SteamWrap_BIsDlcInstalled, 1);
 
-//-----------------------------------------------------------------------------------------------------------
-value SteamWrap_GetSteamID()
+static void WorkshopIndexFinish(WorkshopIndexJob& job)
 {
-	if(!CheckInit())
-		return alloc_string("0");
-	
-	CSteamID userId = SteamUser()->GetSteamID();
-	
-	std::ostringstream returnData;
-	returnData << userId.ConvertToUint64();
+	PackedWriter w;
+	w.u32(0);
+	uint32 packed = 0;
+	int walked = 0;
+	int hashed = 0;
+	int failed = 0;
+	bool changed = false;
+	for (size_t i = 0; i < job.tasks.size(); i++)
+	{
+		WorkshopIndexTask& t = job.tasks[i];
+		if (!t.installed)
+		{
+			if (s_workshopIndex.erase(t.id) > 0) changed = true;
+			continue;
+		}
+		if (t.walk)
+		{
+			if (!t.ok)
+			{
+				failed++;
+				continue;
+			}
+			walked++;
+			hashed += t.hashed;
+			s_workshopIndex[t.id] = t.result;
+			changed = true;
+		}
+		PackIndexedItem(w, t.id, t.walk, t.walk ? t.result : t.previous);
+		packed++;
+	}
+	w.setU32(0, packed);
+	if (changed) WorkshopIndexSave();
 	
-	return alloc_string(returnData.str().c_str());
+	value data = alloc_empty_object();
+	alloc_field(data, val_id("request"), alloc_int(job.id));
+	alloc_field(data, val_id("walked"), alloc_int(walked));
+	alloc_field(data, val_id("hashed"), alloc_int(hashed));
+	alloc_field(data, val_id("failed"), alloc_int(failed));
+	alloc_field(data, val_id("items"), w.toValue());
+	SendEvent(Event(kEventTypeOnWorkshopIndexed, failed == 0, data));
 }
-DEFINE_PRIM(SteamWrap_GetSteamID, 0);
 
-//-----------------------------------------------------------------------------------------------------------
-value SteamWrap_RestartAppIfNecessary(value appId)
+static void WorkshopIndexUpdate()
 {
-	if (!val_is_int(appId))
-		return alloc_bool(false);
-
-	bool result = SteamAPI_RestartAppIfNecessary(val_int(appId));
-	return alloc_bool(result);
+	std::map<int, std::unique_ptr<WorkshopIndexJob> >::iterator it = s_workshopIndexJobs.begin();
+	while (it != s_workshopIndexJobs.end())
+	{
+		WorkshopIndexJob& job = *it->second;
+		if (job.running > 0)
+		{
+			++it;
+			continue;
+		}
+		for (size_t t = 0; t < job.workers.size(); t++) job.workers[t].join();
+		WorkshopIndexFinish(job);
+		s_workshopIndexJobs.erase(it++);
+	}
 }
-DEFINE_PRIM(SteamWrap_RestartAppIfNecessary, 1);
 
-//-----------------------------------------------------------------------------------------------------------
-value SteamWrap_IsOverlayEnabled()
+static void WorkshopIndexReset()
 {
-	bool result = SteamUtils()->IsOverlayEnabled();
-	return alloc_bool(result);
+	std::map<int, std::unique_ptr<WorkshopIndexJob> >::iterator it;
+	for (it = s_workshopIndexJobs.begin(); it != s_workshopIndexJobs.end(); ++it) it->second->cancel = true;
+	for (it = s_workshopIndexJobs.begin(); it != s_workshopIndexJobs.end(); ++it)
+	{
+		for (size_t t = 0; t < it->second->workers.size(); t++) it->second->workers[t].join();
+	}
+	s_workshopIndexJobs.clear();
 }
-DEFINE_PRIM(SteamWrap_IsOverlayEnabled, 0);
 
 //-----------------------------------------------------------------------------------------------------------
-value SteamWrap_BOverlayNeedsPresent()
+//Loads the content index from path (and saves it there from now on). Returns how many items it holds.
+int SteamWrap_SetWorkshopIndexPath(const char * path)
 {
-	bool result = SteamUtils()->BOverlayNeedsPresent();
-	return alloc_bool(result);
+	return WorkshopIndexLoad(path);
 }
-DEFINE_PRIM(SteamWrap_BOverlayNeedsPresent, 0);
+DEFINE_PRIME1(SteamWrap_SetWorkshopIndexPath);
 
 //-----------------------------------------------------------------------------------------------------------
-value SteamWrap_IsSteamInBigPictureMode()
-{
-	bool result = SteamUtils()->IsSteamInBigPictureMode();
-	return alloc_bool(result);
+//Brings the content index of a comma-separated list of ids up to date on up to `threads` worker threads (0 = one
+//per core). Returns the request id; WorkshopIndexed carries the index of every installed item once done.
+value SteamWrap_IndexWorkshopItems(value fileIDs, value threads)
+{
+	if (!val_is_string(fileIDs) || !val_is_int(threads) || !CheckInit())
+		return alloc_int(-1);
+	
+	uint32 count = 0;
+	PublishedFileId_t* ids = getUint64Array(val_string(fileIDs), &count);
+	
+	WorkshopIndexJob* job = new WorkshopIndexJob();
+	job->id = ++s_workshopIndexCounter;
+	job->next = 0;
+	job->running = 0;
+	job->cancel = false;
+	job->tasks.resize(count);
+	
+	static char folder[kWorkshopFolderMax];
+	uint32 toWalk = 0;
+	for (uint32 i = 0; i < count; i++)
+	{
+		WorkshopIndexTask& t = job->tasks[i];
+		t.id = ids[i];
+		t.walk = false;
+		t.ok = false;
+		t.hashed = 0;
+		
+		uint64 sizeOnDisk = 0;
+		uint32 timeStamp = 0;
+		folder[0] = 0;
+		t.installed = (SteamUGC()->GetItemState(t.id) & k_EItemStateInstalled) &&
+			SteamUGC()->GetItemInstallInfo(t.id, &sizeOnDisk, folder, kWorkshopFolderMax, &timeStamp);
+		if (!t.installed) continue;
+		folder[kWorkshopFolderMax - 1] = 0;
+		
+		std::map<PublishedFileId_t, IndexedItem>::iterator it = s_workshopIndex.find(t.id);
+		if (it != s_workshopIndex.end()) t.previous = it->second;
+		if (it != s_workshopIndex.end() && it->second.timeStamp == timeStamp && it->second.folder == folder) continue;
+		
+		t.walk = true;
+		t.result.timeStamp = timeStamp;
+		t.result.folder = folder;
+		toWalk++;
+	}
+	delete[] ids;
+	
+	int workers = val_int(threads) > 0 ? val_int(threads) : (int)std::thread::hardware_concurrency();
+	if (workers < 1) workers = 1;
+	if (workers > (int)toWalk) workers = (int)toWalk;
+	
+	//with nothing to walk there are no workers, and the job is finished from the next RunCallbacks
+	s_workshopIndexJobs[job->id].reset(job);
+	job->running = workers;
+	for (int i = 0; i < workers; i++) job->workers.push_back(std::thread(WorkshopIndexWorker, job));
+	return alloc_int(job->id);
 }
-DEFINE_PRIM(SteamWrap_IsSteamInBigPictureMode, 0);
+DEFINE_PRIM(SteamWrap_IndexWorkshopItems, 2);
 
 //-----------------------------------------------------------------------------------------------------------
-value SteamWrap_IsSteamRunning()
+// Mapped files: read-only memory maps of files inside an item's install folder, so large assets are paged in
+// lazily as slices are read rather than loaded whole. Each map has a handle, and every map of an item is released
+// as soon as Steam may start replacing or removing its files: when a download of it is started here, when the
+// item is seen needing an update, downloading or no longer installed (polled about once a second), when it's
+// unsubscribed, and on DownloadItemResult/ItemInstalled. Windows can't replace a file that is still mapped.
+
+struct WorkshopMappedFile
+{
+	PublishedFileId_t item;
+	const unsigned char* data;
+	uint64 size;
+#ifdef _WIN32
+	HANDLE mapping;
+#endif
+};
+
+static std::map<int, WorkshopMappedFile> s_workshopMappedFiles;
+static int s_workshopMappedCounter = 0;
+static double s_workshopMappedNextCheck = 0;
+static const double kWorkshopMappedCheckInterval = 1.0;
+
+#ifdef _WIN32
+static bool WorkshopMapFile(const std::string& path, WorkshopMappedFile& m)
 {
-	bool result = SteamAPI_IsSteamRunning();
-	return alloc_bool(result);
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE) return false;
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size))
+	{
+		CloseHandle(file);
+		return false;
+	}
+	m.size = (uint64)size.QuadPart;
+	m.data = NULL;
+	m.mapping = NULL;
+	if (m.size > 0)
+	{
+		//the mapping keeps the file open on its own
+		m.mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (m.mapping != NULL) m.data = (const unsigned char*)MapViewOfFile(m.mapping, FILE_MAP_READ, 0, 0, 0);
+	}
+	CloseHandle(file);
+	if (m.size > 0 && m.data == NULL)
+	{
+		if (m.mapping != NULL) CloseHandle(m.mapping);
+		return false;
+	}
+	return true;
 }
-DEFINE_PRIM(SteamWrap_IsSteamRunning, 0);
 
-//-----------------------------------------------------------------------------------------------------------
-value SteamWrap_GetCurrentGameLanguage()
+static void WorkshopUnmapFile(WorkshopMappedFile& m)
 {
-	const char* result = SteamApps()->GetCurrentGameLanguage();
-	return alloc_string(result);
+	if (m.data != NULL) UnmapViewOfFile(m.data);
+	if (m.mapping != NULL) CloseHandle(m.mapping);
+}
+#else
+static bool WorkshopMapFile(const std::string& path, WorkshopMappedFile& m)
+{
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0) return false;
+	struct stat st;
+	if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+	{
+		close(fd);
+		return false;
+	}
+	m.size = (uint64)st.st_size;
+	m.data = NULL;
+	if (m.size > 0)
+	{
+		void* view = mmap(NULL, (size_t)m.size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (view != MAP_FAILED) m.data = (const unsigned char*)view;
+	}
+	close(fd);
+	return m.size == 0 || m.data != NULL;
 }
-DEFINE_PRIM(SteamWrap_GetCurrentGameLanguage, 0);
 
-//-----------------------------------------------------------------------------------------------------------
+static void WorkshopUnmapFile(WorkshopMappedFile& m)
+{
+	if (m.data != NULL) munmap((void*)m.data, (size_t)m.size);
+}
+#endif
 
-#pragma endregion
+//Relative paths only, and none that climb out of the install folder
+static bool WorkshopRelativePathSafe(const std::string& path)
+{
+	if (path.empty() || path[0] == '/' || path[0] == '\\' || path.find(':') != std::string::npos) return false;
+	size_t start = 0;
+	while (start <= path.size())
+	{
+		size_t end = path.find_first_of("/\\", start);
+		if (end == std::string::npos) end = path.size();
+		if (path.compare(start, end - start, "..") == 0) return false;
+		start = end + 1;
+	}
+	return true;
+}
 
-#pragma region New Workshop
-//NEW STEAM WORKSHOP---------------------------------------------------------------------------------------------
+inline WorkshopMappedFile* WorkshopMappedFileGet(int handle)
+{
+	std::map<int, WorkshopMappedFile>::iterator it = s_workshopMappedFiles.find(handle);
+	return it == s_workshopMappedFiles.end() ? NULL : &it->second;
+}
 
-int SteamWrap_GetNumSubscribedItems(int dummy)
+//Clamps a slice to the file; false if it starts past the end
+static bool WorkshopMappedSlice(const WorkshopMappedFile& m, double offset, int& length)
 {
-	if (!CheckInit()) return 0;
-	int numItems = SteamUGC()->GetNumSubscribedItems();
-	return numItems;
+	if (offset < 0 || length < 0 || offset > (double)m.size) return false;
+	uint64 start = (uint64)offset;
+	if ((uint64)length > m.size - start) length = (int)(m.size - start);
+	return true;
 }
-DEFINE_PRIME1(SteamWrap_GetNumSubscribedItems);
 
-value SteamWrap_GetSubscribedItems()
+static void WorkshopMappedFilesRelease(PublishedFileId_t item)
 {
-	if (!CheckInit()) return alloc_string("");
-	
-	int numSubscribed = SteamUGC()->GetNumSubscribedItems();
-	if(numSubscribed <= 0) return alloc_string("");
-	PublishedFileId_t* pvecPublishedFileID = new PublishedFileId_t[numSubscribed];
-	
-	int result = SteamUGC()->GetSubscribedItems(pvecPublishedFileID, numSubscribed);
-	
-	std::ostringstream data;
-	for(int i = 0; i < result; i++){
-		if(i != 0){
-			data << ",";
+	PackedWriter w;
+	w.u32(0);
+	uint32 released = 0;
+	std::map<int, WorkshopMappedFile>::iterator it = s_workshopMappedFiles.begin();
+	while (it != s_workshopMappedFiles.end())
+	{
+		if (it->second.item != item)
+		{
+			++it;
+			continue;
 		}
-		data << pvecPublishedFileID[i];
+		WorkshopUnmapFile(it->second);
+		w.i32(it->first);
+		released++;
+		s_workshopMappedFiles.erase(it++);
 	}
-	delete pvecPublishedFileID;
+	if (released == 0) return;
+	w.setU32(0, released);
 	
-	return alloc_string(data.str().c_str());
+	value data = alloc_empty_object();
+	alloc_field(data, val_id("id"), u64_to_hx(item));
+	alloc_field(data, val_id("handles"), w.toValue());
+	SendEvent(Event(kEventTypeOnWorkshopFilesUnmapped, true, data));
 }
-DEFINE_PRIM(SteamWrap_GetSubscribedItems, 0);
 
-int SteamWrap_GetItemState(const char * publishedFileID)
+//Steam starts auto-updates on its own, so the items with maps are checked every so often
+static void WorkshopMappedFilesUpdate()
 {
-	if (!CheckInit()) return 0;
-	PublishedFileId_t nPublishedFileID = (PublishedFileId_t) strtoll(publishedFileID, NULL, 10);
-	return SteamUGC()->GetItemState(nPublishedFileID);
+	if (s_workshopMappedFiles.empty()) return;
+	double now = NowSeconds();
+	if (now < s_workshopMappedNextCheck || !CheckInit()) return;
+	s_workshopMappedNextCheck = now + kWorkshopMappedCheckInterval;
+	
+	std::set<PublishedFileId_t> items;
+	for (std::map<int, WorkshopMappedFile>::iterator it = s_workshopMappedFiles.begin(); it != s_workshopMappedFiles.end(); ++it)
+	{
+		items.insert(it->second.item);
+	}
+	for (std::set<PublishedFileId_t>::iterator it = items.begin(); it != items.end(); ++it)
+	{
+		uint32 state = SteamUGC()->GetItemState(*it);
+		if (!(state & k_EItemStateInstalled) || (state & (k_EItemStateNeedsUpdate | k_EItemStateDownloading | k_EItemStateDownloadPending)))
+			WorkshopMappedFilesRelease(*it);
+	}
 }
-DEFINE_PRIME1(SteamWrap_GetItemState);
 
-value SteamWrap_GetItemDownloadInfo(value publishedFileID)
+static void WorkshopMappedFilesReset()
 {
-	if (!CheckInit()) return alloc_string("");
-	if (!val_is_string(publishedFileID)) return alloc_string("");
-	
-	PublishedFileId_t nPublishedFileID = (PublishedFileId_t) strtoll(val_string(publishedFileID), NULL, 10);
-	
-	uint64 punBytesDownloaded;
-	uint64 punBytesTotal;
-	
-	bool result = SteamUGC()->GetItemDownloadInfo(nPublishedFileID, &punBytesDownloaded, &punBytesTotal);
-	
-	if(result){
-		std::ostringstream data;
-		data << punBytesDownloaded;
-		data << ",";
-		data << punBytesTotal;
-		return alloc_string(data.str().c_str());
+	for (std::map<int, WorkshopMappedFile>::iterator it = s_workshopMappedFiles.begin(); it != s_workshopMappedFiles.end(); ++it)
+	{
+		WorkshopUnmapFile(it->second);
 	}
-	
-	return alloc_string("0,0");
+	s_workshopMappedFiles.clear();
 }
-DEFINE_PRIM(SteamWrap_GetItemDownloadInfo, 1);
 
-int SteamWrap_DownloadItem(const char * publishedFileID, int highPriority)
-{
-	if (!CheckInit()) return false;
-	PublishedFileId_t nPublishedFileID = (PublishedFileId_t) strtoll(publishedFileID, NULL, 10);
-	
-	bool bHighPriority = highPriority == 1;
-	bool result = SteamUGC()->DownloadItem(nPublishedFileID, bHighPriority);
-	return result;
+//-----------------------------------------------------------------------------------------------------------
+//Maps a file inside an installed item's folder; path is relative to the folder. Returns the handle, or -1.
+int SteamWrap_MapWorkshopFile(const char * publishedFileID, const char * path)
+{
+	if (!CheckInit() || path == NULL || !WorkshopRelativePathSafe(path)) return -1;
+	PublishedFileId_t id = (PublishedFileId_t) strtoull(publishedFileID, NULL, 10);
+	
+	static char folder[kWorkshopFolderMax];
+	uint64 sizeOnDisk = 0;
+	uint32 timeStamp = 0;
+	if (!(SteamUGC()->GetItemState(id) & k_EItemStateInstalled)) return -1;
+	if (!SteamUGC()->GetItemInstallInfo(id, &sizeOnDisk, folder, kWorkshopFolderMax, &timeStamp)) return -1;
+	folder[kWorkshopFolderMax - 1] = 0;
+	
+	WorkshopMappedFile m;
+	m.item = id;
+	if (!WorkshopMapFile(std::string(folder) + "/" + path, m)) return -1;
+	int handle = ++s_workshopMappedCounter;
+	s_workshopMappedFiles[handle] = m;
+	return handle;
 }
-DEFINE_PRIME2(SteamWrap_DownloadItem);
+DEFINE_PRIME2(SteamWrap_MapWorkshopFile);
 
-value SteamWrap_GetItemInstallInfo(value publishedFileID, value maxFolderPathLength)
+void SteamWrap_UnmapWorkshopFile(int handle)
 {
-	if (!CheckInit()) return alloc_string("");
-	if (!val_is_string(publishedFileID)) return alloc_string("");
-	if (!val_is_int(maxFolderPathLength)) return alloc_string("");
-	
-	PublishedFileId_t nPublishedFileID = (PublishedFileId_t) strtoll(val_string(publishedFileID), NULL, 10);
-	
-	uint64 punSizeOnDisk;
-	uint32 punTimeStamp;
-	uint32 cchFolderSize = (uint32) val_int(maxFolderPathLength);
-	char * pchFolder = new char[cchFolderSize];
-	
-	bool result = SteamUGC()->GetItemInstallInfo(nPublishedFileID, &punSizeOnDisk, pchFolder, cchFolderSize, &punTimeStamp);
-	
-	if(result){
-		std::ostringstream data;
-		data << punSizeOnDisk;
-		data << "|";
-		data << pchFolder;
-		data << "|";
-		data << cchFolderSize;
-		data << "|";
-		data << punTimeStamp;
-		return alloc_string(data.str().c_str());
-	}
-	
-	return alloc_string("0||0|");
+	std::map<int, WorkshopMappedFile>::iterator it = s_workshopMappedFiles.find(handle);
+	if (it == s_workshopMappedFiles.end()) return;
+	WorkshopUnmapFile(it->second);
+	s_workshopMappedFiles.erase(it);
+}
+DEFINE_PRIME1v(SteamWrap_UnmapWorkshopFile);
+
+//-----------------------------------------------------------------------------------------------------------
+//Size of a mapped file in bytes, or -1 if the handle isn't mapped
+value SteamWrap_GetMappedFileSize(value handle)
+{
+	if (!val_is_int(handle)) return alloc_float(-1);
+	WorkshopMappedFile* m = WorkshopMappedFileGet(val_int(handle));
+	return alloc_float(m == NULL ? -1 : (double)m->size);
 }
-DEFINE_PRIM(SteamWrap_GetItemInstallInfo, 2);
+DEFINE_PRIM(SteamWrap_GetMappedFileSize, 1);
+
+//-----------------------------------------------------------------------------------------------------------
+//Copies up to length bytes from offset into new bytes; null if the handle isn't mapped or offset is past the end
+value SteamWrap_ReadMappedFile(value handle, value offset, value length)
+{
+	if (!val_is_int(handle) || !val_is_number(offset) || !val_is_int(length)) return alloc_null();
+	WorkshopMappedFile* m = WorkshopMappedFileGet(val_int(handle));
+	int count = val_int(length);
+	if (m == NULL || !WorkshopMappedSlice(*m, val_number(offset), count)) return alloc_null();
+	if (count == 0) return buffer_val(alloc_buffer_len(0));
+	return bytes_to_hx(m->data + (uint64)val_number(offset), count);
+}
+DEFINE_PRIM(SteamWrap_ReadMappedFile, 3);
+
+//-----------------------------------------------------------------------------------------------------------
+//Copies up to length bytes from offset into haxeBytes at pos, so one buffer can be reused for every read.
+//Returns how many bytes were copied, or -1.
+value SteamWrap_ReadMappedFileInto(value handle, value offset, value length, value haxeBytes, value pos)
+{
+	if (!val_is_int(handle) || !val_is_number(offset) || !val_is_int(length) || !val_is_int(pos)) return alloc_int(-1);
+	WorkshopMappedFile* m = WorkshopMappedFileGet(val_int(handle));
+	CffiBytes bytes = getByteData(haxeBytes);
+	int start = val_int(pos);
+	int count = val_int(length);
+	if (m == NULL || bytes.data == 0 || start < 0 || start > bytes.length) return alloc_int(-1);
+	if (count > bytes.length - start) count = bytes.length - start;
+	if (!WorkshopMappedSlice(*m, val_number(offset), count)) return alloc_int(-1);
+	if (count > 0) memcpy(bytes.data + start, m->data + (uint64)val_number(offset), count);
+	return alloc_int(count);
+}
+DEFINE_PRIM(SteamWrap_ReadMappedFileInto, 5);
 
 /*
 value SteamWrap_CreateQueryUserUGCRequest(value accountID, value listType, value matchingUGCType, value sortOrder, value creatorAppID, value consumerAppID, value page)
@@ -1737,6 +6484,7 @@ value SteamWrap_CreateQueryUGCDetailsRequest(value fileIDs)
 	PublishedFileId_t * pvecPublishedFileID = getUint64Array(val_string(fileIDs), &unNumPublishedFileIDs);
 	
 	UGCQueryHandle_t result = SteamUGC()->CreateQueryUGCDetailsRequest(pvecPublishedFileID, unNumPublishedFileIDs);
+	delete[] pvecPublishedFileID;
 	
 	std::ostringstream data;
 	data << result;
@@ -1991,6 +6739,163 @@ value SteamWrap_UGCRead(value handle, value bytesToRead, value offset, value rea
 }
 DEFINE_PRIM(SteamWrap_UGCRead,4);
 
+//-----------------------------------------------------------------------------------------------------------
+// Streaming UGC to disk: a worker thread UGCReads a downloaded handle through one fixed buffer and writes each
+// chunk straight to the file, so memory stays flat however big the item is. RunCallbacks picks up progress and
+// completion and sends them as events from the main thread.
+
+static const int32 kUGCStreamDefaultBuffer = 1 << 20;
+static const double kUGCStreamProgressInterval = 0.25;
+
+struct UGCStreamJob
+{
+	int id;
+	UGCHandle_t handle;
+	std::string path;
+	int32 bufferSize;
+	int64 total;
+	std::atomic<int64> written;
+	std::atomic<bool> cancel;
+	std::atomic<bool> done;
+	bool success;
+	int64 reported;
+	double nextProgress;
+	std::thread worker;
+};
+
+static std::map<int, std::unique_ptr<UGCStreamJob> > s_ugcStreams;
+static int s_ugcStreamCounter = 0;
+
+static void UGCStreamRun(UGCStreamJob* job)
+{
+	std::vector<unsigned char> buffer(job->bufferSize);
+	ISteamRemoteStorage* storage = SteamRemoteStorage();
+	
+	//written next to the target and renamed into place, so a cancelled or failed stream never leaves half a file
+	std::string temp = job->path + ".part";
+	FILE* file = fopen(temp.c_str(), "wb");
+	bool ok = file != NULL;
+	int64 offset = 0;
+	while (ok && offset < job->total)
+	{
+		if (job->cancel)
+		{
+			ok = false;
+			break;
+		}
+		int64 left = job->total - offset;
+		int32 want = left < job->bufferSize ? (int32)left : job->bufferSize;
+		int32 read = storage->UGCRead(job->handle, buffer.data(), want, (uint32)offset, k_EUGCRead_ContinueReadingUntilFinished);
+		if (read <= 0 || fwrite(buffer.data(), 1, read, file) != (size_t)read)
+		{
+			ok = false;
+			break;
+		}
+		offset += read;
+		job->written = offset;
+	}
+	if (file != NULL && fclose(file) != 0) ok = false;
+	
+	if (ok)
+	{
+		remove(job->path.c_str());
+		ok = rename(temp.c_str(), job->path.c_str()) == 0;
+	}
+	if (!ok) remove(temp.c_str());
+	
+	//stopped partway through: let Steam close the file rather than hold it until the next read
+	if (offset < job->total) storage->UGCRead(job->handle, buffer.data(), 0, 0, k_EUGCRead_Close);
+	
+	job->success = ok;
+	job->done = true;
+}
+
+static void SendUGCStreamEvent(const char* type, const UGCStreamJob& job, bool success)
+{
+	value data = alloc_empty_object();
+	alloc_field(data, val_id("id"), alloc_int(job.id));
+	alloc_field(data, val_id("handle"), u64_to_hx(job.handle));
+	alloc_field(data, val_id("path"), alloc_string(job.path.c_str()));
+	alloc_field(data, val_id("bytesWritten"), alloc_float((double)job.written));
+	alloc_field(data, val_id("bytesTotal"), alloc_float((double)job.total));
+	SendEvent(Event(type, success, data));
+}
+
+static void UGCStreamsUpdate()
+{
+	if (s_ugcStreams.empty()) return;
+	
+	double now = NowSeconds();
+	std::map<int, std::unique_ptr<UGCStreamJob> >::iterator it = s_ugcStreams.begin();
+	while (it != s_ugcStreams.end())
+	{
+		UGCStreamJob& job = *it->second;
+		if (job.done)
+		{
+			job.worker.join();
+			SendUGCStreamEvent(kEventTypeOnUGCStreamFinished, job, job.success);
+			s_ugcStreams.erase(it++);
+			continue;
+		}
+		
+		int64 written = job.written;
+		if (written != job.reported && now >= job.nextProgress)
+		{
+			job.reported = written;
+			job.nextProgress = now + kUGCStreamProgressInterval;
+			SendUGCStreamEvent(kEventTypeOnUGCStreamProgress, job, true);
+		}
+		++it;
+	}
+}
+
+static void UGCStreamsReset()
+{
+	std::map<int, std::unique_ptr<UGCStreamJob> >::iterator it;
+	for (it = s_ugcStreams.begin(); it != s_ugcStreams.end(); ++it) it->second->cancel = true;
+	for (it = s_ugcStreams.begin(); it != s_ugcStreams.end(); ++it) it->second->worker.join();
+	s_ugcStreams.clear();
+}
+
+int SteamWrap_UGCReadToFile(const char * handle, const char * path, int bufferSize)
+{
+	if (!CheckInit()) return -1;
+	
+	UGCHandle_t u64Handle = strtoull(handle, NULL, 0);
+	if (u64Handle == 0 || path == NULL || path[0] == 0) return -1;
+	
+	//only works once the handle is downloaded; that's also where the size comes from
+	AppId_t appID;
+	char* name = NULL;
+	int32 size = 0;
+	CSteamID owner;
+	if (!SteamRemoteStorage()->GetUGCDetails(u64Handle, &appID, &name, &size, &owner)) return -1;
+	
+	UGCStreamJob* job = new UGCStreamJob();
+	job->id = s_ugcStreamCounter++;
+	job->handle = u64Handle;
+	job->path = path;
+	job->bufferSize = bufferSize > 0 ? bufferSize : kUGCStreamDefaultBuffer;
+	job->total = size;
+	job->written = 0;
+	job->cancel = false;
+	job->done = false;
+	job->success = false;
+	job->reported = 0;
+	job->nextProgress = 0;
+	s_ugcStreams[job->id].reset(job);
+	job->worker = std::thread(UGCStreamRun, job);
+	return job->id;
+}
+DEFINE_PRIME3(SteamWrap_UGCReadToFile);
+
+void SteamWrap_CancelUGCReadToFile(int id)
+{
+	std::map<int, std::unique_ptr<UGCStreamJob> >::iterator it = s_ugcStreams.find(id);
+	if (it != s_ugcStreams.end()) it->second->cancel = true;
+}
+DEFINE_PRIME1v(SteamWrap_CancelUGCReadToFile);
+
 #pragma endregion
 
 #pragma region Steam Cloud
@@ -1998,6 +6903,130 @@ DEFINE_PRIM(SteamWrap_UGCRead,4);
 
 //STEAM CLOUD------------------------------------------------------------------------------------------------
 
+//Results of SteamWrap_FileWrite, mirrored by Cloud.FileWriteResult on the haxe side
+static const int kCloudWriteFailed = 0;
+static const int kCloudWriteWritten = 1;
+static const int kCloudWriteUnchanged = 2;
+
+//What we last read from or wrote to each cloud file, so that rewriting byte-identical content can be skipped
+//without touching the disk or eating into the cloud sync bandwidth
+struct CloudFileHash
+{
+	uint64 hash;
+	int32 size;
+};
+static std::map<std::string, CloudFileHash> s_cloudHashes;
+
+struct CloudWriteStats
+{
+	uint64 writes;
+	uint64 skipped;
+	uint64 bytesWritten;
+	uint64 bytesSkipped;
+};
+static CloudWriteStats s_cloudWriteStats = {0, 0, 0, 0};
+
+//Opt-in transparent compression of everything written through SteamWrap_FileWrite
+struct CloudCompression
+{
+	bool enabled;
+	int threads;
+};
+static CloudCompression s_cloudCompression = { false, 1 };
+
+static void CloudRememberFile(const char * fileName, const void * data, int32 length)
+{
+	CloudFileHash entry;
+	entry.hash = xxh64(data, length, 0);
+	entry.size = length;
+	s_cloudHashes[fileName] = entry;
+}
+
+//For writes that bypass CloudWriteFile
+static void CloudForgetFile(const char* fileName)
+{
+	s_cloudHashes.erase(fileName);
+}
+
+//Reads a whole cloud file, unwrapping it if it was written compressed. Only files without a valid frame header are
+//returned as-is; a file with one that doesn't decode or fails its checksum is corrupt and the read fails.
+static bool CloudReadFile(const char * fileName, std::vector<unsigned char>& out)
+{
+	if (!SteamRemoteStorage()->FileExists(fileName)) return false;
+	
+	int32 length = SteamRemoteStorage()->GetFileSize(fileName);
+	out.resize(length);
+	int32 result = SteamRemoteStorage()->FileRead(fileName, out.data(), length);
+	if (result != length) return false;
+	
+	if (IsFrameHeader(out.data(), length))
+	{
+		std::vector<unsigned char> raw;
+		if (!DecompressFrame(out.data(), length, raw))
+		{
+			s_cloudHashes.erase(fileName);
+			out.clear();
+			return false;
+		}
+		out.swap(raw);
+	}
+	
+	CloudRememberFile(fileName, out.data(), (int32)out.size());
+	return true;
+}
+
+//Writes a whole cloud file, compressing it first if that's been enabled
+static bool CloudWriteFile(const char * fileName, const unsigned char * data, int32 length)
+{
+	bool result;
+	uint64 stored = length;
+	if (s_cloudCompression.enabled)
+	{
+		std::vector<unsigned char> frame;
+		CompressFrame(data, length, s_cloudCompression.threads, frame);
+		stored = frame.size();
+		result = SteamRemoteStorage()->FileWrite(fileName, frame.data(), (int32)frame.size());
+	}
+	else
+	{
+		result = SteamRemoteStorage()->FileWrite(fileName, data, length);
+	}
+	
+	if (result)
+	{
+		CloudRememberFile(fileName, data, length);
+		s_cloudWriteStats.writes++;
+		s_cloudWriteStats.bytesWritten += stored;
+	}
+	else
+	{
+		//we no longer know what's in there
+		s_cloudHashes.erase(fileName);
+	}
+	return result;
+}
+
+//Returns true if the cloud file already holds exactly this content. The first time we see a file that we
+//haven't read or written this session, its current contents are read once to seed the table, unless its size
+//alone already rules out a match (it can't hold this content either as-is or as a compressed frame).
+static bool CloudFileUnchanged(const char * fileName, const void * data, int32 length)
+{
+	std::map<std::string, CloudFileHash>::iterator it = s_cloudHashes.find(fileName);
+	if (it == s_cloudHashes.end())
+	{
+		if (!SteamRemoteStorage()->FileExists(fileName)) return false;
+		uint64 stored = (uint64)SteamRemoteStorage()->GetFileSize(fileName);
+		uint64 frameMin = kFrameHeaderSize + (((uint64)length + kFrameBlockSize - 1) / kFrameBlockSize) * 4;
+		if (stored != (uint64)length && (stored < frameMin || stored > frameMin + length)) return false;
+		
+		std::vector<unsigned char> existing;
+		if (!CloudReadFile(fileName, existing)) return false;
+		it = s_cloudHashes.find(fileName);
+	}
+	
+	return it->second.size == length && it->second.hash == xxh64(data, length, 0);
+}
+
 //-----------------------------------------------------------------------------------------------------------
 int SteamWrap_GetFileCount(int dummy)
 {
@@ -2033,14 +7062,10 @@ value SteamWrap_FileRead(value fileName)
 	bool exists = SteamRemoteStorage()->FileExists(fName);
 	if(!exists) return alloc_int(0);
 	
-	int length = SteamRemoteStorage()->GetFileSize(fName);
+	std::vector<unsigned char> bytesData;
+	if (!CloudReadFile(fName, bytesData)) return alloc_null();
 	
-	char *bytesData = (char *)malloc(length);
-	int32 result = SteamRemoteStorage()->FileRead(fName, bytesData, length);
-	
-	value returnValue = alloc_string_len(bytesData, length);
-	free(bytesData);
-	return returnValue;
+	return alloc_string_len((const char *)bytesData.data(), (int)bytesData.size());
 }
 DEFINE_PRIM(SteamWrap_FileRead, 1);
 
@@ -2048,22 +7073,52 @@ DEFINE_PRIM(SteamWrap_FileRead, 1);
 value SteamWrap_FileWrite(value fileName, value haxeBytes)
 {
 	if (!val_is_string(fileName) || !CheckInit())
-		return alloc_bool(false);
+		return alloc_int(kCloudWriteFailed);
 	
 	CffiBytes bytes = getByteData(haxeBytes);
 	if(bytes.data == 0)
-		return alloc_bool(false);
+		return alloc_int(kCloudWriteFailed);
 	
-	bool result = SteamRemoteStorage()->FileWrite(val_string(fileName), bytes.data, bytes.length);
+	const char * fName = val_string(fileName);
 	
-	return alloc_bool(result);
+	if (CloudFileUnchanged(fName, bytes.data, bytes.length))
+	{
+		s_cloudWriteStats.skipped++;
+		s_cloudWriteStats.bytesSkipped += bytes.length;
+		return alloc_int(kCloudWriteUnchanged);
+	}
+	
+	bool result = CloudWriteFile(fName, bytes.data, bytes.length);
+	
+	return alloc_int(result ? kCloudWriteWritten : kCloudWriteFailed);
 }
 DEFINE_PRIM(SteamWrap_FileWrite, 2);
 
+//-----------------------------------------------------------------------------------------------------------
+void SteamWrap_SetCloudCompression(int enabled, int threads)
+{
+	s_cloudCompression.enabled = enabled != 0;
+	s_cloudCompression.threads = threads < 1 ? 1 : threads;
+}
+DEFINE_PRIME2v(SteamWrap_SetCloudCompression);
+
+//-----------------------------------------------------------------------------------------------------------
+value SteamWrap_GetCloudWriteStats()
+{
+	value obj = alloc_empty_object();
+	alloc_field(obj, val_id("writes"), alloc_float((double)s_cloudWriteStats.writes));
+	alloc_field(obj, val_id("skipped"), alloc_float((double)s_cloudWriteStats.skipped));
+	alloc_field(obj, val_id("bytesWritten"), alloc_float((double)s_cloudWriteStats.bytesWritten));
+	alloc_field(obj, val_id("bytesSkipped"), alloc_float((double)s_cloudWriteStats.bytesSkipped));
+	return obj;
+}
+DEFINE_PRIM(SteamWrap_GetCloudWriteStats, 0);
+
 //-----------------------------------------------------------------------------------------------------------
 int SteamWrap_FileDelete(const char * fileName)
 {
 	bool result = SteamRemoteStorage()->FileDelete(fileName);
+	s_cloudHashes.erase(fileName);
 	return result;
 }
 DEFINE_PRIME1(SteamWrap_FileDelete);
@@ -2104,6 +7159,343 @@ value SteamWrap_GetQuota()
 }
 DEFINE_PRIM(SteamWrap_GetQuota,0);
 
+//CHUNKED SAVES----------------------------------------------------------------------------------------------
+
+//Large saves can be stored as content-defined chunks (one cloud file each, named after the XXH64 of their content)
+//plus a small manifest under the save's own name. Chunk boundaries come from a rolling gear hash, so an edit only
+//changes the chunks around it and saving again only writes those. Chunks no manifest refers to any more are deleted.
+//
+//Manifest layout (little-endian): "SWCM" | version:u32 | totalSize:u64 | chunkCount:u32 | (hash:u64, size:u32)[chunkCount]
+static const char * kChunkPrefix = "swchunk_";
+static const char * kChunkRegistryFile = "swchunk_manifests";
+static const unsigned char kChunkManifestMagic[4] = { 'S', 'W', 'C', 'M' };
+static const uint32 kChunkManifestVersion = 1;
+//Every chunk is a cloud file of its own and Steam Cloud limits how many files an app may have, so chunks are kept
+//large: a 100MB save is around 100 files, at the cost of rewriting ~1MB around each edit.
+static const uint32 kChunkMinSize = 256 * 1024;
+static const uint32 kChunkMaxSize = 4 * 1024 * 1024;
+static const uint64 kChunkBoundaryMask = 0xFFFFF00000000000ULL;	//20 bits -> ~1MB average chunks
+
+struct ChunkRef
+{
+	uint64 hash;
+	uint32 size;
+};
+
+static uint64 s_chunkGear[256];
+static bool s_chunkStoreLoaded = false;
+static std::set<uint64> s_chunkStore;									//chunks currently in the cloud
+static std::map<std::string, std::vector<ChunkRef> > s_chunkManifests;	//every registered manifest, loaded lazily
+static std::set<std::string> s_chunkManifestsLoaded;
+static bool s_chunkRegistryDirty = false;								//the cloud registry is missing manifests we know about
+
+static std::string ChunkFileName(uint64 hash)
+{
+	char name[32];
+	snprintf(name, sizeof(name), "%s%016llx", kChunkPrefix, (unsigned long long)hash);
+	return name;
+}
+
+//The gear table has to be identical across builds or chunk boundaries (and therefore dedup) would shift,
+//so it's generated from a fixed seed with splitmix64 rather than taken from a random source
+static void ChunkInitGear()
+{
+	uint64 x = 0x5377436875626BULL;
+	for (int i = 0; i < 256; i++)
+	{
+		uint64 z = (x += 0x9E3779B97F4A7C15ULL);
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+		s_chunkGear[i] = z ^ (z >> 31);
+	}
+}
+
+static void ChunkSplit(const unsigned char * data, uint32 length, std::vector<ChunkRef>& out)
+{
+	uint32 start = 0;
+	while (start < length)
+	{
+		uint32 remaining = length - start;
+		uint32 size = remaining;
+		if (remaining > kChunkMinSize)
+		{
+			uint32 limit = remaining < kChunkMaxSize ? remaining : kChunkMaxSize;
+			uint64 h = 0;
+			size = limit;
+			for (uint32 i = kChunkMinSize; i < limit; i++)
+			{
+				h = (h << 1) + s_chunkGear[data[start + i]];
+				if ((h & kChunkBoundaryMask) == 0)
+				{
+					size = i + 1;
+					break;
+				}
+			}
+		}
+		
+		ChunkRef ref;
+		ref.hash = xxh64(data + start, size, 0);
+		ref.size = size;
+		out.push_back(ref);
+		start += size;
+	}
+}
+
+static bool ChunkParseManifest(const std::vector<unsigned char>& data, std::vector<ChunkRef>& refs, uint64 * totalSize)
+{
+	if (data.size() < 20 || memcmp(data.data(), kChunkManifestMagic, 4) != 0) return false;
+	if (xxh64_read32(data.data() + 4) != kChunkManifestVersion) return false;
+	
+	uint64 total = xxh64_read64(data.data() + 8);
+	uint32 count = xxh64_read32(data.data() + 16);
+	if ((uint64)20 + (uint64)count * 12 != data.size()) return false;
+	
+	refs.resize(count);
+	const unsigned char * p = data.data() + 20;
+	for (uint32 i = 0; i < count; i++, p += 12)
+	{
+		refs[i].hash = xxh64_read64(p);
+		refs[i].size = xxh64_read32(p + 8);
+	}
+	if (totalSize) *totalSize = total;
+	return true;
+}
+
+static bool ChunkReadManifest(const char * fileName, std::vector<ChunkRef>& refs, uint64 * totalSize)
+{
+	std::vector<unsigned char> data;
+	return CloudReadFile(fileName, data) && ChunkParseManifest(data, refs, totalSize);
+}
+
+//Returns false if the registry couldn't be written; until it is, garbage collection stays off, since another
+//session reading the stale registry wouldn't know the missing manifests' chunks are still needed
+static bool ChunkWriteRegistry()
+{
+	std::string registry;
+	for (std::map<std::string, std::vector<ChunkRef> >::iterator it = s_chunkManifests.begin(); it != s_chunkManifests.end(); ++it)
+	{
+		registry += it->first;
+		registry += "\n";
+	}
+	if (!CloudFileUnchanged(kChunkRegistryFile, registry.data(), (int32)registry.size()))
+	{
+		s_chunkRegistryDirty = !CloudWriteFile(kChunkRegistryFile, (const unsigned char *)registry.data(), (int32)registry.size());
+	}
+	return !s_chunkRegistryDirty;
+}
+
+//Learns which chunks exist and which manifests refer to them, once per session
+static void ChunkStoreLoad()
+{
+	if (s_chunkStoreLoaded) return;
+	s_chunkStoreLoaded = true;
+	ChunkInitGear();
+	
+	size_t prefixLength = strlen(kChunkPrefix);
+	int32 count = SteamRemoteStorage()->GetFileCount();
+	for (int32 i = 0; i < count; i++)
+	{
+		int32 size = 0;
+		const char * name = SteamRemoteStorage()->GetFileNameAndSize(i, &size);
+		if (name == NULL || strncmp(name, kChunkPrefix, prefixLength) != 0 || strlen(name) != prefixLength + 16) continue;
+		
+		char * end = NULL;
+		uint64 hash = strtoull(name + prefixLength, &end, 16);
+		if (end != NULL && *end == 0) s_chunkStore.insert(hash);
+	}
+	
+	std::vector<unsigned char> registry;
+	if (CloudReadFile(kChunkRegistryFile, registry))
+	{
+		std::string names(registry.begin(), registry.end());
+		std::vector<std::string> lines;
+		split(names, '\n', lines);
+		for (size_t i = 0; i < lines.size(); i++)
+		{
+			if (!lines[i].empty()) s_chunkManifests[lines[i]];
+		}
+	}
+}
+
+//Deletes every chunk that no registered manifest refers to. Returns how many were deleted, or -1 if a
+//manifest couldn't be read or the registry couldn't be written (in which case nothing is deleted, since
+//we can't tell what is still needed). A registered file that no longer holds a manifest, e.g. because it
+//was overwritten with a plain FileWrite, is dropped from the registry.
+static int ChunkCollectGarbage()
+{
+	ChunkStoreLoad();
+	if (s_chunkRegistryDirty && !ChunkWriteRegistry()) return -1;
+	
+	std::set<uint64> referenced;
+	bool registryChanged = false;
+	std::vector<unsigned char> data;
+	std::map<std::string, std::vector<ChunkRef> >::iterator it = s_chunkManifests.begin();
+	while (it != s_chunkManifests.end())
+	{
+		if (s_chunkManifestsLoaded.count(it->first) == 0)
+		{
+			if (!SteamRemoteStorage()->FileExists(it->first.c_str()))
+			{
+				s_chunkManifests.erase(it++);
+				registryChanged = true;
+				continue;
+			}
+			if (!CloudReadFile(it->first.c_str(), data)) return -1;
+			if (!ChunkParseManifest(data, it->second, NULL))
+			{
+				s_chunkManifests.erase(it++);
+				registryChanged = true;
+				continue;
+			}
+			s_chunkManifestsLoaded.insert(it->first);
+		}
+		for (size_t i = 0; i < it->second.size(); i++) referenced.insert(it->second[i].hash);
+		++it;
+	}
+	if (registryChanged && !ChunkWriteRegistry()) return -1;
+	
+	int deleted = 0;
+	std::set<uint64>::iterator chunk = s_chunkStore.begin();
+	while (chunk != s_chunkStore.end())
+	{
+		if (referenced.count(*chunk) == 0)
+		{
+			std::string name = ChunkFileName(*chunk);
+			SteamRemoteStorage()->FileDelete(name.c_str());
+			s_cloudHashes.erase(name);
+			s_chunkStore.erase(chunk++);
+			deleted++;
+		}
+		else
+		{
+			++chunk;
+		}
+	}
+	return deleted;
+}
+
+//-----------------------------------------------------------------------------------------------------------
+value SteamWrap_ChunkedFileWrite(value fileName, value haxeBytes)
+{
+	if (!val_is_string(fileName) || !CheckInit())
+		return alloc_int(-1);
+	
+	CffiBytes bytes = getByteData(haxeBytes);
+	if (bytes.data == 0)
+		return alloc_int(-1);
+	
+	ChunkStoreLoad();
+	
+	const char * fName = val_string(fileName);
+	std::vector<ChunkRef> refs;
+	ChunkSplit(bytes.data, bytes.length, refs);
+	
+	//new chunks first, so the manifest never points at something that isn't there yet
+	int written = 0;
+	uint32 offset = 0;
+	for (size_t i = 0; i < refs.size(); i++)
+	{
+		if (s_chunkStore.count(refs[i].hash) == 0)
+		{
+			if (!CloudWriteFile(ChunkFileName(refs[i].hash).c_str(), bytes.data + offset, refs[i].size))
+				return alloc_int(-1);
+			s_chunkStore.insert(refs[i].hash);
+			written++;
+		}
+		offset += refs[i].size;
+	}
+	
+	std::vector<unsigned char> manifest(20 + refs.size() * 12);
+	unsigned char * p = manifest.data();
+	uint64 totalSize = bytes.length;
+	memcpy(p, kChunkManifestMagic, 4);
+	frame_write32(p + 4, kChunkManifestVersion);
+	memcpy(p + 8, &totalSize, 8);
+	frame_write32(p + 16, (uint32)refs.size());
+	p += 20;
+	for (size_t i = 0; i < refs.size(); i++, p += 12)
+	{
+		memcpy(p, &refs[i].hash, 8);
+		frame_write32(p + 8, refs[i].size);
+	}
+	
+	if (!CloudFileUnchanged(fName, manifest.data(), (int32)manifest.size()))
+	{
+		if (!CloudWriteFile(fName, manifest.data(), (int32)manifest.size()))
+			return alloc_int(-1);
+	}
+	
+	bool registered = s_chunkManifests.count(fName) != 0;
+	s_chunkManifests[fName] = refs;
+	s_chunkManifestsLoaded.insert(fName);
+	if ((!registered || s_chunkRegistryDirty) && !ChunkWriteRegistry())
+		return alloc_int(-1);
+	
+	ChunkCollectGarbage();
+	
+	return alloc_int(written);
+}
+DEFINE_PRIM(SteamWrap_ChunkedFileWrite, 2);
+
+//-----------------------------------------------------------------------------------------------------------
+value SteamWrap_ChunkedFileRead(value fileName)
+{
+	if (!val_is_string(fileName) || !CheckInit())
+		return alloc_null();
+	
+	ChunkStoreLoad();
+	
+	std::vector<ChunkRef> refs;
+	uint64 totalSize = 0;
+	if (!ChunkReadManifest(val_string(fileName), refs, &totalSize) || totalSize > 0x7fffffff)
+		return alloc_null();
+	
+	buffer buf = alloc_buffer_len((int)totalSize);
+	unsigned char * dest = (unsigned char *)buffer_data(buf);
+	uint64 offset = 0;
+	std::vector<unsigned char> chunk;
+	for (size_t i = 0; i < refs.size(); i++)
+	{
+		if (!CloudReadFile(ChunkFileName(refs[i].hash).c_str(), chunk)) return alloc_null();
+		if (chunk.size() != refs[i].size || offset + chunk.size() > totalSize) return alloc_null();
+		if (xxh64(chunk.data(), chunk.size(), 0) != refs[i].hash) return alloc_null();
+		
+		memcpy(dest + offset, chunk.data(), chunk.size());
+		offset += chunk.size();
+	}
+	if (offset != totalSize) return alloc_null();
+	
+	return buffer_val(buf);
+}
+DEFINE_PRIM(SteamWrap_ChunkedFileRead, 1);
+
+//-----------------------------------------------------------------------------------------------------------
+int SteamWrap_ChunkedFileDelete(const char * fileName)
+{
+	if (!CheckInit()) return false;
+	
+	ChunkStoreLoad();
+	
+	bool result = SteamRemoteStorage()->FileDelete(fileName);
+	s_cloudHashes.erase(fileName);
+	if (s_chunkManifests.erase(fileName) > 0)
+	{
+		s_chunkManifestsLoaded.erase(fileName);
+		ChunkWriteRegistry();
+		ChunkCollectGarbage();
+	}
+	return result;
+}
+DEFINE_PRIME1(SteamWrap_ChunkedFileDelete);
+
+//-----------------------------------------------------------------------------------------------------------
+int SteamWrap_ChunkedCollectGarbage(int dummy)
+{
+	if (!CheckInit()) return 0;
+	return ChunkCollectGarbage();
+}
+DEFINE_PRIME1(SteamWrap_ChunkedCollectGarbage);
+
 #pragma endregion
 
 #pragma region Steam Networking
@@ -2220,6 +7612,23 @@ value SteamWrap_LobbyMemberID(value index) {
 }
 DEFINE_PRIM(SteamWrap_LobbyMemberID, 1);
 
+//Every member of the current lobby with their persona name, packed like SteamWrap_GetPersonaNames
+value SteamWrap_LobbyMemberNames() {
+	swp_start(alloc_null()); swp_req(SteamWrap_LobbyID.IsValid());
+	int count = SteamMatchmaking()->GetNumLobbyMembers(SteamWrap_LobbyID);
+	PackedWriter w;
+	w.u32(count > 0 ? count : 0);
+	for (int i = 0; i < count; i++) {
+		uint64 id = SteamMatchmaking()->GetLobbyMemberByIndex(SteamWrap_LobbyID, i).ConvertToUint64();
+		const char* name = PersonaCacheLookup(id);
+		w.u64(id);
+		w.u8(name ? 1 : 0);
+		w.str(name ? name : "");
+	}
+	return w.toValue();
+}
+DEFINE_PRIM(SteamWrap_LobbyMemberNames, 0);
+
 value SteamWrap_LobbySetData(value field, value data) {
 	if (CheckInit() && val_is_string(field) && val_is_string(data) && SteamWrap_LobbyID.IsValid()) {
 		return alloc_bool(SteamMatchmaking()->SetLobbyData(SteamWrap_LobbyID, val_string(field), val_string(data)));
@@ -34,6 +34,10 @@ class Cloud
 		return SteamWrap_FileExists.call(name) == 1;
 	}
 	
+	/**
+	 * Returns the size of the file as stored in the cloud. For files written with compression enabled
+	 * this is the compressed size, not the length FileRead() will return.
+	 */
 	public function GetFileSize(name:String):Int {
 		if (!active) return 0;
 		return SteamWrap_GetFileSize.call(name);
@@ -71,10 +75,28 @@ class Cloud
 		SteamWrap_FileShare.call(name);
 	}
 	
-	public function FileWrite(name:String, data:Bytes):Void
+	/**
+	 * Writes a file to the Steam Cloud. Rewriting a file with byte-identical content is detected natively
+	 * and skipped, so it costs neither disk I/O nor cloud sync bandwidth.
+	 * @param	name	the cloud file name
+	 * @param	data	the file contents
+	 * @return	whether the file was written, skipped because it was unchanged, or the write failed
+	 */
+	public function FileWrite(name:String, data:Bytes):FileWriteResult
 	{
-		if (!active) return;
-		SteamWrap_FileWrite(name, data);
+		if (!active) return FileWriteResult.Failed;
+		return SteamWrap_FileWrite(name, data);
+	}
+	
+	/**
+	 * Returns counters for FileWrite() calls made this session.
+	 * writes/bytesWritten count actual writes (bytesWritten after compression), skipped/bytesSkipped count writes
+	 * avoided because the content was unchanged.
+	 */
+	public function GetWriteStats():{writes:Float, skipped:Float, bytesWritten:Float, bytesSkipped:Float}
+	{
+		if (!active) return {writes:0, skipped:0, bytesWritten:0, bytesSkipped:0};
+		return SteamWrap_GetCloudWriteStats();
 	}
 	
 	public function FileDelete(name:String):Bool {
@@ -82,6 +104,70 @@ class Cloud
 		return SteamWrap_FileDelete.call(name) == 1;
 	}
 	
+	/**
+	 * Writes a (large) save as content-defined chunks plus a small manifest stored under `name`.
+	 * Only chunks that aren't already in the cloud are written, so saving again after a small edit
+	 * uploads roughly the edited region instead of the whole file. Chunks no longer referenced by any
+	 * chunked save are deleted afterwards.
+	 * Each chunk (about 1MB on average, 256KB to 4MB) is a cloud file of its own, so a chunked save costs
+	 * roughly one file per MB plus its manifest against the app's Steam Cloud file count quota, and an
+	 * edit rewrites about 1MB around it. Saves under a few MB are better off with FileWrite().
+	 * Files written this way must be read back with ChunkedFileRead(), not FileRead().
+	 * @param	name	the cloud file name of the manifest
+	 * @param	data	the file contents
+	 * @return	how many new chunks were written (0 if nothing changed), or -1 if the write failed
+	 * (including failing to record `name` in the list of chunked saves)
+	 */
+	public function ChunkedFileWrite(name:String, data:Bytes):Int
+	{
+		if (!active) return -1;
+		return SteamWrap_ChunkedFileWrite(name, data);
+	}
+	
+	/**
+	 * Reads back a file written with ChunkedFileWrite(). Returns null if the manifest or any of its
+	 * chunks is missing or corrupt.
+	 */
+	public function ChunkedFileRead(name:String):Bytes
+	{
+		if (!active) return null;
+		var data:BytesData = SteamWrap_ChunkedFileRead(name);
+		if (data == null) return null;
+		return Bytes.ofData(data);
+	}
+	
+	/**
+	 * Deletes a file written with ChunkedFileWrite() along with any chunks only it was using.
+	 */
+	public function ChunkedFileDelete(name:String):Bool {
+		if (!active) return false;
+		return SteamWrap_ChunkedFileDelete.call(name) == 1;
+	}
+	
+	/**
+	 * Deletes chunks that no chunked save refers to any more (e.g. left behind by an interrupted write).
+	 * ChunkedFileWrite() and ChunkedFileDelete() already do this, so it rarely needs calling directly.
+	 * @return	how many chunk files were deleted, or -1 if a manifest couldn't be read or the list of chunked
+	 * saves couldn't be written, and nothing was deleted
+	 */
+	public function ChunkedCollectGarbage():Int {
+		if (!active) return 0;
+		return SteamWrap_ChunkedCollectGarbage.call(0);
+	}
+	
+	/**
+	 * Opt into transparent compression of cloud files. While enabled, FileWrite() stores files in a
+	 * compressed frame and FileRead() unwraps them again. Files written without compression (or by
+	 * older builds) keep reading exactly as before, so this can be switched on for an existing game.
+	 * A compressed file that fails to decode or its checksum reads as null rather than as garbage.
+	 * @param	enabled	whether FileWrite() should compress
+	 * @param	threads	how many threads to compress large (multi-MB) files on
+	 */
+	public function SetCompression(enabled:Bool, threads:Int = 1):Void {
+		if (!active) return;
+		SteamWrap_SetCloudCompression.call(enabled ? 1 : 0, threads);
+	}
+	
 	public function IsCloudEnabledForApp():Bool {
 		if (!active) return false;
 		return SteamWrap_IsCloudEnabledForApp.call(0) == 1;
@@ -102,6 +188,9 @@ class Cloud
 	private var SteamWrap_FileRead:Dynamic;
 	private var SteamWrap_FileWrite:Dynamic;
 	private var SteamWrap_GetQuota:Dynamic;
+	private var SteamWrap_GetCloudWriteStats:Dynamic;
+	private var SteamWrap_ChunkedFileWrite:Dynamic;
+	private var SteamWrap_ChunkedFileRead:Dynamic;
 	
 	//CFFI PRIME calls:
 	private var SteamWrap_GetFileCount     = Loader.load("SteamWrap_GetFileCount", "ii");
@@ -111,6 +200,9 @@ class Cloud
 	private var SteamWrap_FileShare     = Loader.load("SteamWrap_FileShare", "cv");
 	private var SteamWrap_IsCloudEnabledForApp   = Loader.load("SteamWrap_IsCloudEnabledForApp", "ii");
 	private var SteamWrap_SetCloudEnabledForApp  = Loader.load("SteamWrap_SetCloudEnabledForApp", "iv");
+	private var SteamWrap_SetCloudCompression    = Loader.load("SteamWrap_SetCloudCompression", "iiv");
+	private var SteamWrap_ChunkedFileDelete      = Loader.load("SteamWrap_ChunkedFileDelete", "ci");
+	private var SteamWrap_ChunkedCollectGarbage  = Loader.load("SteamWrap_ChunkedCollectGarbage", "ii");
 	
 	private function new(appId_:Int, CustomTrace:String->Void) {
 		#if sys		//TODO: figure out what targets this will & won't work with and upate this guard
@@ -125,6 +217,9 @@ class Cloud
 			SteamWrap_FileRead  = cpp.Lib.load("steamwrap", "SteamWrap_FileRead", 1);
 			SteamWrap_FileWrite = cpp.Lib.load("steamwrap", "SteamWrap_FileWrite", 2);
 			SteamWrap_GetQuota = cpp.Lib.load("steamwrap", "SteamWrap_GetQuota", 0);
+			SteamWrap_GetCloudWriteStats = cpp.Lib.load("steamwrap", "SteamWrap_GetCloudWriteStats", 0);
+			SteamWrap_ChunkedFileWrite = cpp.Lib.load("steamwrap", "SteamWrap_ChunkedFileWrite", 2);
+			SteamWrap_ChunkedFileRead = cpp.Lib.load("steamwrap", "SteamWrap_ChunkedFileRead", 1);
 		}
 		catch (e:Dynamic) {
 			customTrace("Running non-Steam version (" + e + ")");
@@ -135,4 +230,12 @@ class Cloud
 		
 		#end
 	}
-}
\ No newline at end of file
+}
+
+@:enum
+abstract FileWriteResult(Int) from Int to Int
+{
+	var Failed = 0;
+	var Written = 1;
+	var Unchanged = 2;
+}
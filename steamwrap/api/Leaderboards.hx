@@ -0,0 +1,329 @@
+package steamwrap.api;
+import haxe.io.Bytes;
+import haxe.io.BytesData;
+import steamwrap.api.Steam.LeaderboardDownloadType;
+import steamwrap.api.Steam.LeaderboardScore;
+import steamwrap.helpers.Loader;
+import steamwrap.helpers.PackedReader;
+
+/**
+ * The native leaderboard manager. Used by API.hx, should never be created manually by the user.
+ * API.hx creates and initializes this by default.
+ * Access it via Steam.leaderboards static variable
+ *
+ * Unlike Steam.uploadLeaderboardScore()/downloadLeaderboardScore(), which run one operation at a time,
+ * boards are resolved once into integer ids (all in parallel), and any number of uploads and downloads
+ * can be in flight at once. Requests made while a board is still resolving go out as soon as it's found.
+ */
+@:allow(steamwrap.api.Steam)
+class Leaderboards
+{
+	/*************PUBLIC***************/
+
+	/**
+	 * Whether the leaderboard manager is initialized or not. If false, all calls will fail.
+	 */
+	public var active(default, null):Bool = false;
+
+	/**
+	 * Called when a board finishes resolving: board id, success
+	 */
+	public var whenLeaderboardFound:Int->Bool->Void;
+
+	/**
+	 * Called for every finished upload (after the request's own onComplete, if any)
+	 */
+	public var whenScoreUploaded:LeaderboardUploadResult->Void;
+
+	/**
+	 * Called for every finished download (after the request's own onComplete, if any): request id, board id,
+	 * scores (null if the download failed)
+	 */
+	public var whenScoresDownloaded:Int->Int->Array<LeaderboardScore>->Void;
+
+	/**
+	 * Called for every finished attachReplay() (after its own onComplete, if any): request id, board id,
+	 * UGC handle (null if it failed)
+	 */
+	public var whenReplayAttached:Int->Int->String->Void;
+
+	/**
+	 * Called for every blob downloadReplays() finishes (after the request's own onReplay, if any): request id,
+	 * UGC handle, blob (null if it couldn't be downloaded)
+	 */
+	public var whenReplayDownloaded:Int->String->Bytes->Void;
+
+	/**
+	 * Resolves a leaderboard and returns the id the other calls take. Resolve every board the game uses up
+	 * front and they are all looked up at once; resolving the same name again returns the same id.
+	 * @param	name	the leaderboard's name
+	 * @param	sortMethod	if not None, the board is created with this sort method if it doesn't exist yet
+	 * @param	displayType	how Steam displays the scores of a newly created board
+	 * @return	the board id, or -1 on error
+	 */
+	public function resolve(name:String, sortMethod:LeaderboardSortMethod = LeaderboardSortMethod.None, displayType:LeaderboardDisplayType = LeaderboardDisplayType.Numeric):Int {
+		if (!active) return -1;
+		return SteamWrap_ResolveLeaderboard(name, sortMethod, displayType);
+	}
+
+	public function getState(board:Int):LeaderboardState {
+		if (!active) return LeaderboardState.Unknown;
+		return SteamWrap_GetLeaderboardState.call(board);
+	}
+
+	/**
+	 * Returns the user's best score on a board as far as it's known locally (fetched when the board is
+	 * resolved and kept up to date by uploads), or null if the user has no entry or it isn't known yet.
+	 */
+	public function getBest(board:Int):Null<Int> {
+		if (!active) return null;
+		return SteamWrap_GetLeaderboardBest(board);
+	}
+
+	/**
+	 * Uploads a score. Several uploads (to the same or different boards) can be in flight at once.
+	 * Unless forceUpdate is set, a score that can't beat the user's current best (see getBest()) is not
+	 * sent at all; the result then reports success with skipped set.
+	 * @param	board	id from resolve()
+	 * @param	score
+	 * @param	details	up to 64 extra ints stored with the score
+	 * @param	forceUpdate	replace the user's score even if it's worse than the one on the board
+	 * @param	onComplete	called with this request's result
+	 * @return	the request id, or -1 on error
+	 */
+	public function upload(board:Int, score:Int, ?details:Array<Int>, forceUpdate:Bool = false, ?onComplete:LeaderboardUploadResult->Void):Int {
+		if (!active) return -1;
+		var request:Int = SteamWrap_UploadLeaderboardScoreById(board, score, details != null ? details : [], forceUpdate);
+		if (request >= 0 && onComplete != null) uploadCallbacks.set(request, onComplete);
+		return request;
+	}
+
+	/**
+	 * Downloads a range of entries. Several downloads (from the same or different boards) can be in flight at once;
+	 * identical ones asked for while one is in flight share its call, and with setCacheTTL() recent results are reused.
+	 * @param	board	id from resolve()
+	 * @param	downloadType	Global, AroundUser or AllFriends
+	 * @param	rangeStart	first rank for Global, offset from the user (e.g. -5) for AroundUser; ignored for AllFriends
+	 * @param	rangeEnd	last rank for Global, offset from the user (e.g. 5) for AroundUser; ignored for AllFriends
+	 * @param	onComplete	called with this request's scores (null if the download failed)
+	 * @return	the request id, or -1 on error
+	 */
+	public function download(board:Int, downloadType:LeaderboardDownloadType, rangeStart:Int, rangeEnd:Int, ?onComplete:Array<LeaderboardScore>->Void):Int {
+		if (!active) return -1;
+		var request:Int = SteamWrap_DownloadLeaderboardScoresById(board, downloadType, rangeStart, rangeEnd);
+		if (request >= 0 && onComplete != null) downloadCallbacks.set(request, onComplete);
+		return request;
+	}
+
+	/**
+	 * Reuses downloaded windows (same board, type and range) for the given number of seconds instead of going back
+	 * to the server. A board's windows are dropped as soon as an upload of ours changes the user's entry on it.
+	 * @param	seconds	0 (the default) turns the cache off
+	 */
+	public function setCacheTTL(seconds:Float):Void {
+		if (!active) return;
+		SteamWrap_SetLeaderboardCacheTTL.call(seconds);
+	}
+
+	/**
+	 * Attaches a blob (e.g. a ghost replay) to the user's entry on a board: it is compressed, written to the
+	 * Steam Cloud as fileName, shared and attached, all natively. Upload the score first; the attachment goes
+	 * on whatever entry the user has when the attach happens.
+	 * @param	board	id from resolve()
+	 * @param	fileName	the cloud file to store it in (overwritten)
+	 * @param	data	the blob
+	 * @param	onComplete	called with the UGC handle, or null if any step failed
+	 * @return	the request id, or -1 on error
+	 */
+	public function attachReplay(board:Int, fileName:String, data:Bytes, ?onComplete:String->Void):Int {
+		if (!active || data == null) return -1;
+		var request:Int = SteamWrap_AttachLeaderboardReplay(board, fileName, data.getData());
+		if (request >= 0 && onComplete != null) attachCallbacks.set(request, onComplete);
+		return request;
+	}
+
+	/**
+	 * Downloads the blobs attached to any number of entries, all in parallel. Blobs come out of the replay
+	 * cache (see setReplayCache()) when they can and are decompressed natively.
+	 * @param	handles	ugcHandle of each entry
+	 * @param	priority	UGCDownload priority, lower is sooner
+	 * @param	onReplay	called once per handle with the blob, or null if it couldn't be downloaded
+	 * @return	the request id, or -1 on error
+	 */
+	public function downloadReplays(handles:Array<String>, priority:Int = 0, ?onReplay:String->Bytes->Void):Int {
+		if (!active || handles.length == 0) return -1;
+		var request:Int = SteamWrap_DownloadLeaderboardReplays(handles, priority);
+		if (request >= 0 && onReplay != null) replayCallbacks.set(request, {callback:onReplay, remaining:handles.length});
+		return request;
+	}
+
+	/**
+	 * Like downloadReplays(), for the entries among scores that have something attached.
+	 */
+	public function downloadReplaysOf(scores:Array<LeaderboardScore>, priority:Int = 0, ?onReplay:String->Bytes->Void):Int {
+		var handles = [for (score in scores) if (score.ugcHandle != "0" && score.ugcHandle != UGC_HANDLE_INVALID) score.ugcHandle];
+		return downloadReplays(handles, priority, onReplay);
+	}
+
+	/**
+	 * Keeps downloaded and attached blobs in a directory of their own, least recently used ones going first once
+	 * they take up more than maxBytes. Blobs cached by earlier sessions are used again. Off until this is called.
+	 * @param	directory	an existing directory; "" turns the cache off
+	 * @param	maxBytes	size limit of the cache
+	 */
+	public function setReplayCache(directory:String, maxBytes:Int):Void {
+		if (!active) return;
+		SteamWrap_SetReplayCache.call(directory, maxBytes);
+	}
+
+	/*************PRIVATE***************/
+
+	private static inline var UGC_HANDLE_INVALID = "18446744073709551615";
+
+	private var customTrace:String->Void;
+	private var appId:Int;
+
+	private var uploadCallbacks:Map<Int, LeaderboardUploadResult->Void> = new Map();
+	private var downloadCallbacks:Map<Int, Array<LeaderboardScore>->Void> = new Map();
+	private var attachCallbacks:Map<Int, String->Void> = new Map();
+	private var replayCallbacks:Map<Int, {callback:String->Bytes->Void, remaining:Int}> = new Map();
+
+	//Old-school CFFI calls:
+	private var SteamWrap_ResolveLeaderboard:Dynamic;
+	private var SteamWrap_UploadLeaderboardScoreById:Dynamic;
+	private var SteamWrap_DownloadLeaderboardScoresById:Dynamic;
+	private var SteamWrap_GetLeaderboardBest:Dynamic;
+	private var SteamWrap_AttachLeaderboardReplay:Dynamic;
+	private var SteamWrap_DownloadLeaderboardReplays:Dynamic;
+
+	//CFFI PRIME calls:
+	private var SteamWrap_GetLeaderboardState = Loader.load("SteamWrap_GetLeaderboardState", "ii");
+	private var SteamWrap_SetReplayCache = Loader.load("SteamWrap_SetReplayCache", "civ");
+	private var SteamWrap_SetLeaderboardCacheTTL = Loader.load("SteamWrap_SetLeaderboardCacheTTL", "fv");
+
+	private function new(appId_:Int, CustomTrace:String->Void) {
+		#if sys		//TODO: figure out what targets this will & won't work with and upate this guard
+
+		if (active) return;
+
+		appId = appId_;
+		customTrace = CustomTrace;
+
+		try {
+			//Old-school CFFI calls:
+			SteamWrap_ResolveLeaderboard = cpp.Lib.load("steamwrap", "SteamWrap_ResolveLeaderboard", 3);
+			SteamWrap_UploadLeaderboardScoreById = cpp.Lib.load("steamwrap", "SteamWrap_UploadLeaderboardScoreById", 4);
+			SteamWrap_DownloadLeaderboardScoresById = cpp.Lib.load("steamwrap", "SteamWrap_DownloadLeaderboardScoresById", 4);
+			SteamWrap_GetLeaderboardBest = cpp.Lib.load("steamwrap", "SteamWrap_GetLeaderboardBest", 1);
+			SteamWrap_AttachLeaderboardReplay = cpp.Lib.load("steamwrap", "SteamWrap_AttachLeaderboardReplay", 3);
+			SteamWrap_DownloadLeaderboardReplays = cpp.Lib.load("steamwrap", "SteamWrap_DownloadLeaderboardReplays", 2);
+		}
+		catch (e:Dynamic) {
+			customTrace("Running non-Steam version (" + e + ")");
+			return;
+		}
+
+		active = true;
+
+		#end
+	}
+
+	private function onLeaderboardFound(success:Bool, data:Dynamic) {
+		if (whenLeaderboardFound != null) whenLeaderboardFound(data.board, success);
+	}
+
+	private function onScoreUploaded(success:Bool, data:Dynamic) {
+		var result = new LeaderboardUploadResult(data.request, data.board, success, data.score, data.scoreChanged, data.rankNew, data.rankPrevious, data.skipped);
+		var callback = uploadCallbacks.get(result.request);
+		if (callback != null) {
+			uploadCallbacks.remove(result.request);
+			callback(result);
+		}
+		if (whenScoreUploaded != null) whenScoreUploaded(result);
+	}
+
+	private function onScoresDownloaded(success:Bool, data:Dynamic) {
+		var request:Int = data.request;
+		var scores = success ? LeaderboardScore.listFromPacked(PackedReader.ofData(data.entries)) : null;
+		var callback = downloadCallbacks.get(request);
+		if (callback != null) {
+			downloadCallbacks.remove(request);
+			callback(scores);
+		}
+		if (whenScoresDownloaded != null) whenScoresDownloaded(request, data.board, scores);
+	}
+
+	private function onReplayAttached(success:Bool, data:Dynamic) {
+		var request:Int = data.request;
+		var handle:String = success ? data.handle : null;
+		var callback = attachCallbacks.get(request);
+		if (callback != null) {
+			attachCallbacks.remove(request);
+			callback(handle);
+		}
+		if (whenReplayAttached != null) whenReplayAttached(request, data.board, handle);
+	}
+
+	private function onReplayDownloaded(success:Bool, data:Dynamic) {
+		var request:Int = data.request;
+		var handle:String = data.handle;
+		var replay = success ? Bytes.ofData(data.data) : null;
+		var pending = replayCallbacks.get(request);
+		if (pending != null) {
+			if (--pending.remaining <= 0) replayCallbacks.remove(request);
+			pending.callback(handle, replay);
+		}
+		if (whenReplayDownloaded != null) whenReplayDownloaded(request, handle, replay);
+	}
+}
+
+class LeaderboardUploadResult
+{
+	public var request:Int;
+	public var board:Int;
+	public var success:Bool;
+	public var score:Int;
+	/** whether the board's entry for the user actually changed **/
+	public var scoreChanged:Bool;
+	public var rankNew:Int;
+	public var rankPrevious:Int;
+	/** true if the upload was skipped locally because it couldn't beat the user's best (ranks are 0 then) **/
+	public var skipped:Bool;
+
+	public function new(request:Int, board:Int, success:Bool, score:Int, scoreChanged:Bool, rankNew:Int, rankPrevious:Int, skipped:Bool = false)
+	{
+		this.request = request;
+		this.board = board;
+		this.success = success;
+		this.score = score;
+		this.scoreChanged = scoreChanged;
+		this.rankNew = rankNew;
+		this.rankPrevious = rankPrevious;
+		this.skipped = skipped;
+	}
+}
+
+@:enum
+abstract LeaderboardSortMethod(Int) from Int to Int
+{
+	var None = 0;
+	var Ascending = 1;
+	var Descending = 2;
+}
+
+@:enum
+abstract LeaderboardDisplayType(Int) from Int to Int
+{
+	var Numeric = 1;
+	var TimeSeconds = 2;
+	var TimeMilliSeconds = 3;
+}
+
+@:enum
+abstract LeaderboardState(Int) from Int to Int
+{
+	var Unknown = -1;
+	var Resolving = 0;
+	var Found = 1;
+	var Failed = 2;
+}
@@ -1,5 +1,7 @@
 package steamwrap.api;
+import steamwrap.api.Steam.PersonaName;
 import steamwrap.helpers.Loader;
+import steamwrap.helpers.PackedReader;
 import steamwrap.helpers.SteamBase;
 
 /**
@@ -90,6 +92,15 @@ class Matchmaking extends SteamBase {
 	}
 	private var SteamWrap_LobbyMemberID = Loader.loadRaw("SteamWrap_LobbyMemberID", 1);
 	
+	/**
+	 * Returns every member of the current lobby with their persona name, in one call.
+	 * Names Steam doesn't know yet are null and arrive through Steam.whenPersonaNamesResolved.
+	 */
+	public function getLobbyMemberNames():Array<PersonaName> {
+		return PersonaName.fromPacked(PackedReader.ofData(SteamWrap_LobbyMemberNames()));
+	}
+	private var SteamWrap_LobbyMemberNames = Loader.loadRaw("SteamWrap_LobbyMemberNames", 0);
+	
 	/**
 	 * Changes lobby data (which can then be used to display on lobby list).
 	 * Only lobby' owner can change lobby data.
@@ -2,6 +2,8 @@ package steamwrap.api;
 
 import cpp.Lib;
 import haxe.Int64;
+import haxe.io.Bytes;
+import haxe.io.BytesOutput;
 import steamwrap.api.Steam.EnumerateWorkshopFilesResult;
 import steamwrap.api.Steam.DownloadUGCResult;
 import steamwrap.api.Steam.GetItemInstallInfoResult;
@@ -9,6 +11,7 @@ import steamwrap.api.Steam.GetPublishedFileDetailsResult;
 import steamwrap.api.Steam.SteamUGCDetails;
 import steamwrap.api.Steam.SteamUGCQueryCompleted;
 import steamwrap.helpers.Loader;
+import steamwrap.helpers.PackedReader;
 import steamwrap.helpers.Util;
 
 private enum LeaderboardOp
@@ -84,10 +87,20 @@ class Steam
 	 */
 	public static var workshop(default, null):Workshop;
 	
+	/**
+	 * The native leaderboard manager: resolves boards in parallel and runs many uploads/downloads at once
+	 */
+	public static var leaderboards(default, null):Leaderboards;
+	
 	//User-settable callbacks:
 
 	public static var whenGamepadTextInputDismissed:String->Void;
 	public static var whenAchievementStored:String->Void;
+	public static var whenScheduledStatsStored:Int->Void;
+	public static var whenGlobalAchievementPercentagesReady:Bool->Void;
+	public static var whenStatsJournalReplayed:Int->Void;
+	/** Called once per frame at most, with every persona name that arrived since (see getPersonaNames()) **/
+	public static var whenPersonaNamesResolved:Array<PersonaName>->Void;
 	public static var whenLeaderboardScoreDownloaded:Array<LeaderboardScore>->Void;
 	public static var whenLeaderboardScoreUploaded:LeaderboardScore->Void;
 	public static var whenTrace:String->Void;
@@ -142,11 +155,27 @@ class Steam
 			SteamWrap_GetAchievementName = cpp.Lib.load("steamwrap", "SteamWrap_GetAchievementName", 1);
 			SteamWrap_GetSteamID = cpp.Lib.load("steamwrap", "SteamWrap_GetSteamID", 0);
 			SteamWrap_GetPersonaName = cpp.Lib.load("steamwrap", "SteamWrap_GetPersonaName", 0);
+			SteamWrap_GetFriendPersonaName = cpp.Lib.load("steamwrap", "SteamWrap_GetFriendPersonaName", 1);
+			SteamWrap_GetPersonaNames = cpp.Lib.load("steamwrap", "SteamWrap_GetPersonaNames", 1);
 			SteamWrap_SetStat = cpp.Lib.load("steamwrap", "SteamWrap_SetStat", 2);
 			SteamWrap_SetStatFloat = cpp.Lib.load("steamwrap", "SteamWrap_SetStatFloat", 2);
 			SteamWrap_SetStatInt = cpp.Lib.load("steamwrap", "SteamWrap_SetStatInt", 2);
 			SteamWrap_Shutdown = cpp.Lib.load("steamwrap", "SteamWrap_Shutdown", 0);
 			SteamWrap_StoreStats = cpp.Lib.load("steamwrap", "SteamWrap_StoreStats", 0);
+			SteamWrap_RegisterStat = cpp.Lib.load("steamwrap", "SteamWrap_RegisterStat", 2);
+			SteamWrap_IsStatCacheReady = cpp.Lib.load("steamwrap", "SteamWrap_IsStatCacheReady", 0);
+			SteamWrap_GetCachedStats = cpp.Lib.load("steamwrap", "SteamWrap_GetCachedStats", 2);
+			SteamWrap_SetCachedStats = cpp.Lib.load("steamwrap", "SteamWrap_SetCachedStats", 2);
+			SteamWrap_CommitStats = cpp.Lib.load("steamwrap", "SteamWrap_CommitStats", 1);
+			SteamWrap_RequestStoreStats = cpp.Lib.load("steamwrap", "SteamWrap_RequestStoreStats", 0);
+			SteamWrap_SetStoreStatsSchedule = cpp.Lib.load("steamwrap", "SteamWrap_SetStoreStatsSchedule", 3);
+			SteamWrap_GetAchievementSnapshot = cpp.Lib.load("steamwrap", "SteamWrap_GetAchievementSnapshot", 0);
+			SteamWrap_QueueAchievementProgress = cpp.Lib.load("steamwrap", "SteamWrap_QueueAchievementProgress", 3);
+			SteamWrap_SetAchievementProgressInterval = cpp.Lib.load("steamwrap", "SteamWrap_SetAchievementProgressInterval", 1);
+			SteamWrap_AddStatInt = cpp.Lib.load("steamwrap", "SteamWrap_AddStatInt", 2);
+			SteamWrap_SetStatsJournalPath = cpp.Lib.load("steamwrap", "SteamWrap_SetStatsJournalPath", 1);
+			SteamWrap_RequestGlobalStatsWithHistory = cpp.Lib.load("steamwrap", "SteamWrap_RequestGlobalStatsWithHistory", 1);
+			SteamWrap_GetGlobalStatHistory = cpp.Lib.load("steamwrap", "SteamWrap_GetGlobalStatHistory", 2);
 			SteamWrap_UploadScore = cpp.Lib.load("steamwrap", "SteamWrap_UploadScore", 3);
 			SteamWrap_RequestGlobalStats = cpp.Lib.load("steamwrap", "SteamWrap_RequestGlobalStats", 0);
 			SteamWrap_RestartAppIfNecessary = cpp.Lib.load("steamwrap", "SteamWrap_RestartAppIfNecessary", 1);
@@ -175,6 +204,7 @@ class Steam
 			workshop = new Workshop(appId, customTrace);
 			networking = new Networking(appId, customTrace);
 			matchmaking = new Matchmaking(appId, customTrace);
+			leaderboards = new Leaderboards(appId, customTrace);
 		}
 		else {
 			customTrace("Steam failed to activate");
@@ -304,6 +334,27 @@ class Steam
 		return val;
 	}
 	
+	/**
+	 * Returns the persona name of another user, as far as Steam knows it.
+	 * @param	steamID	the user's 64-bit Steam ID as a decimal string
+	 */
+	public static function getFriendPersonaName(steamID:String):String {
+		if (!active)
+			return "";
+		return SteamWrap_GetFriendPersonaName(steamID);
+	}
+	
+	/**
+	 * Looks up several users' persona names in the native cache in one call. Names Steam doesn't have yet
+	 * are requested in one go and come back as null here; they arrive together through
+	 * whenPersonaNamesResolved. Downloaded leaderboard scores and lobby members use the same cache.
+	 * @param	steamIDs	64-bit Steam IDs as decimal strings
+	 */
+	public static function getPersonaNames(steamIDs:Array<String>):Array<PersonaName> {
+		if (!active || steamIDs.length == 0) return [];
+		return PersonaName.fromPacked(PackedReader.ofData(SteamWrap_GetPersonaNames(steamIDs.join(","))));
+	}
+	
 	public static function getSteamID():String {
 		if (!active)
 			return "0";
@@ -314,6 +365,26 @@ class Steam
 		return active && report("indicateAchivevementProgress", [id, Std.string(curProgress), Std.string(maxProgress)], SteamWrap_IndicateAchievementProgress(id, curProgress, maxProgress));
 	}
 	
+	/**
+	 * Throttled version of indicateAchievementProgress(), safe to call every time a counter ticks.
+	 * Only the latest progress per achievement is kept, and at most one indicator per achievement is shown
+	 * per interval (see setAchievementProgressInterval()). Progress at or past maxProgress, or for an
+	 * achievement that's already unlocked, is suppressed, and queued progress is dropped once it unlocks.
+	 * @return	false if the indicator was suppressed
+	 */
+	public static function queueAchievementProgress(id:String, curProgress:Int, maxProgress:Int):Bool {
+		return active && SteamWrap_QueueAchievementProgress(id, curProgress, maxProgress);
+	}
+	
+	/**
+	 * Sets the minimum number of seconds between two progress indicators for the same achievement
+	 * shown through queueAchievementProgress(). Defaults to 2.
+	 */
+	public static function setAchievementProgressInterval(seconds:Float):Void {
+		if (!active) return;
+		SteamWrap_SetAchievementProgressInterval(seconds);
+	}
+	
 	public static function isAppInstalled(appId:Int):Bool {
 		if (!active)
 			return false;
@@ -415,6 +486,52 @@ class Steam
 		return SteamWrap_GetAchievementName(index);
 	}
 	
+	/**
+	 * Requests global stats again, including up to historyDays (max 60) of daily history.
+	 * Global stats (without history) are requested automatically by init(). Wait for the
+	 * GlobalStatsReceived event before calling getGlobalStatHistory().
+	 */
+	public static function requestGlobalStats(historyDays:Int = 0):Bool {
+		return active && report("requestGlobalStats", [Std.string(historyDays)], SteamWrap_RequestGlobalStatsWithHistory(historyDays));
+	}
+	
+	/**
+	 * Returns the total and daily history of several global stats in one native call.
+	 * @param	ids	Stat API names
+	 * @param	days	how many days of history to return at most (only as many as were requested are available)
+	 * @return	one entry per id, in the same order
+	 */
+	public static function getGlobalStatHistory(ids:Array<String>, days:Int):Array<GlobalStatHistory> {
+		var result = new Array<GlobalStatHistory>();
+		if (!active) return result;
+		var reader = PackedReader.ofData(SteamWrap_GetGlobalStatHistory(ids.join(","), days));
+		if (reader == null) return result;
+		var count = reader.readU32();
+		for (i in 0...count) {
+			result.push(GlobalStatHistory.fromPacked(reader));
+		}
+		return result;
+	}
+	
+	/**
+	 * Returns everything about every achievement in one native call: API name, unlock state and time,
+	 * display name, description, hidden flag and global unlock percentage.
+	 * The table is cached natively and only rebuilt after achievements change, so calling this every
+	 * time an achievements screen opens is cheap. Global percentages are requested on first use and
+	 * read -1 until whenGlobalAchievementPercentagesReady fires; call again then to pick them up.
+	 */
+	public static function getAchievementSnapshot():Array<AchievementInfo> {
+		var result = new Array<AchievementInfo>();
+		if (!active) return result;
+		var reader = PackedReader.ofData(SteamWrap_GetAchievementSnapshot());
+		if (reader == null) return result;
+		var count = reader.readU32();
+		for (i in 0...count) {
+			result.push(AchievementInfo.fromPacked(reader));
+		}
+		return result;
+	}
+	
 	/**
 	 * DEPRECATED: use setStatInt() instead!
 	 * 
@@ -447,10 +564,129 @@ class Steam
 		return active && report("setStatInt", [id, Std.string(val)], SteamWrap_SetStatInt(id, val));
 	}
 	
+	/**
+	 * Adds to an int stat without needing to know its current value.
+	 * Like the setStat functions and setAchievement(), this is journaled while Steam is offline and
+	 * applied on top of the server's value once the user's stats arrive again.
+	 * @param	id Stat API name
+	 * @param	delta
+	 * @return
+	 */
+	public static function addStatInt(id:String, delta:Int):Bool {
+		return active && report("addStatInt", [id, Std.string(delta)], SteamWrap_AddStatInt(id, delta));
+	}
+	
+	/**
+	 * Stat and achievement writes made while the user isn't logged on to Steam are kept in a journal and
+	 * replayed in one batch once they are (whenStatsJournalReplayed fires with the number of entries).
+	 * Set values only ever raise a stat on replay, so an offline session can't lower a value stored from
+	 * another machine; a set below a value already known (journaled or cached) returns false while offline.
+	 * Deltas are added to the server's value and unlocks are only applied once. Setting a path also keeps
+	 * the journal in that local file, so it survives a restart; entries left there by an earlier session
+	 * are picked up. The file is only emptied once the store carrying the replay succeeds; if the game
+	 * quits before that, the journal is replayed again next time, which is harmless for all but deltas.
+	 * Setting the same path again does nothing, setting a different one moves the journal there.
+	 * @param	path	local file to keep the journal in
+	 * @return	how many journal entries are waiting to be replayed
+	 */
+	public static function setStatsJournalPath(path:String):Int {
+		if (!active) return 0;
+		return SteamWrap_SetStatsJournalPath(path);
+	}
+	
 	public static function storeStats():Bool {
 		return active && report("storeStats", [], SteamWrap_StoreStats());
 	}
 	
+	/**
+	 * Asks for the stats to be stored, without going to the server right away. Requests are coalesced
+	 * natively: all of them within the schedule's window become one StoreStats (committing dirty cached
+	 * stats first), spaced at least minInterval apart, and stores that failed for a transient reason
+	 * (no connection, timeout, rate limit...) are retried with backoff.
+	 * Anything still pending is flushed by shutdown(). Safe to call as often as gameplay code likes.
+	 * whenScheduledStatsStored fires once per successful store with the number of requests it covered.
+	 */
+	public static function requestStoreStats():Bool {
+		return active && SteamWrap_RequestStoreStats();
+	}
+	
+	/**
+	 * Configures how requestStoreStats() coalesces stores.
+	 * @param	window	seconds to wait after the first request for more requests to fold in
+	 * @param	minInterval	minimum seconds between two stores
+	 * @param	maxBackoff	upper bound in seconds for the retry delay after failed stores
+	 */
+	public static function setStoreStatsSchedule(window:Float = 1, minInterval:Float = 5, maxBackoff:Float = 60):Void {
+		if (!active) return;
+		SteamWrap_SetStoreStatsSchedule(window, minInterval, maxBackoff);
+	}
+	
+	/**
+	 * Registers a stat with the native stats cache and returns its integer id for use with getStats(),
+	 * setStats() and commitStats(). Registering the same name twice returns the same id.
+	 * The cache is filled in once the user's stats have been received from Steam; stats registered
+	 * after that are read immediately. The by-name calls stay consistent with it: setStat*() and
+	 * addStatInt() update the cached value, getStat*() see values set but not committed yet, and
+	 * storeStats() commits dirty cached stats first.
+	 * @param	id	Stat API name
+	 * @param	isFloat	whether the stat is a FLOAT/AVGRATE stat rather than an INT stat
+	 * @return	the stat's id, or -1 on error
+	 */
+	public static function registerStat(id:String, isFloat:Bool = false):Int {
+		if (!active) return -1;
+		return SteamWrap_RegisterStat(id, isFloat);
+	}
+	
+	/**
+	 * Whether the stats cache has been filled in from Steam yet. Until then getStats() returns 0 for
+	 * every stat that hasn't been set locally.
+	 */
+	public static function isStatCacheReady():Bool {
+		return active && SteamWrap_IsStatCacheReady();
+	}
+	
+	/**
+	 * Reads a batch of cached stats in one native call. Int stats come back as whole Floats.
+	 * @param	ids	ids returned by registerStat()
+	 * @param	out	optional array to reuse for the results
+	 * @return	the values, in the same order as ids
+	 */
+	public static function getStats(ids:Array<Int>, ?out:Array<Float>):Array<Float> {
+		if (out == null) out = [];
+		if (!active) {
+			for (i in 0...ids.length) out[i] = 0;
+			return out;
+		}
+		if (ids.length > 0 && out.length < ids.length) out[ids.length - 1] = 0;
+		SteamWrap_GetCachedStats(ids, out);
+		return out;
+	}
+	
+	/**
+	 * Sets a batch of cached stats in one native call. Only stats whose value changed are marked dirty;
+	 * nothing reaches Steam until commitStats(). Values for int stats are truncated; NaN, infinities
+	 * and values outside the stat's range (Int32 or single-precision float) are skipped.
+	 * @param	ids	ids returned by registerStat()
+	 * @param	values	new values, in the same order as ids
+	 * @return	how many of the stats were set
+	 */
+	public static function setStats(ids:Array<Int>, values:Array<Float>):Int {
+		if (!active) return 0;
+		return SteamWrap_SetCachedStats(ids, values);
+	}
+	
+	/**
+	 * Writes every dirty cached stat to Steam.
+	 * @param	store	whether to also call StoreStats() afterwards
+	 * @return	how many stats were written, or -1 on failure
+	 */
+	public static function commitStats(store:Bool = true):Int {
+		if (!active) return -1;
+		var written:Int = SteamWrap_CommitStats(store);
+		report("commitStats", [Std.string(store)], written >= 0);
+		return written;
+	}
+	
 	public static function uploadLeaderboardScore(score:LeaderboardScore):Bool {
 		if (!active) return false;
 		var startProcessingNow = (leaderboardOps.length == 0);
@@ -513,8 +749,11 @@ class Steam
 				haveReceivedUserStats = success;
 				
 			case "UserStatsStored":
-				// retry next frame if failed
-				wantStoreStats = !success;
+				// retry next frame if failed, unless the store scheduler issued it and retries it itself
+				wantStoreStats = !success && data != "scheduled";
+				
+			case "ScheduledStatsStored":
+				if (whenScheduledStatsStored != null) whenScheduledStatsStored(Std.parseInt(data));
 				
 			case "UserAchievementStored":
 				if (whenAchievementStored != null) whenAchievementStored(data);
@@ -531,6 +770,17 @@ class Steam
 			
 			case "GlobalStatsReceived":
 				haveGlobalStats = success;
+			
+			case "PersonaNamesResolved":
+				if (whenPersonaNamesResolved != null) {
+					whenPersonaNamesResolved(PersonaName.fromPacked(PackedReader.ofData(obj), false));
+				}
+			
+			case "StatsJournalReplayed":
+				if (whenStatsJournalReplayed != null) whenStatsJournalReplayed(Std.parseInt(data));
+			
+			case "GlobalAchievementPercentagesReady":
+				if (whenGlobalAchievementPercentagesReady != null) whenGlobalAchievementPercentagesReady(success);
 				
 			case "LeaderboardFound":
 				if (success) {
@@ -539,17 +789,7 @@ class Steam
 				processNextLeaderboardOp();
 			case "ScoreDownloaded":
 				if (success) {
-					var rawScores = data.split(";");
-					var processedScores:Array<LeaderboardScore> = new Array<LeaderboardScore>();
-					
-					for (score in rawScores) 
-					{
-						var processedScore = LeaderboardScore.fromString(score);
-						if (processedScore != null) 
-						{
-							processedScores.push(processedScore);
-						}
-					}
+					var processedScores = LeaderboardScore.listFromPacked(PackedReader.ofData(obj));
 					
 					if (whenLeaderboardScoreDownloaded != null) 
 					{						
@@ -621,6 +861,39 @@ class Steam
 					var result = SteamUGCQueryCompleted.fromString(data);
 					whenQueryUGCRequestSent(result);
 				}
+			case "UGCCursorPage":
+				ugc.onCursorPage(success, obj);
+			case "UGCDetailsRefreshed":
+				ugc.onDetailsRefreshed(success, obj);
+			case "UGCDetailsQueried":
+				ugc.onDetailsQueried(success, obj);
+			case "WorkshopDownloadProgress":
+				ugc.onDownloadProgress(success, obj);
+			case "WorkshopDownloadFinished":
+				ugc.onDownloadFinished(success, obj);
+			case "WorkshopIndexed":
+				ugc.onItemsIndexed(success, obj);
+			case "WorkshopFilesUnmapped":
+				ugc.onFilesUnmapped(success, obj);
+			case "UGCItemPublished":
+				ugc.onItemPublished(success, obj);
+			case "UGCBatchPublished":
+				ugc.onBatchPublished(success, obj);
+			case "UGCStreamProgress":
+				workshop.onUGCReadToFileProgress(success, obj);
+			case "UGCStreamFinished":
+				workshop.onUGCReadToFileFinished(success, obj);
+				
+			case "ManagedLeaderboardFound":
+				leaderboards.onLeaderboardFound(success, obj);
+			case "ManagedScoreUploaded":
+				leaderboards.onScoreUploaded(success, obj);
+			case "ManagedScoresDownloaded":
+				leaderboards.onScoresDownloaded(success, obj);
+			case "ReplayAttached":
+				leaderboards.onReplayAttached(success, obj);
+			case "ReplayDownloaded":
+				leaderboards.onReplayDownloaded(success, obj);
 				
 			case "LobbyCreated":
 				if (matchmaking.whenLobbyCreated != null) matchmaking.whenLobbyCreated(success);
@@ -654,9 +927,25 @@ class Steam
 	private static var SteamWrap_GetAchievementName:Int->String;
 	private static var SteamWrap_GetSteamID:Void->String;
 	private static var SteamWrap_GetPersonaName:Void->String;
+	private static var SteamWrap_GetFriendPersonaName:String->String;
+	private static var SteamWrap_GetPersonaNames:String->haxe.io.BytesData;
 	private static var SteamWrap_ClearAchievement:Dynamic;
 	private static var SteamWrap_IndicateAchievementProgress:Dynamic;
 	private static var SteamWrap_StoreStats:Dynamic;
+	private static var SteamWrap_RegisterStat:String->Bool->Int;
+	private static var SteamWrap_IsStatCacheReady:Void->Bool;
+	private static var SteamWrap_GetCachedStats:Array<Int>->Array<Float>->Bool;
+	private static var SteamWrap_SetCachedStats:Array<Int>->Array<Float>->Int;
+	private static var SteamWrap_CommitStats:Bool->Int;
+	private static var SteamWrap_RequestStoreStats:Void->Bool;
+	private static var SteamWrap_SetStoreStatsSchedule:Float->Float->Float->Bool;
+	private static var SteamWrap_GetAchievementSnapshot:Void->haxe.io.BytesData;
+	private static var SteamWrap_QueueAchievementProgress:String->Int->Int->Bool;
+	private static var SteamWrap_SetAchievementProgressInterval:Float->Bool;
+	private static var SteamWrap_AddStatInt:String->Int->Bool;
+	private static var SteamWrap_SetStatsJournalPath:String->Int;
+	private static var SteamWrap_RequestGlobalStatsWithHistory:Int->Bool;
+	private static var SteamWrap_GetGlobalStatHistory:String->Int->haxe.io.BytesData;
 	private static var SteamWrap_FindLeaderboard:Dynamic;
 	private static var SteamWrap_UploadScore:String->Int->Int->Bool;
 	private static var SteamWrap_DownloadScores:String->Int->Int->Int->Bool;
@@ -678,14 +967,33 @@ class LeaderboardScore {
 	public var score:Int;
 	public var detail:Int;
 	public var rank:Int;
-	public var name:String;
+	/** The user's persona name. For downloaded scores this is only looked up the first time it's read. **/
+	public var name(get, set):String;
+	/** The user's 64-bit Steam ID as a decimal string, "0" if not known **/
+	public var steamID:String = "0";
+	/** Every detail value stored with the score; detail is the first of these **/
+	public var details:Array<Int>;
+	/** Handle of the UGC file attached to the entry, "0" if there is none **/
+	public var ugcHandle:String = "0";
+
+	private var _name:String;
 
 	public function new(leaderboardId_:String, name_:String, score_:Int, detail_:Int, rank_:Int=-1) {
 		leaderboardId = leaderboardId_;
 		score = score_;
 		detail = detail_;
 		rank = rank_;
-		name = name_;
+		_name = name_;
+		details = [detail_];
+	}
+
+	private function get_name():String {
+		if (_name == null && steamID != "0") _name = Steam.getFriendPersonaName(steamID);
+		return _name;
+	}
+
+	private function set_name(value:String):String {
+		return _name = value;
 	}
 
 	public function toString():String {
@@ -700,6 +1008,122 @@ class LeaderboardScore {
 		else
 			return null;
 	}
+
+	/**
+	 * Reads a downloaded page of scores: the leaderboard name, then every entry.
+	 */
+	public static function listFromPacked(reader:PackedReader):Array<LeaderboardScore> {
+		var result = new Array<LeaderboardScore>();
+		if (reader == null) return result;
+		var leaderboardId = reader.readStr();
+		var count = reader.readU32();
+		for (i in 0...count) {
+			result.push(fromPacked(reader, leaderboardId));
+		}
+		return result;
+	}
+
+	public static function fromPacked(reader:PackedReader, leaderboardId:String):LeaderboardScore {
+		var steamID = reader.readU64String();
+		var rank = reader.readInt32();
+		var score = reader.readInt32();
+		var detailCount = reader.readU32();
+		var details = [for (i in 0...detailCount) reader.readInt32()];
+		var result = new LeaderboardScore(leaderboardId, null, score, detailCount > 0 ? details[0] : 0, rank);
+		result.steamID = steamID;
+		result.details = details;
+		result.ugcHandle = reader.readU64String();
+		var name = reader.readStr();
+		if (name != "") result.name = name;
+		return result;
+	}
+}
+
+class PersonaName {
+	public var id:SteamID;
+	/** null while Steam is still looking the name up **/
+	public var name:String;
+
+	public function new(id_:SteamID, name_:String) {
+		id = id_;
+		name = name_;
+	}
+
+	public static function fromPacked(reader:PackedReader, withKnownFlag:Bool = true):Array<PersonaName> {
+		var result = new Array<PersonaName>();
+		if (reader == null) return result;
+		var count = reader.readU32();
+		for (i in 0...count) {
+			var id:SteamID = reader.readU64String();
+			var known = withKnownFlag ? reader.readBool() : true;
+			var name = reader.readStr();
+			result.push(new PersonaName(id, known ? name : null));
+		}
+		return result;
+	}
+}
+
+class AchievementInfo {
+	public var apiName:String;
+	public var unlocked:Bool;
+	/** Unix time of the unlock, 0 if locked **/
+	public var unlockTime:Float;
+	public var name:String;
+	public var description:String;
+	public var hidden:Bool;
+	/** Percentage of players who unlocked it, -1 if not known (yet) **/
+	public var globalPercent:Float;
+
+	public function new() {}
+
+	public static function fromPacked(reader:PackedReader):AchievementInfo {
+		var info = new AchievementInfo();
+		info.apiName = reader.readStr();
+		info.unlocked = reader.readBool();
+		info.unlockTime = reader.readU32Float();
+		info.name = reader.readStr();
+		info.description = reader.readStr();
+		info.hidden = reader.readBool();
+		info.globalPercent = reader.readFloat();
+		return info;
+	}
+}
+
+class GlobalStatHistory {
+	public var id:String;
+	/** false if Steam has no global data for this stat **/
+	public var available:Bool;
+	public var isFloat:Bool;
+	public var total:Float;
+	/** daily values, most recent day first **/
+	public var history:Array<Float>;
+
+	public function new(id_:String) {
+		id = id_;
+		available = false;
+		isFloat = false;
+		total = 0;
+		history = [];
+	}
+
+	public static function fromPacked(reader:PackedReader):GlobalStatHistory {
+		var stat = new GlobalStatHistory(reader.readStr());
+		var type = reader.readU8();
+		if (type == 0) return stat;
+		stat.available = true;
+		stat.isFloat = (type == 2);
+		stat.total = stat.isFloat ? reader.readDouble() : readInt64(reader);
+		var count = reader.readU32();
+		for (i in 0...count) {
+			stat.history.push(stat.isFloat ? reader.readDouble() : readInt64(reader));
+		}
+		return stat;
+	}
+
+	private static inline function readInt64(reader:PackedReader):Float {
+		var v = reader.readI64();
+		return v.high * 4294967296.0 + (v.low >= 0 ? v.low : v.low + 4294967296.0);
+	}
 }
 
 class EnumerateUserSubscribedFilesResult extends EnumerateUserPublishedFilesResult
@@ -921,6 +1345,227 @@ class DownloadUGCResult
 	}
 }
 
+class ItemDownloadProgress {
+	public var fileID:String;
+	public var state:EItemDownloadState;
+	public var priority:Int;
+	/** how many times the download was started, retries included **/
+	public var attempts:Int;
+	public var bytesDownloaded:Float;
+	/** 0 until Steam knows the size **/
+	public var bytesTotal:Float;
+
+	public function new() {}
+
+	public static function fromPacked(reader:PackedReader):Array<ItemDownloadProgress> {
+		var result = new Array<ItemDownloadProgress>();
+		if (reader == null) return result;
+		var count = reader.readU32();
+		for (i in 0...count) {
+			var p = new ItemDownloadProgress();
+			p.fileID = reader.readU64String();
+			p.state = reader.readU8();
+			p.priority = reader.readInt32();
+			p.attempts = reader.readU32();
+			p.bytesDownloaded = reader.readU64Float();
+			p.bytesTotal = reader.readU64Float();
+			result.push(p);
+		}
+		return result;
+	}
+}
+
+class SubscribedItemInfo {
+	public var fileID:String;
+	public var state:EItemState;
+	public var bytesDownloaded:Float;
+	public var bytesTotal:Float;
+	public var sizeOnDisk:Float;
+	/** "" unless the item is installed **/
+	public var folder:String;
+	public var timeStamp:Float;
+
+	public function new() {}
+
+	public static function fromPacked(reader:PackedReader):Array<SubscribedItemInfo> {
+		var result = new Array<SubscribedItemInfo>();
+		if (reader == null) return result;
+		var count = reader.readU32();
+		for (i in 0...count) {
+			var info = new SubscribedItemInfo();
+			info.fileID = reader.readU64String();
+			info.state = reader.readU32();
+			info.bytesDownloaded = reader.readU64Float();
+			info.bytesTotal = reader.readU64Float();
+			info.sizeOnDisk = reader.readU64Float();
+			info.timeStamp = reader.readU32Float();
+			info.folder = reader.readStr();
+			result.push(info);
+		}
+		return result;
+	}
+}
+
+class IndexedWorkshopFile {
+	/** relative to the item's install folder, '/'-separated **/
+	public var path:String;
+	public var size:Float;
+	/** only meant for comparing; the unit depends on the platform **/
+	public var mtime:Float;
+	/** chained xxHash64 of the content **/
+	public var hash:Int64;
+
+	public function new() {}
+}
+
+class IndexedWorkshopItem {
+	public var fileID:String;
+	/** false if the install timestamp was unchanged and the folder wasn't looked at **/
+	public var rescanned:Bool;
+	public var timeStamp:Float;
+	public var folder:String;
+	public var files:Array<IndexedWorkshopFile>;
+
+	public function new() {}
+
+	public static function fromPacked(reader:PackedReader):Array<IndexedWorkshopItem> {
+		var result = new Array<IndexedWorkshopItem>();
+		if (reader == null) return result;
+		var count = reader.readU32();
+		for (i in 0...count) {
+			var item = new IndexedWorkshopItem();
+			item.fileID = reader.readU64String();
+			item.rescanned = reader.readBool();
+			item.timeStamp = reader.readU32Float();
+			item.folder = reader.readStr();
+			item.files = [];
+			var fileCount = reader.readU32();
+			for (k in 0...fileCount) {
+				var file = new IndexedWorkshopFile();
+				file.path = reader.readStr();
+				file.size = reader.readU64Float();
+				file.mtime = reader.readU64Float();
+				file.hash = reader.readI64();
+				item.files.push(file);
+			}
+			result.push(item);
+		}
+		return result;
+	}
+}
+
+/**
+ * One item of a UGC.publishItems() batch. Fields left null aren't touched on the Workshop.
+ */
+class UGCPublishItem {
+	/** the item to update, or null to create a new one **/
+	public var fileID:String;
+	public var title:String;
+	public var description:String;
+	public var metadata:String;
+	/** comma-separated **/
+	public var tags:String;
+	public var visibility:Null<EPublishedFileVisibility>;
+	/** absolute path of the content folder **/
+	public var contentPath:String;
+	/** absolute path of the preview image **/
+	public var previewPath:String;
+	public var changeNote:String;
+	/** replace the values of these keys **/
+	public var keyValueTags:Map<String, String>;
+
+	public function new(?fileID:String) {
+		this.fileID = fileID;
+	}
+
+	public static function toPacked(items:Array<UGCPublishItem>):Bytes {
+		var out = new BytesOutput();
+		out.bigEndian = false;
+		out.writeInt32(items.length);
+		for (item in items) {
+			var fields = (item.title != null ? 1 : 0) | (item.description != null ? 2 : 0) | (item.metadata != null ? 4 : 0) |
+				(item.tags != null ? 8 : 0) | (item.visibility != null ? 16 : 0) | (item.contentPath != null ? 32 : 0) |
+				(item.previewPath != null ? 64 : 0) | (item.keyValueTags != null ? 128 : 0);
+			writeStr(out, item.fileID);
+			out.writeInt32(fields);
+			writeStr(out, item.title);
+			writeStr(out, item.description);
+			writeStr(out, item.metadata);
+			writeStr(out, item.tags);
+			out.writeInt32(item.visibility != null ? (item.visibility:Int) : 0);
+			writeStr(out, item.contentPath);
+			writeStr(out, item.previewPath);
+			writeStr(out, item.changeNote);
+			var keys = item.keyValueTags != null ? [for (key in item.keyValueTags.keys()) key] : [];
+			out.writeInt32(keys.length);
+			for (key in keys) {
+				writeStr(out, key);
+				writeStr(out, item.keyValueTags.get(key));
+			}
+		}
+		return out.getBytes();
+	}
+
+	private static function writeStr(out:BytesOutput, str:String) {
+		var bytes = Bytes.ofString(str != null ? str : "");
+		out.writeInt32(bytes.length);
+		out.write(bytes);
+	}
+}
+
+class UGCPublishResult {
+	/** the new item's ID for created items; null if creating it failed **/
+	public var fileID:String;
+	public var result:EResult;
+	public var needsLegalAgreement:Bool;
+
+	public function new() {}
+
+	public static function fromPacked(reader:PackedReader):Array<UGCPublishResult> {
+		var results = new Array<UGCPublishResult>();
+		if (reader == null) return results;
+		var count = reader.readU32();
+		for (i in 0...count) {
+			var r = new UGCPublishResult();
+			r.fileID = reader.readU64String();
+			if (r.fileID == "0") r.fileID = null;
+			r.result = reader.readInt32();
+			r.needsLegalAgreement = reader.readBool();
+			results.push(r);
+		}
+		return results;
+	}
+}
+
+class UGCPublishProgress {
+	public var batch:Int;
+	/** position of the item in its batch **/
+	public var index:Int;
+	public var fileID:String;
+	public var status:EItemUpdateStatus;
+	public var bytesProcessed:Float;
+	public var bytesTotal:Float;
+
+	public function new() {}
+
+	public static function fromPacked(reader:PackedReader):Array<UGCPublishProgress> {
+		var result = new Array<UGCPublishProgress>();
+		if (reader == null) return result;
+		var count = reader.readU32();
+		for (i in 0...count) {
+			var p = new UGCPublishProgress();
+			p.batch = reader.readInt32();
+			p.index = reader.readU32();
+			p.fileID = reader.readU64String();
+			p.status = reader.readU32();
+			p.bytesProcessed = reader.readU64Float();
+			p.bytesTotal = reader.readU64Float();
+			result.push(p);
+		}
+		return result;
+	}
+}
+
 class GetItemInstallInfoResult
 {
 	public var sizeOnDisk:Int;
@@ -1223,6 +1868,12 @@ class SteamUGCDetails
 	/** collection details **/
 	public var numChildren:Int = 0;
 	
+	/** developer metadata, if the query asked for it (packed results only) **/
+	public var metadata:String = "";
+	
+	/** [key, value] pairs, if the query asked for them (packed results only) **/
+	public var keyValueTags:Array<Array<String>> = [];
+	
 	public function new(
 		PublishedFileId:String = "",
 		Result:EResult = EResult.Fail,
@@ -1280,6 +1931,59 @@ class SteamUGCDetails
 		numChildren = NumChildren;
 	}
 	
+	/**
+	 * Reads a packed table of results (see UGC.getQueryUGCResults): header, string pool, then one row per result.
+	 */
+	public static function listFromPacked(reader:PackedReader):Array<SteamUGCDetails> {
+		var result = new Array<SteamUGCDetails>();
+		if (reader == null) return result;
+		var count = reader.readU32();
+		var flags = reader.readU8();
+		var pool = reader.read(reader.readU32());
+		for (i in 0...count) {
+			result.push(fromPacked(reader, pool, flags));
+		}
+		return result;
+	}
+	
+	public static function fromPacked(reader:PackedReader, pool:Bytes, flags:Int):SteamUGCDetails {
+		var d = new SteamUGCDetails();
+		d.publishedFileId = reader.readU64String();
+		d.result = reader.readU32();
+		d.fileType = reader.readU32();
+		d.creatorAppID = Std.string(reader.readU32Float());
+		d.consumerAppID = Std.string(reader.readU32Float());
+		d.steamIDOwner = reader.readU64String();
+		d.timeCreated = reader.readU32Float();
+		d.timeUpdated = reader.readU32Float();
+		d.timeAddedToUserList = reader.readU32Float();
+		d.visibility = reader.readU32();
+		d.banned = reader.readBool();
+		d.acceptedForUse = reader.readBool();
+		d.tagsTruncated = reader.readBool();
+		d.file = reader.readU64String();
+		d.previewFile = reader.readU64String();
+		d.fileSize = reader.readInt32();
+		d.previewFileSize = reader.readInt32();
+		d.votesUp = reader.readU32();
+		d.votesDown = reader.readU32();
+		d.score = reader.readFloat();
+		d.numChildren = reader.readU32();
+		d.title = reader.readPooled(pool);
+		d.description = reader.readPooled(pool);
+		d.tags = reader.readPooled(pool);
+		d.url = reader.readPooled(pool);
+		d.fileName = reader.readPooled(pool);
+		if (flags & 1 != 0) {
+			d.metadata = reader.readPooled(pool);
+		}
+		if (flags & 2 != 0) {
+			var kvCount = reader.readU32();
+			d.keyValueTags = [for (i in 0...kvCount) [reader.readPooled(pool), reader.readPooled(pool)]];
+		}
+		return d;
+	}
+	
 	public static function fromString(str:String):SteamUGCDetails{
 		var PublishedFileId:String = "";
 		var Result:EResult = EResult.Fail;
@@ -1718,6 +2422,45 @@ class SteamUGCDetails
 	}
 }
 
+@:enum abstract EItemUpdateStatus(Int) from Int to Int
+{
+	/**the update handle is invalid, or the update is done**/
+	var Invalid					= 0;
+	
+	/**processing the configuration data**/
+	var PreparingConfig			= 1;
+	
+	/**reading and processing the content files**/
+	var PreparingContent		= 2;
+	
+	/**uploading content changes to Steam**/
+	var UploadingContent		= 3;
+	
+	/**uploading the new preview file image**/
+	var UploadingPreviewFile	= 4;
+	
+	/**committing all changes**/
+	var CommittingChanges		= 5;
+}
+
+/**
+ * Where an item is in the download manager (see UGC.queueDownload())
+ */
+@:enum abstract EItemDownloadState(Int) from Int to Int
+{
+	/**not queued, cancelled, or finished (see UGC.whenDownloadFinished)**/
+	var Unknown			= -1;
+	
+	/**waiting for a download slot**/
+	var Queued			= 0;
+	
+	/**DownloadItem() was called and the result hasn't come back yet**/
+	var Active			= 1;
+	
+	/**the last attempt failed, another one is scheduled**/
+	var WaitingRetry	= 2;
+}
+
 @:enum abstract EUGCQuery(Int) from Int to Int
 {
 	var RankedByVote:Int									= 0;
@@ -1,8 +1,11 @@
 package steamwrap.api;
 import cpp.Lib;
+import haxe.io.Bytes;
+import haxe.io.BytesData;
 import steamwrap.api.Steam;
 import steamwrap.helpers.Loader;
 import steamwrap.helpers.MacroHelper;
+import steamwrap.helpers.PackedReader;
 
 /**
  * The User Generated Content API. Used by API.hx, should never be created manually by the user.
@@ -11,6 +14,7 @@ import steamwrap.helpers.MacroHelper;
  */
 
 @:allow(steamwrap.api.Steam)
+@:allow(steamwrap.api.UGCQueryCursor)
 class UGC
 {
 	/*************PUBLIC***************/
@@ -20,6 +24,53 @@ class UGC
 	 */
 	public var active(default, null):Bool = false;
 	
+	/**
+	 * Called for every finished refreshDetails() (after its own onComplete, if any): request id, how many items were
+	 * queried, details of all the items
+	 */
+	public var whenDetailsRefreshed:Int->Int->Array<SteamUGCDetails>->Void;
+	
+	/**
+	 * Called for every finished queryDetails() (after its own onComplete, if any): request id, success (false if
+	 * any item couldn't be fetched), details of every item that came back
+	 */
+	public var whenDetailsQueried:Int->Bool->Array<SteamUGCDetails>->Void;
+	
+	/**
+	 * Called at most once per download progress interval while queued downloads are pending, with the overall
+	 * bytes downloaded and total of everything in flight and every pending item's progress
+	 */
+	public var whenDownloadProgress:Float->Float->Array<ItemDownloadProgress>->Void;
+	
+	/**
+	 * Called when a queued download is done for good: file ID, success, the last EResult. The download manager
+	 * forgets the item then, so getDownloadState() returns Unknown for it afterwards.
+	 */
+	public var whenDownloadFinished:String->Bool->EResult->Void;
+	
+	/**
+	 * Called for every finished indexInstalledItems() (after its own onComplete, if any): request id, success (false
+	 * if any folder couldn't be read), the index of every installed item asked for
+	 */
+	public var whenItemsIndexed:Int->Bool->Array<IndexedWorkshopItem>->Void;
+	
+	/**
+	 * Called when an item that had mapped files starts downloading or updating, or is unsubscribed or uninstalled:
+	 * file ID, the handles that were unmapped (and can't be read anymore)
+	 */
+	public var whenFilesUnmapped:String->Array<Int>->Void;
+	
+	/**
+	 * Called as each item of a publishItems() batch is done: batch id, index of the item in the batch, result
+	 */
+	public var whenItemPublished:Int->Int->UGCPublishResult->Void;
+	
+	/**
+	 * Called for every finished publishItems() batch (after its own onComplete, if any): batch id, success (false if
+	 * any item failed), the result of every item in manifest order
+	 */
+	public var whenBatchPublished:Int->Bool->Array<UGCPublishResult>->Void;
+	
 	//TODO: these all need documentation headers
 	
 	public function createItem():Void {
@@ -72,6 +123,29 @@ class UGC
 		return SteamWrap_SubmitUGCItemUpdate(updateHandle, changeNotes);
 	}
 	
+	/**
+	 * Creates (where fileID is null) and updates a batch of items, with at most maxConcurrent of them in flight at
+	 * once. Unlike createItem()/submitItemUpdate(), any number of batches can run side by side.
+	 * @param	items
+	 * @param	maxConcurrent
+	 * @param	onComplete	called with the result of every item, in the same order as items
+	 * @return	the batch id, or -1 on error
+	 */
+	public function publishItems(items:Array<UGCPublishItem>, maxConcurrent:Int = 4, ?onComplete:Array<UGCPublishResult>->Void):Int {
+		if (!active || items.length == 0) return -1;
+		var batch:Int = SteamWrap_PublishUGCBatch(appId, UGCPublishItem.toPacked(items).getData(), maxConcurrent);
+		if (batch >= 0 && onComplete != null) publishCallbacks.set(batch, onComplete);
+		return batch;
+	}
+	
+	/**
+	 * Upload progress of every item currently being submitted by publishItems(), across all batches.
+	 */
+	public function getPublishProgress():Array<UGCPublishProgress> {
+		if (!active) return [];
+		return UGCPublishProgress.fromPacked(PackedReader.ofData(SteamWrap_GetUGCPublishProgress()));
+	}
+	
 	public function getNumSubscribedItems():Int {
 		return SteamWrap_GetNumSubscribedItems.call(0);
 	}
@@ -92,6 +166,44 @@ class UGC
 		return result == 1;
 	}
 	
+	/**
+	 * Adds an item to the download manager. Higher priorities start first (and positive ones are asked of Steam as
+	 * high priority); at most maxActive downloads run at once, and failed ones are retried (see
+	 * setDownloadOptions()). Queuing an item that's already pending just changes its priority.
+	 * @param	fileID
+	 * @param	priority
+	 * @return	false if the id is invalid
+	 */
+	public function queueDownload(fileID:String, priority:Int = 0):Bool {
+		if (!active) return false;
+		return SteamWrap_QueueItemDownload.call(fileID, priority) == 1;
+	}
+	
+	/**
+	 * Takes an item out of the download manager. A download Steam already started carries on, it just isn't tracked.
+	 * @return	false if the item wasn't queued
+	 */
+	public function cancelDownload(fileID:String):Bool {
+		if (!active) return false;
+		return SteamWrap_CancelItemDownload.call(fileID) == 1;
+	}
+	
+	public function getDownloadState(fileID:String):EItemDownloadState {
+		if (!active) return EItemDownloadState.Unknown;
+		return SteamWrap_GetItemDownloadState.call(fileID);
+	}
+	
+	/**
+	 * @param	maxActive	how many downloads to run at once
+	 * @param	maxAttempts	how many times to try each download before giving up
+	 * @param	retryDelay	seconds to wait before the first retry; doubles, triples... for the following ones
+	 * @param	progressInterval	seconds between whenDownloadProgress calls
+	 */
+	public function setDownloadOptions(maxActive:Int = 2, maxAttempts:Int = 3, retryDelay:Float = 5, progressInterval:Float = 0.5):Void {
+		if (!active) return;
+		SteamWrap_SetDownloadManagerOptions.call(maxActive, maxAttempts, retryDelay, progressInterval);
+	}
+	
 	/**
 	 * Filter query results to only those that include this tag
 	 * @param	queryHandle
@@ -175,11 +287,94 @@ class UGC
 		return [ai, bi];
 	}
 	
+	/**
+	 * Gets the state, download progress and install info of every subscribed item in one call, rather than one
+	 * getItemState()/getItemDownloadInfo()/getItemInstallInfo() round trip per item.
+	 */
+	public function getSubscribedItemsInfo():Array<SubscribedItemInfo>{
+		if (!active) return [];
+		return SubscribedItemInfo.fromPacked(PackedReader.ofData(SteamWrap_GetSubscribedItemsInfo()));
+	}
+	
 	public function getItemInstallInfo(fileID:String):GetItemInstallInfoResult{
 		var result = SteamWrap_GetItemInstallInfo(fileID, 30000);
 		return GetItemInstallInfoResult.fromString(result);
 	}
 	
+	/**
+	 * Loads the content index from a file, and saves it there whenever it changes.
+	 * @param	path
+	 * @return	how many items the index holds
+	 */
+	public function setContentIndexPath(path:String):Int {
+		if (!active) return 0;
+		return SteamWrap_SetWorkshopIndexPath.call(path);
+	}
+	
+	/**
+	 * Brings the content index (path, size, mtime and hash of every file) of the given installed items up to date.
+	 * Items whose install timestamp hasn't changed are skipped, the others are walked on worker threads and only
+	 * files whose size or mtime changed are hashed again. Items that aren't installed are dropped from the index.
+	 * @param	fileIDs
+	 * @param	threads	how many folders to walk at once, 0 for one per core
+	 * @param	onComplete	called with the index of every installed item asked for
+	 * @return	the request id, or -1 on error
+	 */
+	public function indexInstalledItems(fileIDs:Array<String>, threads:Int = 0, ?onComplete:Array<IndexedWorkshopItem>->Void):Int {
+		if (!active) return -1;
+		var request:Int = SteamWrap_IndexWorkshopItems(fileIDs.join(","), threads);
+		if (request >= 0 && onComplete != null) indexCallbacks.set(request, onComplete);
+		return request;
+	}
+	
+	/**
+	 * Memory-maps a file inside an installed item's folder, read-only. Nothing is loaded up front; the parts read
+	 * with readMappedFile()/readMappedFileInto() are paged in as needed. Every map of an item is released as soon as
+	 * Steam may start replacing or removing its files (see whenFilesUnmapped).
+	 * @param	fileID	the installed item
+	 * @param	path	the file, relative to the item's install folder
+	 * @return	the handle, or -1 if the item isn't installed or the file can't be mapped
+	 */
+	public function mapInstalledFile(fileID:String, path:String):Int {
+		if (!active) return -1;
+		return SteamWrap_MapWorkshopFile.call(fileID, path);
+	}
+	
+	public function unmapFile(handle:Int):Void {
+		if (!active) return;
+		SteamWrap_UnmapWorkshopFile.call(handle);
+	}
+	
+	/**
+	 * @return	the size of a mapped file in bytes, or -1 if the handle isn't mapped
+	 */
+	public function getMappedFileSize(handle:Int):Float {
+		if (!active) return -1;
+		return SteamWrap_GetMappedFileSize(handle);
+	}
+	
+	/**
+	 * Copies a slice of a mapped file out.
+	 * @param	handle
+	 * @param	offset
+	 * @param	length	shortened if it runs past the end of the file
+	 * @return	the bytes, or null if the handle isn't mapped or offset is past the end
+	 */
+	public function readMappedFile(handle:Int, offset:Float, length:Int):Bytes {
+		if (!active) return null;
+		var data:BytesData = SteamWrap_ReadMappedFile(handle, offset, length);
+		return data == null ? null : Bytes.ofData(data);
+	}
+	
+	/**
+	 * Copies a slice of a mapped file into existing bytes, so one buffer can be reused for every read.
+	 * @return	how many bytes were copied, or -1 on error
+	 */
+	public function readMappedFileInto(handle:Int, offset:Float, length:Int, into:Bytes, pos:Int = 0):Int {
+		if (!active) return -1;
+		return SteamWrap_ReadMappedFileInto(handle, offset, length, into.getData(), pos);
+	}
+	
 	/*
 	 * Query UGC associated with a user. Creator app id or consumer app id must be valid and be set to the current running app. Page should start at 1.
 	 */
@@ -206,7 +401,8 @@ class UGC
 	}
 	
 	/**
-	 * Query for the details of the given published file ids
+	 * Query for the details of the given published file ids. Steam only returns a page (50) of results per query;
+	 * use queryDetails() for any number of items.
 	 * @param	fileIDs
 	 * @return
 	 */
@@ -239,6 +435,21 @@ class UGC
 		return details;
 	}
 	
+	/**
+	 * Retrieve all results of a completed query at once. Unlike getQueryUGCResult(), which makes a native call and
+	 * parses a string per result, this is a single call that returns a packed table.
+	 * @param	handle
+	 * @param	count	numResultsReturned from the query's SteamUGCQueryCompleted
+	 * @param	withMetadata	also fill in metadata (the query must have setReturnMetadata(true))
+	 * @param	withKeyValueTags	also fill in keyValueTags (the query must have setReturnKeyValueTags(true))
+	 * @return
+	 */
+	public function getQueryUGCResults(handle:String, count:Int, withMetadata:Bool = false, withKeyValueTags:Bool = false):Array<SteamUGCDetails>
+	{
+		var result = SteamWrap_GetQueryUGCResults(handle, count, withMetadata, withKeyValueTags);
+		return SteamUGCDetails.listFromPacked(PackedReader.ofData(result));
+	}
+	
 	/**
 	 * 
 	 * @param	handle
@@ -275,11 +486,100 @@ class UGC
 		return result == 1;
 	}
 	
+	/**
+	 * Queries the details of any number of items. The ids are split into page-sized queries natively, at most
+	 * maxConcurrent of them run at once, and the results come back merged into one list in the order asked for.
+	 * @param	fileIDs
+	 * @param	withMetadata
+	 * @param	withKeyValueTags
+	 * @param	maxConcurrent	how many queries may be in flight at once
+	 * @param	onComplete	called with the details of every item that came back
+	 * @return	the request id, or -1 on error
+	 */
+	public function queryDetails(fileIDs:Array<String>, withMetadata:Bool = false, withKeyValueTags:Bool = false, maxConcurrent:Int = 4, ?onComplete:Array<SteamUGCDetails>->Void):Int
+	{
+		if (!active) return -1;
+		var request:Int = SteamWrap_QueryUGCDetails(fileIDs.join(","), (withMetadata ? 1 : 0) | (withKeyValueTags ? 2 : 0), maxConcurrent);
+		if (request >= 0 && onComplete != null) queryCallbacks.set(request, onComplete);
+		return request;
+	}
+	
+	/**
+	 * Loads the persistent details cache from a file, and saves it there after every refresh.
+	 * @param	path
+	 * @return	how many items the cache holds
+	 */
+	public function setDetailsCachePath(path:String):Int
+	{
+		if (!active) return 0;
+		return SteamWrap_SetUGCDetailsCachePath.call(path);
+	}
+	
+	/**
+	 * Returns the cached details of the given items straight from memory, leaving out items that aren't cached.
+	 */
+	public function getCachedDetails(fileIDs:Array<String>, withMetadata:Bool = false, withKeyValueTags:Bool = false):Array<SteamUGCDetails>
+	{
+		if (!active) return [];
+		var result = SteamWrap_GetCachedUGCDetails(fileIDs.join(","), (withMetadata ? 1 : 0) | (withKeyValueTags ? 2 : 0));
+		return SteamUGCDetails.listFromPacked(PackedReader.ofData(result));
+	}
+	
+	/**
+	 * Brings the cached details of the given items up to date. Only items that aren't cached yet, are older than
+	 * maxAgeSeconds, or that Steam reports a newer version of (needs an update, or the installed version is newer
+	 * than the cached timeUpdated) are queried.
+	 * @param	fileIDs
+	 * @param	withMetadata
+	 * @param	withKeyValueTags
+	 * @param	maxAgeSeconds	0 to never expire cached details by age; Steam may also answer from its own cache if under this age
+	 * @param	onComplete	called with the details of all the items
+	 * @return	the request id, or -1 on error
+	 */
+	public function refreshDetails(fileIDs:Array<String>, withMetadata:Bool = false, withKeyValueTags:Bool = false, maxAgeSeconds:Int = 0, ?onComplete:Array<SteamUGCDetails>->Void):Int
+	{
+		if (!active) return -1;
+		var request:Int = SteamWrap_RefreshUGCDetails(fileIDs.join(","), (withMetadata ? 1 : 0) | (withKeyValueTags ? 2 : 0), maxAgeSeconds);
+		if (request >= 0 && onComplete != null) refreshCallbacks.set(request, onComplete);
+		return request;
+	}
+	
+	/**
+	 * Creates a cursor over a query for all matching UGC (see createQueryAllUGCRequest()) that handles pagination
+	 * natively: pages are fetched when asked for, the next page is prefetched, query handles are released for you
+	 * and the last pageWindow pages are kept in memory.
+	 * @param	queryType
+	 * @param	matchingUGCType
+	 * @param	creatorAppID
+	 * @param	consumerAppID
+	 * @param	withMetadata	return metadata with the results
+	 * @param	withKeyValueTags	return key-value tags with the results
+	 * @param	matchAnyTag	match any of the required tags rather than all of them
+	 * @param	pageWindow	how many pages to keep in memory (at least 2)
+	 * @return	the cursor, or null on error
+	 */
+	public function createQueryCursor(queryType:EUGCQuery, matchingUGCType:EUGCMatchingUGCType, creatorAppID:Int, consumerAppID:Int, withMetadata:Bool = false, withKeyValueTags:Bool = false, matchAnyTag:Bool = false, pageWindow:Int = 4):UGCQueryCursor
+	{
+		if (!active) return null;
+		var flags = (withMetadata ? 1 : 0) | (withKeyValueTags ? 2 : 0) | (matchAnyTag ? 4 : 0);
+		var id:Int = SteamWrap_CreateUGCCursor.call(queryType, matchingUGCType, creatorAppID, consumerAppID, flags, pageWindow);
+		if (id < 0) return null;
+		var cursor = new UGCQueryCursor(this, id);
+		cursors.set(id, cursor);
+		return cursor;
+	}
+	
 	/*************PRIVATE***************/
 	
 	private var customTrace:String->Void;
 	private var appId:Int;
 	
+	private var cursors:Map<Int, UGCQueryCursor> = new Map();
+	private var refreshCallbacks:Map<Int, Array<SteamUGCDetails>->Void> = new Map();
+	private var queryCallbacks:Map<Int, Array<SteamUGCDetails>->Void> = new Map();
+	private var indexCallbacks:Map<Int, Array<IndexedWorkshopItem>->Void> = new Map();
+	private var publishCallbacks:Map<Int, Array<UGCPublishResult>->Void> = new Map();
+	
 	//Old-school CFFI calls:
 	private var SteamWrap_CreateUGCItem:Dynamic;
 	private var SteamWrap_SetUGCItemTitle:Dynamic;
@@ -292,12 +592,23 @@ class UGC
 	private var SteamWrap_SetUGCItemPreviewImage:Dynamic;
 	private var SteamWrap_StartUpdateUGCItem:Dynamic;
 	private var SteamWrap_SubmitUGCItemUpdate:Dynamic;
+	private var SteamWrap_PublishUGCBatch:Dynamic;
+	private var SteamWrap_GetUGCPublishProgress:Dynamic;
 	private var SteamWrap_GetSubscribedItems:Dynamic;
 	private var SteamWrap_GetItemDownloadInfo:Dynamic;
 	private var SteamWrap_GetItemInstallInfo:Dynamic;
+	private var SteamWrap_GetSubscribedItemsInfo:Dynamic;
+	private var SteamWrap_IndexWorkshopItems:Dynamic;
+	private var SteamWrap_GetMappedFileSize:Dynamic;
+	private var SteamWrap_ReadMappedFile:Dynamic;
+	private var SteamWrap_ReadMappedFileInto:Dynamic;
 	private var SteamWrap_CreateQueryAllUGCRequest:Dynamic;
 	private var SteamWrap_CreateQueryUGCDetailsRequest:Dynamic;
 	private var SteamWrap_GetQueryUGCResult:Dynamic;
+	private var SteamWrap_GetQueryUGCResults:Dynamic;
+	private var SteamWrap_GetCachedUGCDetails:Dynamic;
+	private var SteamWrap_RefreshUGCDetails:Dynamic;
+	private var SteamWrap_QueryUGCDetails:Dynamic;
 	private var SteamWrap_GetQueryUGCKeyValueTag:Dynamic;
 	private var SteamWrap_GetQueryUGCMetadata:Dynamic;
 	
@@ -313,6 +624,21 @@ class UGC
 	private var SteamWrap_SetReturnKeyValueTags = Loader.load("SteamWrap_SetReturnKeyValueTags", "cii");
 	private var SteamWrap_ReleaseQueryUGCRequest = Loader.load("SteamWrap_ReleaseQueryUGCRequest", "ci");
 	private var SteamWrap_GetQueryUGCNumKeyValueTags = Loader.load("SteamWrap_GetQueryUGCNumKeyValueTags", "cii");
+	private var SteamWrap_CreateUGCCursor = Loader.load("SteamWrap_CreateUGCCursor", "iiiiiii");
+	private var SteamWrap_AddUGCCursorTag = Loader.load("SteamWrap_AddUGCCursorTag", "icii");
+	private var SteamWrap_AddUGCCursorKeyValueTag = Loader.load("SteamWrap_AddUGCCursorKeyValueTag", "icci");
+	private var SteamWrap_SetUGCCursorSearchText = Loader.load("SteamWrap_SetUGCCursorSearchText", "ici");
+	private var SteamWrap_RequestUGCCursorPage = Loader.load("SteamWrap_RequestUGCCursorPage", "iii");
+	private var SteamWrap_GetUGCCursorTotal = Loader.load("SteamWrap_GetUGCCursorTotal", "ii");
+	private var SteamWrap_DestroyUGCCursor = Loader.load("SteamWrap_DestroyUGCCursor", "iv");
+	private var SteamWrap_SetUGCDetailsCachePath = Loader.load("SteamWrap_SetUGCDetailsCachePath", "ci");
+	private var SteamWrap_QueueItemDownload = Loader.load("SteamWrap_QueueItemDownload", "cii");
+	private var SteamWrap_CancelItemDownload = Loader.load("SteamWrap_CancelItemDownload", "ci");
+	private var SteamWrap_GetItemDownloadState = Loader.load("SteamWrap_GetItemDownloadState", "ci");
+	private var SteamWrap_SetDownloadManagerOptions = Loader.load("SteamWrap_SetDownloadManagerOptions", "iiffv");
+	private var SteamWrap_SetWorkshopIndexPath = Loader.load("SteamWrap_SetWorkshopIndexPath", "ci");
+	private var SteamWrap_MapWorkshopFile = Loader.load("SteamWrap_MapWorkshopFile", "cci");
+	private var SteamWrap_UnmapWorkshopFile = Loader.load("SteamWrap_UnmapWorkshopFile", "iv");
 	
 	private function new(appId_:Int, CustomTrace:String->Void) {
 		#if sys		//TODO: figure out what targets this will & won't work with and upate this guard
@@ -335,13 +661,24 @@ class UGC
 			SteamWrap_SetUGCItemVisibility = cpp.Lib.load("steamwrap", "SteamWrap_SetUGCItemVisibility", 2);
 			SteamWrap_StartUpdateUGCItem = cpp.Lib.load("steamwrap", "SteamWrap_StartUpdateUGCItem", 2);
 			SteamWrap_SubmitUGCItemUpdate = cpp.Lib.load("steamwrap", "SteamWrap_SubmitUGCItemUpdate", 2);
+			SteamWrap_PublishUGCBatch = cpp.Lib.load("steamwrap", "SteamWrap_PublishUGCBatch", 3);
+			SteamWrap_GetUGCPublishProgress = cpp.Lib.load("steamwrap", "SteamWrap_GetUGCPublishProgress", 0);
 			SteamWrap_GetSubscribedItems = cpp.Lib.load("steamwrap", "SteamWrap_GetSubscribedItems", 0);
 			SteamWrap_GetItemDownloadInfo = cpp.Lib.load("steamwrap", "SteamWrap_GetItemDownloadInfo", 1);
 			SteamWrap_GetItemInstallInfo = cpp.Lib.load("steamwrap", "SteamWrap_GetItemInstallInfo", 2);
+			SteamWrap_GetSubscribedItemsInfo = cpp.Lib.load("steamwrap", "SteamWrap_GetSubscribedItemsInfo", 0);
+			SteamWrap_IndexWorkshopItems = cpp.Lib.load("steamwrap", "SteamWrap_IndexWorkshopItems", 2);
+			SteamWrap_GetMappedFileSize = cpp.Lib.load("steamwrap", "SteamWrap_GetMappedFileSize", 1);
+			SteamWrap_ReadMappedFile = cpp.Lib.load("steamwrap", "SteamWrap_ReadMappedFile", 3);
+			SteamWrap_ReadMappedFileInto = cpp.Lib.load("steamwrap", "SteamWrap_ReadMappedFileInto", 5);
 			
 			SteamWrap_CreateQueryAllUGCRequest = cpp.Lib.load("steamwrap", "SteamWrap_CreateQueryAllUGCRequest", 5);
 			SteamWrap_CreateQueryUGCDetailsRequest = cpp.Lib.load("steamwrap", "SteamWrap_CreateQueryUGCDetailsRequest", 1);
 			SteamWrap_GetQueryUGCResult = cpp.Lib.load("steamwrap", "SteamWrap_GetQueryUGCResult", 2);
+			SteamWrap_GetQueryUGCResults = cpp.Lib.load("steamwrap", "SteamWrap_GetQueryUGCResults", 4);
+			SteamWrap_GetCachedUGCDetails = cpp.Lib.load("steamwrap", "SteamWrap_GetCachedUGCDetails", 2);
+			SteamWrap_RefreshUGCDetails = cpp.Lib.load("steamwrap", "SteamWrap_RefreshUGCDetails", 3);
+			SteamWrap_QueryUGCDetails = cpp.Lib.load("steamwrap", "SteamWrap_QueryUGCDetails", 3);
 			SteamWrap_GetQueryUGCKeyValueTag = cpp.Lib.load("steamwrap", "SteamWrap_GetQueryUGCKeyValueTag", 5);
 			SteamWrap_GetQueryUGCMetadata = cpp.Lib.load("steamwrap", "SteamWrap_GetQueryUGCMetadata", 3);
 		}
@@ -358,4 +695,175 @@ class UGC
 		
 		#end
 	}
-}
\ No newline at end of file
+	
+	private function onCursorPage(success:Bool, data:Dynamic) {
+		var cursor = cursors.get(data.cursor);
+		if (cursor == null) return;
+		var results = success ? SteamUGCDetails.listFromPacked(PackedReader.ofData(data.results)) : null;
+		cursor.onPage(data.page, data.total, results);
+	}
+	
+	private function onDetailsRefreshed(success:Bool, data:Dynamic) {
+		var request:Int = data.request;
+		var results = SteamUGCDetails.listFromPacked(PackedReader.ofData(data.results));
+		var callback = refreshCallbacks.get(request);
+		if (callback != null) {
+			refreshCallbacks.remove(request);
+			callback(results);
+		}
+		if (whenDetailsRefreshed != null) whenDetailsRefreshed(request, data.fetched, results);
+	}
+	
+	private function onDetailsQueried(success:Bool, data:Dynamic) {
+		var request:Int = data.request;
+		var results = SteamUGCDetails.listFromPacked(PackedReader.ofData(data.results));
+		var callback = queryCallbacks.get(request);
+		if (callback != null) {
+			queryCallbacks.remove(request);
+			callback(results);
+		}
+		if (whenDetailsQueried != null) whenDetailsQueried(request, success, results);
+	}
+	
+	private function onDownloadProgress(success:Bool, data:Dynamic) {
+		if (whenDownloadProgress == null) return;
+		var items = ItemDownloadProgress.fromPacked(PackedReader.ofData(data.items));
+		whenDownloadProgress(data.bytesDownloaded, data.bytesTotal, items);
+	}
+	
+	private function onDownloadFinished(success:Bool, data:Dynamic) {
+		if (whenDownloadFinished != null) whenDownloadFinished(data.id, success, data.result);
+	}
+	
+	private function onItemsIndexed(success:Bool, data:Dynamic) {
+		var request:Int = data.request;
+		var items = IndexedWorkshopItem.fromPacked(PackedReader.ofData(data.items));
+		var callback = indexCallbacks.get(request);
+		if (callback != null) {
+			indexCallbacks.remove(request);
+			callback(items);
+		}
+		if (whenItemsIndexed != null) whenItemsIndexed(request, success, items);
+	}
+	
+	private function onFilesUnmapped(success:Bool, data:Dynamic) {
+		if (whenFilesUnmapped == null) return;
+		var reader = PackedReader.ofData(data.handles);
+		var handles = [for (i in 0...reader.readU32()) reader.readInt32()];
+		whenFilesUnmapped(data.id, handles);
+	}
+	
+	private function onItemPublished(success:Bool, data:Dynamic) {
+		if (whenItemPublished == null) return;
+		var result = new UGCPublishResult();
+		result.fileID = data.id != "0" ? data.id : null;
+		result.result = data.result;
+		result.needsLegalAgreement = data.needsLegalAgreement;
+		whenItemPublished(data.batch, data.index, result);
+	}
+	
+	private function onBatchPublished(success:Bool, data:Dynamic) {
+		var batch:Int = data.batch;
+		var results = UGCPublishResult.fromPacked(PackedReader.ofData(data.results));
+		var callback = publishCallbacks.get(batch);
+		if (callback != null) {
+			publishCallbacks.remove(batch);
+			callback(results);
+		}
+		if (whenBatchPublished != null) whenBatchPublished(batch, success, results);
+	}
+}
+
+/**
+ * A paginated query over all matching UGC, created by UGC.createQueryCursor(). Add filters before asking for the
+ * first page; close() the cursor when done with it.
+ */
+@:allow(steamwrap.api.UGC)
+class UGCQueryCursor
+{
+	public var id(default, null):Int;
+	
+	/** total matching results, -1 until the first page is in **/
+	public var totalResults(get, never):Int;
+	
+	/** number of pages, -1 until the first page is in **/
+	public var numPages(get, never):Int;
+	
+	/**
+	 * Called for every page that comes in (after the request's own onPage, if any): page, results (null if the
+	 * query failed)
+	 */
+	public var whenPage:Int->Array<SteamUGCDetails>->Void;
+	
+	public function addRequiredTag(tagName:String):Bool {
+		return ugc.SteamWrap_AddUGCCursorTag.call(id, tagName, 1) == 1;
+	}
+	
+	public function addExcludedTag(tagName:String):Bool {
+		return ugc.SteamWrap_AddUGCCursorTag.call(id, tagName, 0) == 1;
+	}
+	
+	public function addRequiredKeyValueTag(key:String, value:String):Bool {
+		return ugc.SteamWrap_AddUGCCursorKeyValueTag.call(id, key, value) == 1;
+	}
+	
+	public function setSearchText(text:String):Bool {
+		return ugc.SteamWrap_SetUGCCursorSearchText.call(id, text) == 1;
+	}
+	
+	/**
+	 * Asks for a page (starting at 1). It comes back right away if it's in memory (e.g. prefetched), otherwise once
+	 * Steam answers; either way from Steam.onEnterFrame(). The page after it is prefetched.
+	 * @param	page
+	 * @param	onPage	called with this page's results, or null if the query failed
+	 * @return	false if the cursor is closed
+	 */
+	public function requestPage(page:Int, ?onPage:Array<SteamUGCDetails>->Void):Bool {
+		if (closed || ugc.SteamWrap_RequestUGCCursorPage.call(id, page) != 1) return false;
+		if (onPage != null) {
+			var callbacks = pageCallbacks.get(page);
+			if (callbacks == null) pageCallbacks.set(page, callbacks = []);
+			callbacks.push(onPage);
+		}
+		return true;
+	}
+	
+	public function close():Void {
+		if (closed) return;
+		closed = true;
+		ugc.SteamWrap_DestroyUGCCursor.call(id);
+		ugc.cursors.remove(id);
+		pageCallbacks = new Map();
+	}
+	
+	/*************PRIVATE***************/
+	
+	private var ugc:UGC;
+	private var closed:Bool = false;
+	private var total:Int = -1;
+	private var pageCallbacks:Map<Int, Array<Array<SteamUGCDetails>->Void>> = new Map();
+	
+	private function new(ugc_:UGC, id_:Int) {
+		ugc = ugc_;
+		id = id_;
+	}
+	
+	private function get_totalResults():Int {
+		return closed ? total : ugc.SteamWrap_GetUGCCursorTotal.call(id);
+	}
+	
+	private function get_numPages():Int {
+		var n = totalResults;
+		return n < 0 ? -1 : Math.ceil(n / 50);
+	}
+	
+	private function onPage(page:Int, total_:Int, results:Array<SteamUGCDetails>) {
+		total = total_;
+		var callbacks = pageCallbacks.get(page);
+		if (callbacks != null) {
+			pageCallbacks.remove(page);
+			for (callback in callbacks) callback(results);
+		}
+		if (whenPage != null) whenPage(page, results);
+	}
+}
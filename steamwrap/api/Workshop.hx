@@ -23,6 +23,16 @@ class Workshop
 	 */
 	public var active(default, null):Bool = false;
 	
+	/**
+	 * Called every so often while UGCReadToFile() streams: stream id, bytes written so far, total bytes
+	 */
+	public var whenUGCReadToFileProgress:Int->Float->Float->Void;
+	
+	/**
+	 * Called when a UGCReadToFile() stream is done: stream id, success, the file path
+	 */
+	public var whenUGCReadToFileFinished:Int->Bool->String->Void;
+	
 	//TODO: these all need documentation headers
 	
 	/**
@@ -163,6 +173,33 @@ class Workshop
 		return bytes;
 	}
 	
+	/**
+	 * After download, streams the content of the file straight to disk on a worker thread, through one buffer of
+	 * bufferSize bytes, so memory use doesn't grow with the size of the file. The file only appears at path once
+	 * it's complete.
+	 * @param	handle	the UGC file handle
+	 * @param	path	where to write the file
+	 * @param	bufferSize	how much to read per UGCRead() call
+	 * @param	onComplete	called with success once the file is written (or the stream failed or was cancelled)
+	 * @return	the stream id, or -1 if the handle isn't downloaded
+	 */
+	public function UGCReadToFile(handle:String, path:String, bufferSize:Int = 1048576, ?onComplete:Bool->Void):Int
+	{
+		if (!active) return -1;
+		var id:Int = SteamWrap_UGCReadToFile.call(handle, path, bufferSize);
+		if (id >= 0 && onComplete != null) readToFileCallbacks.set(id, onComplete);
+		return id;
+	}
+	
+	/**
+	 * Stops a UGCReadToFile() stream; it finishes unsuccessfully and leaves no file behind.
+	 */
+	public function cancelUGCReadToFile(id:Int):Void
+	{
+		if (!active) return;
+		SteamWrap_CancelUGCReadToFile.call(id);
+	}
+	
 	public function getPublishedFileDetails(fileId:String, maxSecondsOld:Int):Void{
 		SteamWrap_GetPublishedFileDetails.call(fileId, maxSecondsOld);
 	}
@@ -172,6 +209,8 @@ class Workshop
 	private var customTrace:String->Void;
 	private var appId:Int;
 	
+	private var readToFileCallbacks:Map<Int, Bool->Void> = new Map();
+	
 	//Old-school CFFI calls:
 	private var SteamWrap_GetUGCDownloadProgress:Dynamic;
 	private var SteamWrap_UGCRead:Dynamic;
@@ -183,6 +222,8 @@ class Workshop
 	private var SteamWrap_EnumerateUserSubscribedFiles     = Loader.load("SteamWrap_EnumerateUserSubscribedFiles"    , "iv");
 	private var SteamWrap_EnumerateUserPublishedFiles      = Loader.load("SteamWrap_EnumerateUserPublishedFiles"     , "iv");
 	private var SteamWrap_UGCDownload                      = Loader.load("SteamWrap_UGCDownload"                     , "civ");
+	private var SteamWrap_UGCReadToFile                    = Loader.load("SteamWrap_UGCReadToFile"                   , "ccii");
+	private var SteamWrap_CancelUGCReadToFile              = Loader.load("SteamWrap_CancelUGCReadToFile"             , "iv");
 	
 	private function new(appId_:Int, CustomTrace:String->Void) {
 		#if sys		//TODO: figure out what targets this will & won't work with and upate this guard
@@ -208,4 +249,18 @@ class Workshop
 		
 		#end
 	}
+	
+	private function onUGCReadToFileProgress(success:Bool, data:Dynamic) {
+		if (whenUGCReadToFileProgress != null) whenUGCReadToFileProgress(data.id, data.bytesWritten, data.bytesTotal);
+	}
+	
+	private function onUGCReadToFileFinished(success:Bool, data:Dynamic) {
+		var id:Int = data.id;
+		var callback = readToFileCallbacks.get(id);
+		if (callback != null) {
+			readToFileCallbacks.remove(id);
+			callback(success);
+		}
+		if (whenUGCReadToFileFinished != null) whenUGCReadToFileFinished(id, success, data.path);
+	}
 }
\ No newline at end of file
@@ -0,0 +1,102 @@
+package steamwrap.helpers;
+
+import haxe.Int64;
+import haxe.io.Bytes;
+import haxe.io.BytesData;
+import haxe.io.BytesInput;
+
+/**
+ * Reads the little-endian binary tables returned by SteamWrap's bulk calls.
+ * Strings are a u32 byte length followed by UTF-8; 64-bit ids are handed out as decimal strings,
+ * the same form the string-based calls use.
+ */
+class PackedReader extends BytesInput
+{
+	public function new(bytes:Bytes)
+	{
+		super(bytes);
+		bigEndian = false;
+	}
+
+	public static function ofData(data:BytesData):PackedReader
+	{
+		if (data == null) return null;
+		return new PackedReader(Bytes.ofData(data));
+	}
+
+	public inline function readU8():Int
+	{
+		return readByte();
+	}
+
+	public inline function readBool():Bool
+	{
+		return readByte() != 0;
+	}
+
+	/**
+	 * Values above 0x7fffffff come back negative; use readU32Float() when that matters.
+	 */
+	public inline function readU32():Int
+	{
+		return readInt32();
+	}
+
+	public function readU32Float():Float
+	{
+		var v:Float = readInt32();
+		return v < 0 ? v + 4294967296.0 : v;
+	}
+
+	/**
+	 * Reads an unsigned 64-bit count (bytes, say) as a Float; exact up to 2^53.
+	 */
+	public function readU64Float():Float
+	{
+		var low:Float = readInt32();
+		var high:Float = readInt32();
+		return (high < 0 ? high + 4294967296.0 : high) * 4294967296.0 + (low < 0 ? low + 4294967296.0 : low);
+	}
+	
+	public function readI64():Int64
+	{
+		var low = readInt32();
+		var high = readInt32();
+		return Int64.make(high, low);
+	}
+
+	/**
+	 * Reads an unsigned 64-bit value (Steam ID, UGC handle, published file ID) as a decimal string.
+	 */
+	public function readU64String():String
+	{
+		return uint64ToString(readI64());
+	}
+
+	public function readStr():String
+	{
+		var length = readInt32();
+		if (length <= 0) return "";
+		return readString(length);
+	}
+
+	/**
+	 * Reads a string stored in a table's string pool: a u32 offset and a u32 length into pool.
+	 */
+	public function readPooled(pool:Bytes):String
+	{
+		var offset = readInt32();
+		var length = readInt32();
+		if (length <= 0) return "";
+		return pool.getString(offset, length);
+	}
+
+	public static function uint64ToString(v:Int64):String
+	{
+		if (v.high >= 0) return Int64.toStr(v);
+		//too big for a signed Int64: halve it first so the division stays positive
+		var q = Int64.div(Int64.ushr(v, 1), 5);
+		var r = Int64.sub(v, Int64.mul(q, 10));
+		return Int64.toStr(q) + Int64.toStr(r);
+	}
+}